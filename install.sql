@@ -17,8 +17,90 @@
 	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+-- The shared rise/set cache is off by default. It is switched on by the environment
+-- variable ASTRO_CACHE_SIZE (megabytes, e.g. 16) of the MySQL server and takes that
+-- much server memory. With ASTRO_CACHE_QUANT > 0 (degrees) the rise/set times of
+-- all sites within a cell are calculated at the center of the cell, not at the
+-- exact site. See README.md, "Rise/set cache".
+
 DROP FUNCTION IF EXISTS astro_info;
+DROP FUNCTION IF EXISTS astro_stats;
+DROP FUNCTION IF EXISTS astro_stats_reset;
+DROP FUNCTION IF EXISTS astro_stats_enable;
 DROP FUNCTION IF EXISTS astro;
+DROP FUNCTION IF EXISTS astro_series;
+DROP FUNCTION IF EXISTS astro_calendar;
+DROP FUNCTION IF EXISTS astro_sun_times;
+DROP FUNCTION IF EXISTS astro_sun_events;
+DROP FUNCTION IF EXISTS astro_packed;
+DROP FUNCTION IF EXISTS astro_unpack;
+DROP FUNCTION IF EXISTS astro_sun_distance;
+DROP FUNCTION IF EXISTS astro_sun_ecliptic;
+DROP FUNCTION IF EXISTS astro_sun_declination;
+DROP FUNCTION IF EXISTS astro_sun_azimuth;
+DROP FUNCTION IF EXISTS astro_sun_altitude;
+DROP FUNCTION IF EXISTS astro_sun_diameter;
+DROP FUNCTION IF EXISTS astro_sun_astronomical_dawn_seconds;
+DROP FUNCTION IF EXISTS astro_sun_nautical_dawn_seconds;
+DROP FUNCTION IF EXISTS astro_sun_civil_dawn_seconds;
+DROP FUNCTION IF EXISTS astro_sun_rise_seconds;
+DROP FUNCTION IF EXISTS astro_sun_transit_seconds;
+DROP FUNCTION IF EXISTS astro_sun_set_seconds;
+DROP FUNCTION IF EXISTS astro_sun_civil_dusk_seconds;
+DROP FUNCTION IF EXISTS astro_sun_nautical_dusk_seconds;
+DROP FUNCTION IF EXISTS astro_sun_astronomical_dusk_seconds;
+DROP FUNCTION IF EXISTS astro_moon_distance;
+DROP FUNCTION IF EXISTS astro_moon_declination;
+DROP FUNCTION IF EXISTS astro_moon_azimuth;
+DROP FUNCTION IF EXISTS astro_moon_altitude;
+DROP FUNCTION IF EXISTS astro_moon_diameter;
+DROP FUNCTION IF EXISTS astro_moon_phase_number;
+DROP FUNCTION IF EXISTS astro_moon_age;
+DROP FUNCTION IF EXISTS astro_moon_phase;
+DROP FUNCTION IF EXISTS astro_moon_rise_seconds;
+DROP FUNCTION IF EXISTS astro_moon_transit_seconds;
+DROP FUNCTION IF EXISTS astro_moon_set_seconds;
+DROP FUNCTION IF EXISTS astro_daylight_hours_sum;
+DROP FUNCTION IF EXISTS astro_moon_visible_hours_sum;
+DROP FUNCTION IF EXISTS astro_twilight_minutes_avg;
 
 CREATE FUNCTION `astro_info` RETURNS STRING SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_stats` RETURNS STRING SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_stats_reset` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_stats_enable` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
 CREATE FUNCTION `astro` RETURNS STRING SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_series` RETURNS STRING SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_calendar` RETURNS STRING SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_times` RETURNS STRING SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_events` RETURNS STRING SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_packed` RETURNS STRING SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_unpack` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_distance` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_ecliptic` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_declination` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_azimuth` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_altitude` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_diameter` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_astronomical_dawn_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_nautical_dawn_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_civil_dawn_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_rise_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_transit_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_set_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_civil_dusk_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_nautical_dusk_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_sun_astronomical_dusk_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_distance` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_declination` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_azimuth` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_altitude` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_diameter` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_phase_number` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_age` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_phase` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_rise_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_transit_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE FUNCTION `astro_moon_set_seconds` RETURNS INTEGER SONAME 'lib_mysqludf_astro.so';
+CREATE AGGREGATE FUNCTION `astro_daylight_hours_sum` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE AGGREGATE FUNCTION `astro_moon_visible_hours_sum` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
+CREATE AGGREGATE FUNCTION `astro_twilight_minutes_avg` RETURNS REAL SONAME 'lib_mysqludf_astro.so';
@@ -0,0 +1,296 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "astro_batch.h"
+#include "astro_math.h"
+
+// Runtime dispatch by GCC function multiversioning, other compilers build the
+// portable version only
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define AS_BATCH_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define AS_BATCH_CLONES
+#endif
+
+#define AS_DEG  (M_PI / 180.0)
+
+// The kernels are templates on the type R of the positions: double uses the
+// precise polynomials of astro_math.h, float the fast ones with twice the
+// elements per vector. Time dependent arguments are always calculated in
+// double and reduced to one turn before they are converted to float.
+AS_MATH_INLINE void as_batch_sincos(double x, double *s, double *c) {as_sincos(x, s, c);}
+AS_MATH_INLINE void as_batch_sincos(float x, float *s, float *c) {as_fast_sincos(x, s, c);}
+AS_MATH_INLINE double as_batch_sin(double x) {return as_sin(x);}
+AS_MATH_INLINE float as_batch_sin(float x) {float s, c; as_fast_sincos(x, &s, &c); return s;}
+AS_MATH_INLINE double as_batch_cos(double x) {return as_cos(x);}
+AS_MATH_INLINE float as_batch_cos(float x) {float s, c; as_fast_sincos(x, &s, &c); return c;}
+AS_MATH_INLINE double as_batch_atan2(double y, double x) {return as_atan2(y, x);}
+AS_MATH_INLINE float as_batch_atan2(float y, float x) {return as_fast_atan2(y, x);}
+AS_MATH_INLINE double as_batch_asin(double x) {return as_asin(x);}
+AS_MATH_INLINE float as_batch_asin(float x) {return as_fast_asin(x);}
+AS_MATH_INLINE double as_batch_mod2pi(double x) {return as_mod2pi(x);}
+AS_MATH_INLINE float as_batch_mod2pi(float x) {return as_fast_mod2pi(x);}
+
+AS_MATH_INLINE void as_batch_angle(double x, double *r) {*r = x;}
+AS_MATH_INLINE void as_batch_angle(double x, float *r) {*r = (float)as_mod2pi(x);}
+
+// Local mean sidereal time in radians, same as Astronomy::GMST2LMST(CalcGMST(jd), lon) * 15 * DEG
+AS_MATH_INLINE double as_batch_lmst(double jd, double lon, double *gmst)
+{
+	double UT = (jd - 0.5 - floor(jd - 0.5)) * 24.0;
+	double JD0 = floor(jd - 0.5) + 0.5;
+	double T = (JD0 - 2451545.0) / 36525.0;
+	double T0 = 6.697374558 + T * (2400.051336 + T * 0.000025862);
+	double g = T0 + UT * 1.002737909;
+	g -= floor(g / 24.0) * 24.0;
+	double l = g + (180.0 / M_PI) * lon / 15;
+	l -= floor(l / 24.0) * 24.0;
+	*gmst = g;
+	return l * 15.0 * AS_DEG;
+}
+
+// Ecliptic to equatorial coordinates, see Astronomy::Ecl2Equ()
+template<typename R> AS_MATH_INLINE void as_batch_ecl2equ(R lon, R lat, double TDT, R *ra, R *dec)
+{
+	double T = (TDT - 2451545.0) / 36525.0;
+	double eps = (23.0 + (26 + 21.45 / 60.0) / 60.0 + T * (-46.815 + T * (-0.0006 + T * 0.00181)) / 3600.0) * AS_DEG;
+	R sineps, coseps, sinlon, coslon, sinlat, coslat;
+	as_batch_sincos(R(eps), &sineps, &coseps);
+	as_batch_sincos(lon, &sinlon, &coslon);
+	as_batch_sincos(lat, &sinlat, &coslat);
+	*ra = as_batch_mod2pi(as_batch_atan2(sinlon * coseps - sinlat / coslat * sineps, coslon));
+	*dec = as_batch_asin(sinlat * coseps + coslat * sineps * sinlon);
+}
+
+// Equatorial to horizontal coordinates, see Astronomy::Equ2Altaz()
+template<typename R> AS_MATH_INLINE void as_batch_equ2altaz(R ra, R dec, R geolat, R lmst, R *az, R *alt)
+{
+	R sindec, cosdec, sinlha, coslha, sinlat, coslat;
+	as_batch_sincos(dec, &sindec, &cosdec);
+	as_batch_sincos(lmst - ra, &sinlha, &coslha);
+	as_batch_sincos(geolat, &sinlat, &coslat);
+	R N = -cosdec * sinlha;
+	R D = sindec * coslat - cosdec * coslha * sinlat;
+	*az = as_batch_mod2pi(as_batch_atan2(N, D));
+	*alt = as_batch_asin(sindec * sinlat + cosdec * coslha * coslat);
+}
+
+// Mean anomaly, longitude and distance (AU) of the sun, see Astronomy::SunPosition()
+template<typename R> AS_MATH_INLINE void as_batch_sun(double TDT, R *MSun, R *lon, R *distance)
+{
+	double D = TDT - 2447891.5;
+	double eg = 279.403303 * AS_DEG;
+	double wg = 282.768422 * AS_DEG;
+	double e = 0.016713;
+	R M, sinM, cosM, sinnu, cosnu;
+	as_batch_angle(360 * AS_DEG / 365.242191 * D + eg - wg, &M);
+	as_batch_sincos(M, &sinM, &cosM);
+	R nu = M + R(360.0 * AS_DEG / M_PI * e) * sinM;
+	as_batch_sincos(nu, &sinnu, &cosnu);
+	*MSun = M;
+	*lon = as_batch_mod2pi(nu + R(wg));
+	*distance = R(1 - e * e) / (R(1) + R(e) * cosnu);
+}
+
+// The loops below are kept free of branches and calls, the restrict qualified
+// arrays let the compiler vectorize them without run time alias checks
+template<typename R> AS_BATCH_CLONES
+static void as_batch_sun_equ(size_t n, const double *__restrict tdt, R *__restrict lon, R *__restrict lat,
+                             R *__restrict ra, R *__restrict dec, R *__restrict distance)
+{
+	for (size_t i = 0; i < n; i++) {
+		double TDT = tdt[i];
+		R M, l, dist;
+		as_batch_sun(TDT, &M, &l, &dist);
+		as_batch_ecl2equ(l, R(0), TDT, &ra[i], &dec[i]);
+		lon[i] = l;
+		lat[i] = R(0);
+		distance[i] = dist * R(149598500);
+	}
+}
+
+template<typename R> AS_BATCH_CLONES
+static void as_batch_moon_equ(size_t n, const double *__restrict tdt, R *__restrict lon, R *__restrict lat,
+                              R *__restrict ra, R *__restrict dec, R *__restrict distance, R *__restrict phase)
+{
+	// Mean Moon orbit elements as of 1990.0
+	const double l0 = 318.351648 * AS_DEG;
+	const double P0 = 36.340410 * AS_DEG;
+	const double N0 = 318.510107 * AS_DEG;
+	const double sini = sin(5.145396 * AS_DEG);
+	const double cosi = cos(5.145396 * AS_DEG);
+	const double e = 0.054900;
+
+	for (size_t i = 0; i < n; i++) {
+		double TDT = tdt[i];
+		double D = TDT - 2447891.5;
+		R sunM, sunLon, sunDist;
+		as_batch_sun(TDT, &sunM, &sunLon, &sunDist);
+		R sinSunM = as_batch_sin(sunM);
+
+		double ml = 13.1763966 * AS_DEG * D + l0;
+		R l, MMoon, N;
+		as_batch_angle(ml, &l);
+		as_batch_angle(ml - 0.1114041 * AS_DEG * D - P0, &MMoon);
+		as_batch_angle(N0 - 0.0529539 * AS_DEG * D, &N);
+		R C = l - sunLon;
+		R Ev = R(1.2739 * AS_DEG) * as_batch_sin(R(2) * C - MMoon);
+		R Ae = R(0.1858 * AS_DEG) * sinSunM;
+		R A3 = R(0.37 * AS_DEG) * sinSunM;
+		R MMoon2 = MMoon + Ev - Ae - A3;
+		R Ec = R(6.2886 * AS_DEG) * as_batch_sin(MMoon2);
+		R A4 = R(0.214 * AS_DEG) * as_batch_sin(R(2) * MMoon2);
+		R l2 = l + Ev + Ec - Ae + A4;
+		R V = R(0.6583 * AS_DEG) * as_batch_sin(R(2) * (l2 - sunLon));
+		R l3 = l2 + V;
+		R N2 = N - R(0.16 * AS_DEG) * sinSunM;
+
+		R s, c;
+		as_batch_sincos(l3 - N2, &s, &c);
+		R mlon = as_batch_mod2pi(N2 + as_batch_atan2(s * R(cosi), c));
+		R mlat = as_batch_asin(s * R(sini));
+		as_batch_ecl2equ(mlon, mlat, TDT, &ra[i], &dec[i]);
+		lon[i] = mlon;
+		lat[i] = mlat;
+		distance[i] = R(1 - e * e) / (R(1) + R(e) * as_batch_cos(MMoon2 + Ec)) * R(384401);
+		phase[i] = R(0.5) * (R(1) - as_batch_cos(as_batch_mod2pi(l3 - sunLon)));
+	}
+}
+
+// Geocentric to topocentric equatorial coordinates in place, see
+// Astronomy::ObserverGeocentric() and Astronomy::GeoEqu2TopoEqu()
+template<typename R> AS_BATCH_CLONES
+static void as_batch_topo(size_t n, const double *__restrict tdt, const double *__restrict geolat, const double *__restrict geolon,
+                          double deltaT, R *__restrict ra, R *__restrict dec, const R *__restrict distance)
+{
+	const double flat = 298.257223563;  // WGS84 flatening of earth
+	const double aearth = 6378.137;     // GRS80/WGS84 semi major axis of earth ellipsoid
+	const double fl = (1.0 - 1.0 / flat) * (1.0 - 1.0 / flat);
+
+	for (size_t i = 0; i < n; i++) {
+		double gmst;
+		R lmst = R(as_batch_lmst(tdt[i] - deltaT / 24.0 / 3600.0, geolon[i], &gmst));
+		R sinlat, coslat;
+		as_batch_sincos(R(geolat[i]), &sinlat, &coslat);
+		R u = R(1) / sqrt(coslat * coslat + R(fl) * sinlat * sinlat);
+		R a = R(aearth) * u;
+		R b = R(aearth * fl) * u;
+		R rho = sqrt(a * a * coslat * coslat + b * b * sinlat * sinlat);
+
+		R sindec, cosdec, sinra, cosra, sinlst, coslst;
+		as_batch_sincos(dec[i], &sindec, &cosdec);
+		as_batch_sincos(ra[i], &sinra, &cosra);
+		as_batch_sincos(lmst, &sinlst, &coslst);
+		R x = distance[i] * cosdec * cosra - rho * coslat * coslst;
+		R y = distance[i] * cosdec * sinra - rho * coslat * sinlst;
+		R z = distance[i] * sindec - rho * sinlat;
+		ra[i] = as_batch_mod2pi(as_batch_atan2(y, x));
+		dec[i] = as_batch_asin(z / sqrt(x * x + y * y + z * z));
+	}
+}
+
+template<typename R> AS_BATCH_CLONES
+static void as_batch_altaz(size_t n, const double *__restrict tdt, const double *__restrict geolat, const double *__restrict geolon,
+                           double deltaT, const R *__restrict ra, const R *__restrict dec, R *__restrict az, R *__restrict alt)
+{
+	for (size_t i = 0; i < n; i++) {
+		double gmst;
+		R lmst = R(as_batch_lmst(tdt[i] - deltaT / 24.0 / 3600.0, geolon[i], &gmst));
+		as_batch_equ2altaz(ra[i], dec[i], R(geolat[i]), lmst, &az[i], &alt[i]);
+	}
+}
+
+// Refraction correction, same as Astronomy::Refraction() but evaluating both
+// branches and a fixed number of iterations
+template<typename R> AS_BATCH_CLONES
+static void as_batch_refraction(size_t n, const R *__restrict alt, R *__restrict refraction)
+{
+	const double pressure = 1015;
+	const double temperature = 10;
+	const double P = (pressure - 80.0) / 930.0;
+	const double Q = 0.0048 * (temperature - 10.0);
+
+	for (size_t i = 0; i < n; i++) {
+		R a = alt[i];
+		R altdeg = a * R(180.0 / M_PI);
+		R sa, ca;
+		as_batch_sincos(a, &sa, &ca);
+		R high = R(0.00452 * pressure) / (R(273 + temperature) * sa / ca);
+
+		R y = a;
+		R D = R(0);
+		R y0 = y;
+		R D0 = D;
+		for (int k = 0; k < 3; k++) {
+			R s, c;
+			as_batch_sincos((y + (R(7.31) / (y + R(4.4)))) * R(AS_DEG), &s, &c);
+			R N = c / s;
+			D = N * R(P) / (R(60.0) + R(Q) * (N + R(39.0)));
+			N = y - y0;
+			y0 = D - D0 - N;
+			bool step = (N != R(0)) && (y0 != R(0));
+			N = step ? y - N * (a + D - y) / (step ? y0 : R(1)) : a + D;
+			y0 = y;
+			D0 = D;
+			y = N;
+		}
+		R r = (altdeg > R(15)) ? high : D;
+		refraction[i] = (altdeg < R(-2) || altdeg >= R(90)) ? R(0) : r;
+	}
+}
+
+template<typename R, typename C>
+static void as_batch_sun_position(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, C *sun)
+{
+	as_batch_sun_equ<R>(n, tdt, sun->lon, sun->lat, sun->ra, sun->dec, sun->distance);
+	if (lat && lon) {
+		as_batch_altaz<R>(n, tdt, lat, lon, deltaT, sun->ra, sun->dec, sun->az, sun->alt);
+		if (sun->refraction) as_batch_refraction<R>(n, sun->alt, sun->refraction);
+	}
+}
+
+template<typename R, typename C>
+static void as_batch_moon_position(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, C *moon)
+{
+	as_batch_moon_equ<R>(n, tdt, moon->lon, moon->lat, moon->ra, moon->dec, moon->distance, moon->phase);
+	if (lat && lon) {
+		as_batch_topo<R>(n, tdt, lat, lon, deltaT, moon->ra, moon->dec, moon->distance);
+		as_batch_altaz<R>(n, tdt, lat, lon, deltaT, moon->ra, moon->dec, moon->az, moon->alt);
+		if (moon->refraction) as_batch_refraction<R>(n, moon->alt, moon->refraction);
+	}
+}
+
+void as_sun_position_batch(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, as_batch_coor *sun)
+{
+	as_batch_sun_position<double>(n, tdt, lat, lon, deltaT, sun);
+}
+
+void as_moon_position_batch(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, as_batch_coor *moon)
+{
+	as_batch_moon_position<double>(n, tdt, lat, lon, deltaT, moon);
+}
+
+void as_sun_position_batch_f32(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, as_batch_coorf *sun)
+{
+	as_batch_sun_position<float>(n, tdt, lat, lon, deltaT, sun);
+}
+
+void as_moon_position_batch_f32(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, as_batch_coorf *moon)
+{
+	as_batch_moon_position<float>(n, tdt, lat, lon, deltaT, moon);
+}
@@ -0,0 +1,71 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_BATCH_H
+#define ASTRO_BATCH_H
+
+#include <stddef.h>
+
+// Positions of many epochs in structure-of-arrays form. Every array holds n
+// elements and must be allocated by the caller. Angles are in radians,
+// distances in km.
+struct as_batch_coor {
+	double *lon;        // ecliptic longitude
+	double *lat;        // ecliptic latitude
+	double *ra;         // right ascension (topocentric for the moon if an observer is given)
+	double *dec;        // declination (topocentric for the moon if an observer is given)
+	double *distance;   // geocentric distance
+	double *az;         // azimuth, only set if an observer is given
+	double *alt;        // altitude without refraction, only set if an observer is given
+	double *refraction; // refraction correction (degrees) as of Astronomy::Refraction(), observer only (may be NULL)
+	double *phase;      // moon phase 0..1, only used for the moon (may be NULL for the sun)
+};
+
+// Same in float, for the float32 kernels
+struct as_batch_coorf {
+	float *lon;
+	float *lat;
+	float *ra;
+	float *dec;
+	float *distance;
+	float *az;
+	float *alt;
+	float *refraction;
+	float *phase;
+};
+
+// Calculate sun/moon positions for n epochs given as Julian dates in TDT.
+// lat/lon are per element geodetic observer coordinates in radians (East is
+// positive); pass NULL for both to get geocentric positions only. deltaT is
+// TDT - UT in seconds as used by the Astronomy class.
+// The kernels use branch free polynomial trigonometry and are compiled for
+// several instruction sets, the best one is selected at load time. Results
+// match the scalar Astronomy::SunPosition()/MoonPosition() to better than
+// 1e-9 rad (angles) and 1e-5 km (distances).
+void as_sun_position_batch(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, as_batch_coor *sun);
+void as_moon_position_batch(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, as_batch_coor *moon);
+
+// Float32 variants with twice the elements per vector, using the fast
+// polynomials of astro_math.h. Epochs and observer coordinates stay double;
+// the results differ from the double kernels by less than 5e-6 rad
+// (ecliptic/equatorial), 1e-5 rad (horizontal), 1e-6 relative (distances)
+// and 5e-6 (phase), see make fastmath-check.
+void as_sun_position_batch_f32(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, as_batch_coorf *sun);
+void as_moon_position_batch_f32(size_t n, const double *tdt, const double *lat, const double *lon, double deltaT, as_batch_coorf *moon);
+
+#endif  // ASTRO_BATCH_H
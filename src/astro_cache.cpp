@@ -0,0 +1,186 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include "astro_cache.h"
+
+#define AS_CACHE_KEY_WORDS          6
+#define AS_CACHE_WORDS              (AS_CACHE_KEY_WORDS + 1 + 2 * sizeof(as_cache_riseset) / sizeof(uint64_t))
+#define AS_CACHE_VALID              0x8000000000000000ULL   // set in the last key word of used entries
+
+// Words of an entry: key, calc, sun and moon events. All words are atomics,
+// a reader copies them and retries nothing: if the sequence number changed
+// meanwhile (or is odd while a writer is active) the lookup is a miss.
+struct alignas(64) as_cache_entry {
+	std::atomic<uint32_t> seq;
+	std::atomic<uint8_t> ref;   // CLOCK reference bit
+	std::atomic<uint64_t> word[AS_CACHE_WORDS];
+};
+
+static as_cache_entry *s_Cache = NULL;
+static std::atomic<uint8_t> *s_Hand = NULL;     // CLOCK hand of each set
+static size_t s_Sets = 0;                       // power of 2
+static double s_Quant = 0.0;
+
+static inline void as_cache_words(const as_cache_key *key, uint64_t *w)
+{
+	memcpy(&w[0], &key->JD0, sizeof(double));
+	memcpy(&w[1], &key->lon, sizeof(double));
+	memcpy(&w[2], &key->lat, sizeof(double));
+	memcpy(&w[3], &key->zone, sizeof(double));
+	memcpy(&w[4], &key->deltaT, sizeof(double));
+	w[5] = AS_CACHE_VALID | (key->grid ? 1 : 0) | ((uint64_t)key->precision << 1) | ((uint64_t)key->math << 3);
+}
+
+static inline size_t as_cache_set(const uint64_t *w)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ULL;
+	for (int i = 0; i < AS_CACHE_KEY_WORDS; i++) {
+		h = (h ^ w[i]) * 0xbf58476d1ce4e5b9ULL;
+		h ^= h >> 31;
+	}
+	return h & (s_Sets - 1);
+}
+
+static inline bool as_cache_match(const as_cache_entry *e, const uint64_t *w)
+{
+	for (int i = 0; i < AS_CACHE_KEY_WORDS; i++) {
+		if (e->word[i].load(std::memory_order_relaxed) != w[i]) return false;
+	}
+	return true;
+}
+
+bool as_cache_open(size_t bytes, double quant)
+{
+	as_cache_close();
+
+	size_t sets = 1;
+	while (sets * 2 * AS_CACHE_WAYS * sizeof(as_cache_entry) <= bytes) sets *= 2;
+	if (sets * AS_CACHE_WAYS * sizeof(as_cache_entry) > bytes) return false;
+
+	s_Cache = new (std::nothrow) as_cache_entry[sets * AS_CACHE_WAYS]();
+	s_Hand = new (std::nothrow) std::atomic<uint8_t>[sets]();
+	if (s_Cache == NULL || s_Hand == NULL) {
+		as_cache_close();
+		return false;
+	}
+	s_Sets = sets;
+	s_Quant = quant > 0.0 ? quant : 0.0;
+	return true;
+}
+
+void as_cache_close()
+{
+	delete[] s_Cache;
+	delete[] s_Hand;
+	s_Cache = NULL;
+	s_Hand = NULL;
+	s_Sets = 0;
+}
+
+bool as_cache_enabled()
+{
+	return s_Cache != NULL;
+}
+
+double as_cache_quant()
+{
+	return s_Quant;
+}
+
+size_t as_cache_entries()
+{
+	return s_Sets * AS_CACHE_WAYS;
+}
+
+bool as_cache_get(const as_cache_key *key, as_cache_value *value)
+{
+	uint64_t w[AS_CACHE_WORDS];
+	as_cache_words(key, w);
+	as_cache_entry *set = s_Cache + as_cache_set(w) * AS_CACHE_WAYS;
+
+	for (int i = 0; i < AS_CACHE_WAYS; i++) {
+		as_cache_entry *e = &set[i];
+		uint32_t seq = e->seq.load(std::memory_order_acquire);
+		if ((seq & 1) || !as_cache_match(e, w)) continue;
+		for (unsigned j = AS_CACHE_KEY_WORDS; j < AS_CACHE_WORDS; j++) {
+			w[j] = e->word[j].load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (e->seq.load(std::memory_order_relaxed) != seq) return false;
+
+		if (e->ref.load(std::memory_order_relaxed) == 0) e->ref.store(1, std::memory_order_relaxed);
+		value->calc = (unsigned)w[AS_CACHE_KEY_WORDS];
+		memcpy(&value->sun, &w[AS_CACHE_KEY_WORDS + 1], sizeof(as_cache_riseset));
+		memcpy(&value->moon, &w[AS_CACHE_KEY_WORDS + 1 + sizeof(as_cache_riseset) / sizeof(uint64_t)], sizeof(as_cache_riseset));
+		return true;
+	}
+	return false;
+}
+
+void as_cache_put(const as_cache_key *key, const as_cache_value *value)
+{
+	uint64_t w[AS_CACHE_WORDS];
+	as_cache_words(key, w);
+	w[AS_CACHE_KEY_WORDS] = value->calc;
+	memcpy(&w[AS_CACHE_KEY_WORDS + 1], &value->sun, sizeof(as_cache_riseset));
+	memcpy(&w[AS_CACHE_KEY_WORDS + 1 + sizeof(as_cache_riseset) / sizeof(uint64_t)], &value->moon, sizeof(as_cache_riseset));
+	size_t s = as_cache_set(w);
+	as_cache_entry *set = s_Cache + s * AS_CACHE_WAYS;
+
+	// the entry of the key (completed by more events), otherwise the CLOCK victim
+	as_cache_entry *e = NULL;
+	for (int i = 0; i < AS_CACHE_WAYS && e == NULL; i++) {
+		if (as_cache_match(&set[i], w)) e = &set[i];
+	}
+	for (int n = 0; n < 2 * AS_CACHE_WAYS && e == NULL; n++) {
+		as_cache_entry *c = &set[s_Hand[s].fetch_add(1, std::memory_order_relaxed) % AS_CACHE_WAYS];
+		if (c->ref.load(std::memory_order_relaxed) == 0) e = c;
+		else c->ref.store(0, std::memory_order_relaxed);
+	}
+	if (e == NULL) return;
+
+	uint32_t seq = e->seq.load(std::memory_order_relaxed);
+	if ((seq & 1) || !e->seq.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed)) {
+		return;     // written by another thread
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	for (unsigned j = 0; j < AS_CACHE_WORDS; j++) {
+		e->word[j].store(w[j], std::memory_order_relaxed);
+	}
+	e->ref.store(0, std::memory_order_relaxed);
+	e->seq.store(seq + 2, std::memory_order_release);
+}
+
+// Create the cache when the library is loaded
+static struct as_cache_autoload {
+	as_cache_autoload() {
+		const char *size = getenv(AS_CACHE_ENV_SIZE);
+		const char *quant = getenv(AS_CACHE_ENV_QUANT);
+		double megabytes = size != NULL ? atof(size) : AS_CACHE_SIZE;
+		if (megabytes > 0.0) {
+			as_cache_open((size_t)(megabytes * 1024 * 1024), quant != NULL ? atof(quant) : 0.0);
+		}
+	}
+	~as_cache_autoload() {
+		as_cache_close();
+	}
+} s_CacheAutoload;
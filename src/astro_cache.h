@@ -0,0 +1,80 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_CACHE_H
+#define ASTRO_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Rise/set results shared by all connections
+//
+// Rise/set times only depend on the day, location, zone, deltaT, precision and
+// trigonometry, so the results can be kept in one bounded table created when
+// the library is loaded. The table takes server memory, so it is opt-in.
+// The table is 4-way set associative with CLOCK eviction within a set; each
+// entry is guarded by a sequence number, readers never block and writers
+// skip an entry that is being written by another thread. Locations can be
+// quantized so that nearby sites share one entry (calculated at the center
+// of the cell).
+//
+// $ASTRO_CACHE_SIZE: size in megabytes (default 0: no cache)
+// $ASTRO_CACHE_QUANT: quantization of latitude/longitude in degrees (default 0: exact),
+//                     results are then calculated at the center of the cell
+
+#define AS_CACHE_ENV_SIZE           "ASTRO_CACHE_SIZE"
+#define AS_CACHE_ENV_QUANT          "ASTRO_CACHE_QUANT"
+#define AS_CACHE_SIZE               0       // default size in megabytes (disabled)
+#define AS_CACHE_WAYS               4       // entries per set
+
+struct as_cache_key {
+	double JD0;                 // local day
+	double lon, lat;            // location (radians), quantized
+	double zone;
+	double deltaT;
+	bool grid;                  // sun rise/set from the rise/set grid
+	unsigned precision;         // AS_PRECISION of the rise/set times
+	unsigned math;              // AS_MATH of the engine
+};
+
+// Events of the sun (all) or the moon (rise, transit, set), hours local time
+struct as_cache_riseset {
+	double rise, transit, set;
+	double civilMorning, civilEvening;
+	double nauticalMorning, nauticalEvening;
+	double astronomicalMorning, astronomicalEvening;
+};
+
+struct as_cache_value {
+	unsigned calc;              // AS_CALC_SUNRISE and/or AS_CALC_MOONRISE if valid
+	as_cache_riseset sun;
+	as_cache_riseset moon;
+};
+
+bool as_cache_open(size_t bytes, double quant);
+void as_cache_close();
+bool as_cache_enabled();
+double as_cache_quant();                    // degrees, 0 if exact
+size_t as_cache_entries();
+
+// Copies the cached value of key, false if there is none
+bool as_cache_get(const as_cache_key *key, as_cache_value *value);
+// Stores the value of key, replacing an older one
+void as_cache_put(const as_cache_key *key, const as_cache_value *value);
+
+#endif  // ASTRO_CACHE_H
@@ -0,0 +1,151 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include <math.h>
+#include <string>
+#include "astro_file.h"
+#include "astro_ephem.h"
+
+static const as_ephem_header *s_Ephem = NULL;
+static size_t s_EphemSize = 0;
+
+// Map an ephemeris file, returns false if it is missing or invalid
+bool as_ephem_open(const char *path)
+{
+	as_ephem_close();
+
+	size_t size;
+	const void *map = as_file_map(path, &size);
+	if (map == NULL) return false;
+
+	const as_ephem_header *hdr = (const as_ephem_header *)map;
+	bool valid = size >= sizeof(as_ephem_header)
+	             && memcmp(hdr->magic, AS_EPHEM_MAGIC, sizeof(hdr->magic)) == 0
+	             && hdr->version == AS_EPHEM_VERSION
+	             && hdr->bodies == AS_EPHEM_BODIES;
+	for (int b = 0; valid && b < AS_EPHEM_BODIES; b++) {
+		const as_ephem_body &body = hdr->body[b];
+		uint64_t end = body.offset + (uint64_t)body.segments * (body.order + 1) * body.values;
+		valid = body.days > 0.0 && body.segments > 0
+		        && body.values == (b == AS_EPHEM_SUN ? (uint32_t)AS_EPHEM_SUN_VALUES : (uint32_t)AS_EPHEM_MOON_VALUES)
+		        && hdr->start + body.days * body.segments >= hdr->end
+		        && sizeof(as_ephem_header) + end * sizeof(double) <= size;
+	}
+	if (!valid) {
+		as_file_unmap(map, size);
+		return false;
+	}
+	s_Ephem = hdr;
+	s_EphemSize = size;
+	return true;
+}
+
+void as_ephem_close()
+{
+	if (s_Ephem != NULL) {
+		as_file_unmap(s_Ephem, s_EphemSize);
+		s_Ephem = NULL;
+		s_EphemSize = 0;
+	}
+}
+
+bool as_ephem_loaded()
+{
+	return s_Ephem != NULL;
+}
+
+// as_ephem_chebyshev() for the fixed number of values of a body
+template <unsigned COUNT>
+static inline void as_ephem_clenshaw(const double *coeff, unsigned order, double x, double *values)
+{
+	double b1[COUNT] = {0.0}, b2[COUNT] = {0.0};
+	double x2 = 2.0 * x;
+	for (unsigned k = order; k > 0; k--) {
+		const double *c = coeff + k * COUNT;
+		for (unsigned v = 0; v < COUNT; v++) {
+			double b = x2 * b1[v] - b2[v] + c[v];
+			b2[v] = b1[v];
+			b1[v] = b;
+		}
+	}
+	for (unsigned v = 0; v < COUNT; v++) values[v] = x * b1[v] - b2[v] + coeff[v];
+}
+
+bool as_ephem_eval(AS_EPHEM_BODY b, double TDT, double *values)
+{
+	const as_ephem_header *hdr = s_Ephem;
+	if (hdr == NULL || !(TDT >= hdr->start && TDT < hdr->end)) return false;
+
+	const as_ephem_body &body = hdr->body[b];
+	double t = (TDT - hdr->start) / body.days;
+	uint32_t segment = (uint32_t)t;
+	if (segment >= body.segments) segment = body.segments - 1;
+	const double *coeff = (const double *)(hdr + 1) + body.offset + (uint64_t)segment * (body.order + 1) * body.values;
+	double x = 2.0 * (t - segment) - 1.0;
+	if (b == AS_EPHEM_SUN) as_ephem_clenshaw<AS_EPHEM_SUN_VALUES>(coeff, body.order, x, values);
+	else as_ephem_clenshaw<AS_EPHEM_MOON_VALUES>(coeff, body.order, x, values);
+	return true;
+}
+
+// Clenshaw evaluation of sum(coeff[k][v] * T_k(x)) for count values at once
+void as_ephem_chebyshev(const double *coeff, unsigned order, unsigned count, double x, double *values)
+{
+	double b1[AS_EPHEM_MAX_VALUES] = {0.0};
+	double b2[AS_EPHEM_MAX_VALUES] = {0.0};
+	for (unsigned k = order; k > 0; k--) {
+		for (unsigned v = 0; v < count && v < AS_EPHEM_MAX_VALUES; v++) {
+			double b = 2.0 * x * b1[v] - b2[v] + coeff[k * count + v];
+			b2[v] = b1[v];
+			b1[v] = b;
+		}
+	}
+	for (unsigned v = 0; v < count && v < AS_EPHEM_MAX_VALUES; v++) {
+		values[v] = x * b1[v] - b2[v] + coeff[v];
+	}
+}
+
+// k-th of the order+1 Chebyshev nodes in [-1, 1]
+double as_ephem_node(unsigned k, unsigned order)
+{
+	return cos(M_PI * (k + 0.5) / (order + 1));
+}
+
+// Interpolating coefficients from the values at the Chebyshev nodes
+void as_ephem_fit(const double *values, unsigned order, double *coeff)
+{
+	unsigned n = order + 1;
+	for (unsigned j = 0; j < n; j++) {
+		double sum = 0.0;
+		for (unsigned k = 0; k < n; k++) {
+			sum += values[k] * cos(M_PI * j * (k + 0.5) / n);
+		}
+		coeff[j] = (j == 0 ? 1.0 : 2.0) * sum / n;
+	}
+}
+
+// Map the ephemeris when the library is loaded
+static struct as_ephem_autoload {
+	as_ephem_autoload() {
+		std::string path = as_file_path(AS_EPHEM_ENV, NULL);
+		if (!path.empty()) as_ephem_open(path.c_str());
+	}
+	~as_ephem_autoload() {
+		as_ephem_close();
+	}
+} s_EphemAutoload;
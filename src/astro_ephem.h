@@ -0,0 +1,103 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_EPHEM_H
+#define ASTRO_EPHEM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Precalculated sun and moon positions as Chebyshev polynomials
+//
+// The file is created by 'make ephemeris' from the analytic SunPosition()/
+// MoonPosition() models and mapped into memory when the library is loaded.
+// The interpolated positions differ in the last printed digit now and then,
+// so the file is opt-in: it is only used if $ASTRO_EPHEMERIS names it (a
+// name without '/' next to the library file); without a (valid) file the
+// analytic models are used.
+
+#define AS_EPHEM_MAGIC              "ASEPHEM"
+#define AS_EPHEM_VERSION            2
+#define AS_EPHEM_FILE               "lib_mysqludf_astro.eph"
+#define AS_EPHEM_ENV                "ASTRO_EPHEMERIS"
+#define AS_EPHEM_START              2415020.5   // 1900-01-01, TDT
+#define AS_EPHEM_END                2488434.5   // 2101-01-01, TDT
+
+// Bodies of the file, all values of a body share the segments
+enum AS_EPHEM_BODY {
+	AS_EPHEM_SUN,
+	AS_EPHEM_MOON,
+	AS_EPHEM_BODIES
+};
+
+// Values of AS_EPHEM_SUN, the equatorial coordinates replace Ecl2Equ()
+enum {
+	AS_EPHEM_SUN_LON,           // ecliptic longitude (rad)
+	AS_EPHEM_SUN_DIST,          // distance (AU)
+	AS_EPHEM_SUN_RA,            // right ascension (rad)
+	AS_EPHEM_SUN_DEC,           // declination (rad)
+	AS_EPHEM_SUN_VALUES
+};
+
+// Values of AS_EPHEM_MOON (geocentric)
+enum {
+	AS_EPHEM_MOON_LON,          // ecliptic longitude (rad)
+	AS_EPHEM_MOON_LAT,          // ecliptic latitude (rad)
+	AS_EPHEM_MOON_ORBITLON,     // true orbital longitude (rad)
+	AS_EPHEM_MOON_DIST,         // distance relative to the semi major axis
+	AS_EPHEM_MOON_RA,           // right ascension (rad)
+	AS_EPHEM_MOON_DEC,          // declination (rad)
+	AS_EPHEM_MOON_VALUES
+};
+
+#define AS_EPHEM_MAX_VALUES         6
+
+struct as_ephem_body {
+	double days;                // segment length in days
+	uint32_t order;             // polynomial order, order+1 coefficients per value and segment
+	uint32_t values;            // number of values
+	uint32_t segments;          // number of segments
+	uint32_t reserved;
+	uint64_t offset;            // index of the first coefficient
+};
+
+// File layout: header followed by all coefficients (double, host byte order),
+// per segment ordered by coefficient and then value. Longitudes and right
+// ascensions are continuous within a segment (not reduced to 0..2pi).
+struct as_ephem_header {
+	char magic[8];              // AS_EPHEM_MAGIC
+	uint32_t version;           // AS_EPHEM_VERSION
+	uint32_t bodies;            // AS_EPHEM_BODIES
+	double start;               // TDT of the first segment
+	double end;                 // TDT of the end of the last segment
+	as_ephem_body body[AS_EPHEM_BODIES];
+};
+
+bool as_ephem_open(const char *path);
+void as_ephem_close();
+bool as_ephem_loaded();
+
+// Values of a body at TDT, false if not loaded or TDT is out of range
+bool as_ephem_eval(AS_EPHEM_BODY body, double TDT, double *values);
+
+// Chebyshev polynomial helpers, x in [-1, 1]
+void as_ephem_chebyshev(const double *coeff, unsigned order, unsigned count, double x, double *values);
+void as_ephem_fit(const double *values, unsigned order, double *coeff);
+double as_ephem_node(unsigned k, unsigned order);
+
+#endif  // ASTRO_EPHEM_H
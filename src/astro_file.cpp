@@ -0,0 +1,63 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "astro_file.h"
+
+const void *as_file_map(const char *path, size_t *size)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return NULL;
+	*size = st.st_size;
+	return map;
+}
+
+void as_file_unmap(const void *map, size_t size)
+{
+	if (map != NULL) munmap((void *)map, size);
+}
+
+std::string as_file_path(const char *env, const char *name)
+{
+	const char *path = getenv(env);
+	if (path != NULL) {
+		if (*path == '\0' || strchr(path, '/') != NULL) return path;
+		name = path;
+	}
+	if (name == NULL) return "";
+
+	Dl_info info;
+	if (!dladdr((void *)&as_file_path, &info) || info.dli_fname == NULL) return name;
+	std::string file(info.dli_fname);
+	size_t slash = file.rfind('/');
+	return (slash == std::string::npos) ? name : file.substr(0, slash + 1) + name;
+}
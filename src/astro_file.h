@@ -0,0 +1,36 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_FILE_H
+#define ASTRO_FILE_H
+
+#include <stddef.h>
+#include <string>
+
+// Read only data files (ephemeris, rise/set grid) mapped into memory
+
+// Map a file read only, returns NULL if it can not be opened
+const void *as_file_map(const char *path, size_t *size);
+void as_file_unmap(const void *map, size_t size);
+
+// Path of a data file: $env if set (empty if disabled, a name without '/' is
+// taken from the directory of the library), otherwise name in the directory
+// of the library. Without $env opt-in files (name NULL) are not used (empty).
+std::string as_file_path(const char *env, const char *name);
+
+#endif  // ASTRO_FILE_H
@@ -0,0 +1,160 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include "astro_file.h"
+#include "astro_grid.h"
+
+static const as_grid_header *s_Grid = NULL;
+static size_t s_GridSize = 0;
+
+// Map a rise/set grid file, returns false if it is missing or invalid
+bool as_grid_open(const char *path)
+{
+	as_grid_close();
+
+	size_t size;
+	const void *map = as_file_map(path, &size);
+	if (map == NULL) return false;
+
+	const as_grid_header *hdr = (const as_grid_header *)map;
+	bool valid = size >= sizeof(as_grid_header)
+	             && memcmp(hdr->magic, AS_GRID_MAGIC, sizeof(AS_GRID_MAGIC)) == 0
+	             && hdr->version == AS_GRID_VERSION
+	             && hdr->events == AS_GRID_EVENTS
+	             && hdr->days > 0 && hdr->lats > 1 && hdr->lons > 1
+	             && hdr->dlat > 0.0 && hdr->dlon > 0.0
+	             && sizeof(as_grid_header) + (uint64_t)hdr->days * hdr->lats * hdr->lons * AS_GRID_EVENTS * sizeof(uint16_t) <= size;
+	if (!valid) {
+		as_file_unmap(map, size);
+		return false;
+	}
+	s_Grid = hdr;
+	s_GridSize = size;
+	return true;
+}
+
+void as_grid_close()
+{
+	if (s_Grid != NULL) {
+		as_file_unmap(s_Grid, s_GridSize);
+		s_Grid = NULL;
+		s_GridSize = 0;
+	}
+}
+
+bool as_grid_loaded()
+{
+	return s_Grid != NULL;
+}
+
+const as_grid_header *as_grid_info()
+{
+	return s_Grid;
+}
+
+bool as_grid_sunrise(double jd0UT, double lat, double lon, double deltaT, double *events)
+{
+	const as_grid_header *hdr = s_Grid;
+	if (hdr == NULL || deltaT != hdr->deltaT) return false;
+
+	double day = jd0UT - hdr->day0;
+	double y = (lat - hdr->lat0) / hdr->dlat;
+	double x = (lon - hdr->lon0) / hdr->dlon;
+	if (!(day >= 0.0 && day < hdr->days && y >= 0.0 && y <= hdr->lats - 1 && x >= 0.0 && x <= hdr->lons - 1)) {
+		return false;
+	}
+	if (day != floor(day)) return false;
+
+	// lower left grid point, the last row/column interpolates from the one before
+	uint32_t i = (uint32_t)y < hdr->lats - 1 ? (uint32_t)y : hdr->lats - 2;
+	uint32_t j = (uint32_t)x < hdr->lons - 1 ? (uint32_t)x : hdr->lons - 2;
+	double fy = y - i;
+	double fx = x - j;
+
+	uint64_t row = (uint64_t)hdr->lons * AS_GRID_EVENTS;
+	const uint16_t *p = (const uint16_t *)(hdr + 1) + ((uint64_t)day * hdr->lats + i) * row + j * AS_GRID_EVENTS;
+	const uint16_t *q = p + row;
+	for (int e = 0; e < AS_GRID_EVENTS; e++) {
+		uint16_t v00 = p[e], v01 = p[e + AS_GRID_EVENTS];
+		uint16_t v10 = q[e], v11 = q[e + AS_GRID_EVENTS];
+		if (v00 == AS_GRID_NONE && v01 == AS_GRID_NONE && v10 == AS_GRID_NONE && v11 == AS_GRID_NONE) {
+			// polar day/night around the site, unless the event appears in the rows below or above
+			for (int c = e; c <= e + AS_GRID_EVENTS; c += AS_GRID_EVENTS) {
+				if ((i > 0 && p[c - row] != AS_GRID_NONE) || (i + 2 < hdr->lats && q[c + row] != AS_GRID_NONE)) {
+					return false;
+				}
+			}
+			events[e] = NAN;
+			continue;
+		}
+		uint16_t lo = v00, hi = v00;
+		if (v01 < lo) lo = v01;
+		if (v01 > hi) hi = v01;
+		if (v10 < lo) lo = v10;
+		if (v10 > hi) hi = v10;
+		if (v11 < lo) lo = v11;
+		if (v11 > hi) hi = v11;
+		// AS_GRID_NONE/AS_GRID_RANGE at a grid point or an event changing too fast
+		if (hi >= AS_GRID_RANGE || hi - lo > AS_GRID_SPREAD) return false;
+
+		// times bend sharply towards polar day/night: check the second difference
+		// along the latitude with the rows below and above
+		for (int c = e; c <= e + AS_GRID_EVENTS; c += AS_GRID_EVENTS) {
+			if (i > 0 && (p[c - row] >= AS_GRID_RANGE || abs(p[c - row] - 2 * p[c] + q[c]) > AS_GRID_CURVATURE)) {
+				return false;
+			}
+			if (i + 2 < hdr->lats && (q[c + row] >= AS_GRID_RANGE || abs(p[c] - 2 * q[c] + q[c + row]) > AS_GRID_CURVATURE)) {
+				return false;
+			}
+		}
+
+		double v0 = v00 + fx * (v01 - v00);
+		double v1 = v10 + fx * (v11 - v10);
+		events[e] = (v0 + fy * (v1 - v0)) / AS_GRID_SCALE - AS_GRID_OFFSET;
+	}
+	return true;
+}
+
+uint16_t as_grid_encode(double hours)
+{
+	if (isnan(hours)) return AS_GRID_NONE;
+	double v = floor((hours + AS_GRID_OFFSET) * AS_GRID_SCALE + 0.5);
+	if (!(v >= 0.0 && v < AS_GRID_RANGE)) return AS_GRID_RANGE;
+	return (uint16_t)v;
+}
+
+double as_grid_decode(uint16_t value)
+{
+	if (value >= AS_GRID_RANGE) return NAN;
+	return value / AS_GRID_SCALE - AS_GRID_OFFSET;
+}
+
+// Map the grid when the library is loaded
+static struct as_grid_autoload {
+	as_grid_autoload() {
+		std::string path = as_file_path(AS_GRID_ENV, AS_GRID_FILE);
+		if (!path.empty()) as_grid_open(path.c_str());
+	}
+	~as_grid_autoload() {
+		as_grid_close();
+	}
+} s_GridAutoload;
@@ -0,0 +1,91 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_GRID_H
+#define ASTRO_GRID_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Precalculated sun rise/set grid
+//
+// The file is created by tools/astro_grid_gen for a lat/lon grid and a range
+// of UTC days and mapped into memory when the library is loaded. It is
+// searched at $ASTRO_GRID, or next to the library file. The times of a site
+// are interpolated bilinearly from the four surrounding grid points; sites
+// near polar day/night (an event missing at some of the grid points, or the
+// times bending too sharply between them) are left to the exact calculation.
+
+#define AS_GRID_MAGIC               "ASGRID"
+#define AS_GRID_VERSION             1
+#define AS_GRID_FILE                "lib_mysqludf_astro.grid"
+#define AS_GRID_ENV                 "ASTRO_GRID"
+
+#define AS_GRID_SCALE               1200.0  // quantization steps per hour (3 seconds)
+#define AS_GRID_OFFSET              12.0    // hours added before quantization (UTC times range from -12 to 36)
+#define AS_GRID_NONE                0xffff  // event does not happen on the day
+#define AS_GRID_RANGE               0xfffe  // event out of the quantization range
+#define AS_GRID_SPREAD              800     // max. difference of the grid points (steps) to interpolate
+#define AS_GRID_CURVATURE           10      // max. second difference along the latitude (steps) to interpolate
+#define AS_GRID_MARGIN              60.0    // seconds around the local day boundary left to the exact calculation
+
+// Events of a UTC day (hours UTC as RiseSet(), not reduced to 0..24)
+enum AS_GRID_EVENT {
+	AS_GRID_RISE,
+	AS_GRID_TRANSIT,
+	AS_GRID_SET,
+	AS_GRID_CIVIL_MORNING,
+	AS_GRID_CIVIL_EVENING,
+	AS_GRID_NAUTICAL_MORNING,
+	AS_GRID_NAUTICAL_EVENING,
+	AS_GRID_ASTRONOMICAL_MORNING,
+	AS_GRID_ASTRONOMICAL_EVENING,
+	AS_GRID_EVENTS
+};
+
+// File layout: header followed by uint16_t (host byte order) values
+// [day][lat][lon][event], quantized as (hours + AS_GRID_OFFSET) * AS_GRID_SCALE
+struct as_grid_header {
+	char magic[8];              // AS_GRID_MAGIC
+	uint32_t version;           // AS_GRID_VERSION
+	uint32_t events;            // AS_GRID_EVENTS
+	double deltaT;              // seconds TDT - UT of the calculation
+	double day0;                // JD (0h UT) of the first day
+	uint32_t days;
+	uint32_t lats;
+	uint32_t lons;
+	uint32_t reserved;
+	double lat0, dlat;          // first latitude and step (degrees)
+	double lon0, dlon;          // first longitude and step (degrees)
+};
+
+bool as_grid_open(const char *path);
+void as_grid_close();
+bool as_grid_loaded();
+const as_grid_header *as_grid_info();     // header of the loaded grid, NULL if not loaded
+
+// Interpolated events of the UTC day jd0UT at lat/lon (degrees), NAN for
+// events that do not happen; false if the grid is not loaded, does not cover
+// the request or can not interpolate
+bool as_grid_sunrise(double jd0UT, double lat, double lon, double deltaT, double *events);
+
+// Quantization of a single event
+uint16_t as_grid_encode(double hours);
+double as_grid_decode(uint16_t value);
+
+#endif  // ASTRO_GRID_H
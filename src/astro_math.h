@@ -0,0 +1,249 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_MATH_H
+#define ASTRO_MATH_H
+
+#include <math.h>
+
+// Loops using the functions are only vectorized if they are inlined, which
+// the inliner does not guarantee for large loops
+#if defined(__GNUC__)
+#define AS_MATH_INLINE static inline __attribute__((always_inline))
+#else
+#define AS_MATH_INLINE static inline
+#endif
+
+// Branch free double precision trigonometric functions (polynomial kernels
+// of fdlibm), written with selects instead of branches so that loops using
+// them can be vectorized by the compiler. Accuracy is about 1-2 ulp for
+// arguments up to |x| < 1e5, which covers all angles used by the Astronomy
+// class.
+
+// pi/2 split for Cody-Waite argument reduction
+#define AS_PIO2_1       1.57079632673412561417e+00
+#define AS_PIO2_2       6.07710050630396597660e-11
+#define AS_PIO2_2T      2.02226624879595063154e-21
+
+// Reduce x to r in [-pi/4, pi/4] with x = r + q * pi/2, returns q mod 4 in 0..3
+AS_MATH_INLINE double as_reduce_pio2(double x, double *r)
+{
+	double q = floor(x * (2.0 / M_PI) + 0.5);
+	*r = ((x - q * AS_PIO2_1) - q * AS_PIO2_2) - q * AS_PIO2_2T;
+	return q - 4.0 * floor(q * 0.25);
+}
+
+AS_MATH_INLINE double as_sin_kernel(double x)
+{
+	double z = x * x;
+	return x + x * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04
+	         + z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+}
+
+AS_MATH_INLINE double as_cos_kernel(double x)
+{
+	double z = x * x;
+	return 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05
+	         + z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+}
+
+// sin/cos of x = r + q * pi/2 from sr = sin(r), cr = cos(r) and q in 0..3
+template<typename T> AS_MATH_INLINE void as_sincos_quadrant(T q, T sr, T cr, T *s, T *c)
+{
+	// quadrant 0: ( s, c), 1: ( c,-s), 2: (-s,-c), 3: (-c, s)
+	bool odd = (q - T(2) * floor(q * T(0.5))) != T(0);
+	T sv = odd ? cr : sr;
+	T cv = odd ? sr : cr;
+	*s = (q >= T(2)) ? -sv : sv;
+	*c = (fabs(q - T(1.5)) < T(1)) ? -cv : cv;
+}
+
+AS_MATH_INLINE void as_sincos(double x, double *s, double *c)
+{
+	double r;
+	double q = as_reduce_pio2(x, &r);
+	as_sincos_quadrant(q, as_sin_kernel(r), as_cos_kernel(r), s, c);
+}
+
+AS_MATH_INLINE double as_sin(double x)
+{
+	double s, c;
+	as_sincos(x, &s, &c);
+	return s;
+}
+
+AS_MATH_INLINE double as_cos(double x)
+{
+	double s, c;
+	as_sincos(x, &s, &c);
+	return c;
+}
+
+// atan(t) for 0 <= t <= 1
+AS_MATH_INLINE double as_atan01(double t)
+{
+	// reduce to |t| <= tan(pi/8) using atan(t) = pi/4 + atan((t-1)/(t+1))
+	bool big = t > 0.41421356237309504880;
+	double x = big ? (t - 1.0) / (t + 1.0) : t;  // t + 1 >= 1, evaluating both sides is safe
+	double z = x * x;
+	double p = z * (3.33333333333329318027e-01 + z * (-1.99999999998764832476e-01 + z * (1.42857142725034663711e-01
+	         + z * (-1.11111104054623557880e-01 + z * (9.09088713343650656196e-02 + z * (-7.69187620504482999495e-02
+	         + z * (6.66107313738753120669e-02 + z * (-5.83357013379057348645e-02 + z * (4.97687799461593236017e-02
+	         + z * (-3.65315727442169155270e-02 + z * 1.62858201153657823623e-02))))))))));
+	double r = x - x * p;
+	return big ? (M_PI / 4.0) + r : r;
+}
+
+AS_MATH_INLINE double as_atan2(double y, double x)
+{
+	double ay = fabs(y);
+	double ax = fabs(x);
+	bool swap = ay > ax;
+	double num = swap ? ax : ay;
+	double den = swap ? ay : ax;
+	double t = num / ((den == 0.0) ? 1.0 : den);  // num <= den, so 0/0 yields 0
+	double r = as_atan01(t);
+	r = swap ? (M_PI / 2.0) - r : r;
+	r = (x < 0.0) ? M_PI - r : r;
+	return (y < 0.0) ? -r : r;
+}
+
+AS_MATH_INLINE double as_asin(double x)
+{
+	return as_atan2(x, sqrt((1.0 - x) * (1.0 + x)));
+}
+
+AS_MATH_INLINE double as_acos(double x)
+{
+	return as_atan2(sqrt((1.0 - x) * (1.0 + x)), x);
+}
+
+AS_MATH_INLINE double as_mod2pi(double x)
+{
+	return x - floor(x / (2.0 * M_PI)) * (2.0 * M_PI);
+}
+
+// Fast variants with shorter minimax polynomials: degree 7/8 for sin/cos on
+// [-pi/4, pi/4], degree 9 for atan on [0, tan(pi/8)] and degree 11 for asin
+// on [0, 0.5]. The errors are below 2e-9 (sin/cos), 5e-9 (atan2) and 4e-9
+// (asin/acos) rad, far below the arc minute accuracy of the sun/moon models.
+// The double sin/cos round the quadrant with the 1.5 * 2^52 trick instead of
+// floor(), which is a library call on plain x86-64. The float overloads add
+// the float rounding (about 1e-7 relative) and expect arguments reduced to a
+// few turns. tools/astro_fastmath.cpp checks the bounds against libm.
+
+template<typename T> AS_MATH_INLINE T as_fast_sin_kernel(T x)
+{
+	T z = x * x;
+	return x + x * z * (T(-1.66666506692916372763e-01) + z * (T(8.33197866305831080034e-03) + z * T(-1.94956362282663960670e-04)));
+}
+
+template<typename T> AS_MATH_INLINE T as_fast_cos_kernel(T x)
+{
+	T z = x * x;
+	return T(1) - T(0.5) * z + z * z * (T(4.16666468664347342650e-02) + z * (T(-1.38873675154138501876e-03) + z * T(2.44384515613306736398e-05)));
+}
+
+template<typename T> AS_MATH_INLINE T as_fast_atan01(T t)
+{
+	bool big = t > T(0.41421356237309504880);
+	T x = big ? (t - T(1)) / (t + T(1)) : t;
+	T z = x * x;
+	T p = z * (T(-3.33327566692404446571e-01) + z * (T(1.99718793094725516218e-01)
+	    + z * (T(-1.38244537849550934693e-01) + z * T(7.90259825084176424395e-02))));
+	T r = x + x * p;
+	return big ? T(M_PI / 4.0) + r : r;
+}
+
+template<typename T> AS_MATH_INLINE T as_fast_atan2(T y, T x)
+{
+	T ay = fabs(y);
+	T ax = fabs(x);
+	bool swap = ay > ax;
+	T num = swap ? ax : ay;
+	T den = swap ? ay : ax;
+	T r = as_fast_atan01(num / ((den == T(0)) ? T(1) : den));
+	r = swap ? T(M_PI / 2.0) - r : r;
+	r = (x < T(0)) ? T(M_PI) - r : r;
+	return (y < T(0)) ? -r : r;
+}
+
+// asin(a) for 0 <= a <= 1, using asin(a) = pi/2 - 2 asin(sqrt((1-a)/2)) above 0.5.
+// *big tells which side, NAN for a > 1
+template<typename T> AS_MATH_INLINE T as_fast_asin01(T a, bool *big)
+{
+	*big = a > T(0.5);
+	T z = *big ? (T(1) - a) * T(0.5) : a * a;
+	T x = *big ? T(sqrt(z)) : a;
+	T p = x + x * z * (T(1.66668215296121545170e-01) + z * (T(7.49307718704093657228e-02) + z * (T(4.57077869001934465495e-02)
+	    + z * (T(2.31422873521532604293e-02) + z * T(4.37630365857226394621e-02)))));
+	return p;
+}
+
+template<typename T> AS_MATH_INLINE T as_fast_asin(T x)
+{
+	bool big;
+	T p = as_fast_asin01(T(fabs(x)), &big);
+	T r = big ? T(M_PI / 2.0) - T(2) * p : p;
+	return (x < T(0)) ? -r : r;
+}
+
+template<typename T> AS_MATH_INLINE T as_fast_acos(T x)
+{
+	bool big;
+	T p = as_fast_asin01(T(fabs(x)), &big);
+	T r = T(M_PI / 2.0) - ((x < T(0)) ? -p : p);       // |x| <= 0.5
+	T rbig = (x < T(0)) ? T(M_PI) - T(2) * p : T(2) * p; // |x| > 0.5
+	return big ? rbig : r;
+}
+
+AS_MATH_INLINE void as_fast_sincos(double x, double *s, double *c)
+{
+	const double round = 6755399441055744.0;       // 1.5 * 2^52
+	double k = x * (2.0 / M_PI) + round;
+	double q = k - round;
+	double r = (x - q * AS_PIO2_1) - q * AS_PIO2_2;
+	long long n = (long long)q;
+	double sr = as_fast_sin_kernel(r);
+	double cr = as_fast_cos_kernel(r);
+	// quadrant 0: ( s, c), 1: ( c,-s), 2: (-s,-c), 3: (-c, s)
+	double sv = (n & 1) ? cr : sr;
+	double cv = (n & 1) ? sr : cr;
+	*s = (n & 2) ? -sv : sv;
+	*c = ((n + 1) & 2) ? -cv : cv;
+}
+
+// pi/2 split into three floats (Cody-Waite), exact enough for the few turns used here
+#define AS_PIO2F_1      1.5703125f
+#define AS_PIO2F_2      4.837512969970703125e-4f
+#define AS_PIO2F_3      7.54978995489188216e-8f
+
+AS_MATH_INLINE void as_fast_sincos(float x, float *s, float *c)
+{
+	float q = floorf(x * float(2.0 / M_PI) + 0.5f);
+	float r = ((x - q * AS_PIO2F_1) - q * AS_PIO2F_2) - q * AS_PIO2F_3;
+	q -= 4.0f * floorf(q * 0.25f);
+	as_sincos_quadrant(q, as_fast_sin_kernel(r), as_fast_cos_kernel(r), s, c);
+}
+
+AS_MATH_INLINE float as_fast_mod2pi(float x)
+{
+	return x - floorf(x * float(0.5 / M_PI)) * float(2.0 * M_PI);
+}
+
+#endif  // ASTRO_MATH_H
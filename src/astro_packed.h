@@ -0,0 +1,137 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_PACKED_H
+#define ASTRO_PACKED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Binary result of astro_packed()
+//
+// A fixed layout record of all astro() result values, to be stored instead of
+// the JSON result (BINARY(AS_PACKED_SIZE)) and read with astro_unpack() or
+// directly at the offsets of struct as_packed. All values are little endian,
+// the struct has no padding.
+//
+// Values the JSON result shows with decimals are integers scaled by the power
+// of ten of these decimals (e.g. Sun.Azimuth 123.45 is 12345), times are the
+// seconds of the day (GMST, LMST, ascensions and the events of the local day).
+// AS_PACKED_NONE marks a missing value (no such event on the day). Phase and
+// signs are indices of Astronomy::LUNARPHASE (0 new moon ... 7 waning crescent)
+// and Astronomy::SIGN (0 aries ... 11 pisces).
+//
+// The version changes with every change of the layout.
+
+#define AS_PACKED_VERSION           1
+#define AS_PACKED_SIZE              168
+#define AS_PACKED_NONE              INT32_MIN
+
+struct as_packed {
+	uint8_t version;                //   0 AS_PACKED_VERSION
+	uint8_t sun_zodiac;             //   1 Sun.Zodiac (sign)
+	uint8_t moon_sign;              //   2 Moon.Sign (sign)
+	uint8_t moon_phase;             //   3 Moon.Phase.Value, Moon.Phase.Name (phase)
+	uint16_t year;                  //   4 Time (local)
+	uint8_t month;                  //   6
+	uint8_t day;                    //   7
+	uint8_t hour;                   //   8
+	uint8_t minute;                 //   9
+	uint8_t second;                 //  10
+	uint8_t reserved;               //  11 0
+	int32_t zone;                   //  12 Zone (hours)
+	double julian_date;             //  16 JulianDate
+	int32_t latitude;               //  24 Latitude (1e-6 degrees)
+	int32_t longitude;              //  28 Longitude (1e-6 degrees)
+	int32_t delta_t;                //  32 deltaT (seconds)
+	int32_t gmst;                   //  36 GMST (seconds)
+	int32_t lmst;                   //  40 LMST (seconds)
+	int32_t sun_distance_earth;     //  44 Sun.Distance.Earth (0.1 km)
+	int32_t sun_distance_observer;  //  48 Sun.Distance.Observer (0.1 km)
+	int32_t sun_ecliptic;           //  52 Sun.Ecliptic (0.001 degrees)
+	int32_t sun_declination;        //  56 Sun.Declination (0.001 degrees)
+	int32_t sun_azimuth;            //  60 Sun.Azimuth (0.01 degrees)
+	int32_t sun_height;             //  64 Sun.Height (0.1 degrees)
+	int32_t sun_diameter;           //  68 Sun.Diameter (0.01 arc minutes)
+	int32_t sun_rise_astronomical;  //  72 Sun.Rise.Astronomical (seconds)
+	int32_t sun_rise_nautical;      //  76 Sun.Rise.Nautical (seconds)
+	int32_t sun_rise_civil;         //  80 Sun.Rise.Civil (seconds)
+	int32_t sun_rise;               //  84 Sun.Rise.Sunrise (seconds)
+	int32_t sun_culmination;        //  88 Sun.Culmination (seconds)
+	int32_t sun_set;                //  92 Sun.Set.Sunset (seconds)
+	int32_t sun_set_civil;          //  96 Sun.Set.Civil (seconds)
+	int32_t sun_set_nautical;       // 100 Sun.Set.Nautical (seconds)
+	int32_t sun_set_astronomical;   // 104 Sun.Set.Astronomical (seconds)
+	int32_t sun_ascension;          // 108 Sun.Ascension (seconds)
+	int32_t moon_distance_earth;    // 112 Moon.Distance.Earth (0.1 km)
+	int32_t moon_distance_observer; // 116 Moon.Distance.Observer (0.1 km)
+	int32_t moon_ecliptic_latitude; // 120 Moon.Ecliptic.Latitude (0.001 degrees)
+	int32_t moon_ecliptic_longitude;// 124 Moon.Ecliptic.Longitude (0.001 degrees)
+	int32_t moon_declination;       // 128 Moon.Declination (0.001 degrees)
+	int32_t moon_azimuth;           // 132 Moon.Azimuth (0.01 degrees)
+	int32_t moon_height;            // 136 Moon.Height (0.1 degrees)
+	int32_t moon_diameter;          // 140 Moon.Diameter (0.01 arc minutes)
+	int32_t moon_rise;              // 144 Moon.Rise (seconds)
+	int32_t moon_culmination;       // 148 Moon.Culmination (seconds)
+	int32_t moon_set;               // 152 Moon.Set (seconds)
+	int32_t moon_ascension;         // 156 Moon.Ascension (seconds)
+	int32_t moon_phase_number;      // 160 Moon.Phase.Number (0.001)
+	int32_t moon_age;               // 164 Moon.Age (0.001 degrees)
+};
+
+// Little endian access independent of the host byte order and alignment
+inline void as_packed_put16(unsigned char *p, uint16_t v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+}
+
+inline void as_packed_put32(unsigned char *p, uint32_t v)
+{
+	as_packed_put16(p, (uint16_t)v);
+	as_packed_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+inline void as_packed_put64(unsigned char *p, double d)
+{
+	uint64_t v;
+	memcpy(&v, &d, sizeof(v));
+	as_packed_put32(p, (uint32_t)v);
+	as_packed_put32(p + 4, (uint32_t)(v >> 32));
+}
+
+inline uint16_t as_packed_get16(const unsigned char *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t as_packed_get32(const unsigned char *p)
+{
+	return as_packed_get16(p) | ((uint32_t)as_packed_get16(p + 2) << 16);
+}
+
+inline double as_packed_get64(const unsigned char *p)
+{
+	uint64_t v = as_packed_get32(p) | ((uint64_t)as_packed_get32(p + 4) << 32);
+	double d;
+	memcpy(&d, &v, sizeof(d));
+	return d;
+}
+
+#endif  // ASTRO_PACKED_H
@@ -0,0 +1,104 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "astro_pool.h"
+
+struct as_pool_job {
+	as_pool_func func;
+	void *arg;
+	unsigned wanted;            // workers still wanted, queued while > 0
+	unsigned active;            // workers running func
+};
+
+static std::mutex s_Mutex;
+static std::condition_variable s_Work;         // a job was queued or the pool stops
+static std::condition_variable s_Done;         // a worker returned from a job
+static std::deque<as_pool_job *> s_Jobs;
+static std::vector<std::thread> s_Threads;
+static bool s_Stop = false;
+
+static void as_pool_worker()
+{
+	std::unique_lock<std::mutex> lock(s_Mutex);
+	for (;;) {
+		s_Work.wait(lock, [] {return s_Stop || !s_Jobs.empty();});
+		if (s_Stop) return;
+		as_pool_job *job = s_Jobs.front();
+		if (--job->wanted == 0) s_Jobs.pop_front();
+		job->active++;
+		lock.unlock();
+		job->func(job->arg);
+		lock.lock();
+		if (--job->active == 0) s_Done.notify_all();
+	}
+}
+
+void as_pool_run(as_pool_func func, void *arg, unsigned helpers)
+{
+	as_pool_job job = {func, arg, 0, 0};
+	helpers = std::min(helpers, (unsigned)AS_POOL_THREADS);
+	if (helpers > 0) {
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		while (s_Threads.size() < helpers && !s_Stop) {
+			try {
+				s_Threads.emplace_back(as_pool_worker);
+			}
+			catch (const std::system_error &) {
+				break;  // no more threads available: run with the started ones
+			}
+		}
+		job.wanted = std::min(helpers, (unsigned)s_Threads.size());
+		if (job.wanted > 0) {
+			s_Jobs.push_back(&job);
+			for (unsigned i = 0; i < job.wanted; i++) s_Work.notify_one();
+		}
+	}
+	func(arg);
+	if (helpers > 0) {
+		// withdraw the workers not started yet and wait for the running ones
+		std::unique_lock<std::mutex> lock(s_Mutex);
+		if (job.wanted > 0) s_Jobs.erase(std::find(s_Jobs.begin(), s_Jobs.end(), &job));
+		s_Done.wait(lock, [&job] {return job.active == 0;});
+	}
+}
+
+unsigned as_pool_threads()
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	return s_Threads.size();
+}
+
+// Stop the workers when the library is unloaded
+static struct as_pool_autostop {
+	~as_pool_autostop() {
+		{
+			std::lock_guard<std::mutex> lock(s_Mutex);
+			s_Stop = true;
+		}
+		s_Work.notify_all();
+		for (std::thread &thread : s_Threads) thread.join();
+		s_Threads.clear();
+	}
+} s_PoolAutostop;
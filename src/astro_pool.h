@@ -0,0 +1,41 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_POOL_H
+#define ASTRO_POOL_H
+
+// Worker threads shared by all connections
+//
+// The workers are started on first use (at most AS_POOL_THREADS for the whole
+// process) and stay idle on a condition variable between calls; they are
+// stopped and joined when the library is unloaded. A caller always works on
+// its own job as well, so a job completes even if all workers are busy with
+// other connections.
+
+#define AS_POOL_THREADS             7       // max number of worker threads
+
+typedef void (*as_pool_func)(void *arg);
+
+// Runs func(arg) on the calling thread and on up to helpers idle workers,
+// returns once all of them have returned. func has to share the work itself
+// (e.g. by an atomic counter) and must not throw.
+void as_pool_run(as_pool_func func, void *arg, unsigned helpers);
+// Number of worker threads started so far
+unsigned as_pool_threads();
+
+#endif  // ASTRO_POOL_H
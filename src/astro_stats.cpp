@@ -0,0 +1,75 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "astro_stats.h"
+
+struct alignas(64) as_stats_shard {
+	std::atomic<uint64_t> value[AS_STAT_VALUES];
+};
+
+std::atomic<bool> as_stats_on(false);
+static as_stats_shard s_Shard[AS_STATS_SHARDS];
+static std::atomic<unsigned> s_NextShard(0);
+
+const char *const as_stats_counter_name[AS_COUNTER_COUNT] = {
+	"Calls",
+	"Errors",
+	"ArgumentErrors",
+};
+
+const char *const as_stats_phase_name[AS_PHASE_COUNT] = {
+	"SunPosition",
+	"MoonPosition",
+	"CalcSunRise",
+	"CalcMoonRise",
+	"JSON",
+};
+
+const char *const as_stats_cache_name[AS_CACHE_COUNT] = {
+	"RiseSetMemo",
+	"Grid",
+	"RiseSetCache",
+	"EpochMemo",
+};
+
+void as_stats_add(unsigned index, uint64_t value)
+{
+	// threads are assigned to the shards round robin
+	static thread_local unsigned shard = s_NextShard.fetch_add(1, std::memory_order_relaxed) % AS_STATS_SHARDS;
+	s_Shard[shard].value[index].fetch_add(value, std::memory_order_relaxed);
+}
+
+bool as_stats_enable(bool on)
+{
+	return as_stats_on.exchange(on);
+}
+
+void as_stats_reset()
+{
+	for (unsigned s = 0; s < AS_STATS_SHARDS; s++) {
+		for (unsigned i = 0; i < AS_STAT_VALUES; i++) s_Shard[s].value[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void as_stats_get(uint64_t *values)
+{
+	for (unsigned i = 0; i < AS_STAT_VALUES; i++) {
+		values[i] = 0;
+		for (unsigned s = 0; s < AS_STATS_SHARDS; s++) values[i] += s_Shard[s].value[i].load(std::memory_order_relaxed);
+	}
+}
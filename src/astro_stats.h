@@ -0,0 +1,110 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASTRO_STATS_H
+#define ASTRO_STATS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+// Call, phase timing and cache counters, returned by astro_stats()
+//
+// Counters are sharded per thread to avoid contention between connections.
+// Collection is off by default and switched by astro_stats_enable(); when off
+// every counting point costs one predictable branch.
+
+#define AS_STATS_SHARDS             16      // counter copies, threads are spread over them
+
+enum AS_STAT_COUNTER {
+	AS_COUNTER_CALLS,           // function calls (rows)
+	AS_COUNTER_ERRORS,          // calls returning an error
+	AS_COUNTER_ARG_ERRORS,      // invalid date arguments
+	AS_COUNTER_COUNT
+};
+
+// setInput() phases, counted with their time
+enum AS_STAT_PHASE {
+	AS_PHASE_SUN,               // SunPosition()
+	AS_PHASE_MOON,              // MoonPosition()
+	AS_PHASE_SUNRISE,           // CalcSunRise() or the rise/set grid
+	AS_PHASE_MOONRISE,          // CalcMoonRise()
+	AS_PHASE_JSON,              // JSON result
+	AS_PHASE_COUNT
+};
+
+// Caches, counted as hits and misses
+enum AS_STAT_CACHE {
+	AS_CACHE_MEMO,              // rise/set results of recent rows of a statement
+	AS_CACHE_GRID,              // rise/set grid (miss: exact calculation)
+	AS_CACHE_SHARED,            // rise/set results shared by all connections
+	AS_CACHE_EPOCH,             // geocentric sun/moon positions of recent instants of a statement
+	AS_CACHE_COUNT
+};
+
+// Index of the values of a shard
+#define AS_STAT_PHASE_COUNT(p)      (AS_COUNTER_COUNT + 2 * (p))
+#define AS_STAT_PHASE_NS(p)         (AS_COUNTER_COUNT + 2 * (p) + 1)
+#define AS_STAT_CACHE_HITS(c)       (AS_COUNTER_COUNT + 2 * AS_PHASE_COUNT + 2 * (c))
+#define AS_STAT_CACHE_MISSES(c)     (AS_COUNTER_COUNT + 2 * AS_PHASE_COUNT + 2 * (c) + 1)
+#define AS_STAT_VALUES              (AS_COUNTER_COUNT + 2 * AS_PHASE_COUNT + 2 * AS_CACHE_COUNT)
+
+extern std::atomic<bool> as_stats_on;
+extern const char *const as_stats_counter_name[AS_COUNTER_COUNT];
+extern const char *const as_stats_phase_name[AS_PHASE_COUNT];
+extern const char *const as_stats_cache_name[AS_CACHE_COUNT];
+
+void as_stats_add(unsigned index, uint64_t value);
+bool as_stats_enable(bool on);              // returns the previous state
+void as_stats_reset();
+void as_stats_get(uint64_t *values);        // sums of all shards, AS_STAT_VALUES values
+
+inline bool as_stats_enabled()
+{
+	return as_stats_on.load(std::memory_order_relaxed);
+}
+
+inline void as_stats_count(AS_STAT_COUNTER counter)
+{
+	if (as_stats_enabled()) as_stats_add(counter, 1);
+}
+
+inline void as_stats_cache(AS_STAT_CACHE cache, bool hit)
+{
+	if (as_stats_enabled()) as_stats_add(hit ? AS_STAT_CACHE_HITS(cache) : AS_STAT_CACHE_MISSES(cache), 1);
+}
+
+inline uint64_t as_stats_clock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Measures a phase from construction to stop(), nothing if collection is off
+struct as_stats_timer {
+	uint64_t start;
+
+	as_stats_timer() : start(as_stats_enabled() ? as_stats_clock() : 0) {}
+	inline void stop(AS_STAT_PHASE phase) {
+		if (start != 0) {
+			as_stats_add(AS_STAT_PHASE_COUNT(phase), 1);
+			as_stats_add(AS_STAT_PHASE_NS(phase), as_stats_clock() - start);
+		}
+	}
+};
+
+#endif  // ASTRO_STATS_H
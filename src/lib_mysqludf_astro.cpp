@@ -24,7 +24,24 @@
 #include <mysql.h>
 #include <math.h>
 #include <string>
+#include <new>
+#include <set>
+#include <tuple>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <array>
+#include <utility>
+#include <system_error>
 #include "lib_mysqludf_astro.h"
+#include "astro_ephem.h"
+#include "astro_grid.h"
+#include "astro_cache.h"
+#include "astro_stats.h"
+#include "astro_pool.h"
+#include "astro_math.h"
+#include "astro_packed.h"
 
 #ifdef DEBUG
 #include <syslog.h>
@@ -153,157 +170,1936 @@ char* astro_info(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long*
 }
 
 
+/**
+ * astro_stats
+ *
+ * Returns the counters of all connections as JSON string
+ * astro_stats()
+ *
+ * Counters are only collected while enabled by astro_stats_enable(1):
+ * calls, errors and invalid date arguments of all functions, count and time
+ * (ns) of the setInput() phases and hits/misses of the caches.
+ */
+bool astro_stats_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    if (args->arg_count != 0) {
+        parmerror("astro_stats()", args);
+        strcpy(message, "No arguments allowed (udf: astro_stats)");
+        return 1;
+    }
+    initid->ptr = (char *)malloc(MAX_RET_STRLEN+1);
+    if (initid->ptr == NULL) {
+        strcpy(message, "memory allocation error");
+        return 1;
+    }
+    initid->max_length = MAX_RET_STRLEN;
+
+    return 0;
+}
+
+void astro_stats_deinit(UDF_INIT *initid)
+{
+    if (initid->ptr != NULL) {
+        free(initid->ptr);
+    }
+}
+
+char* astro_stats(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error)
+{
+    char *res = (char *)initid->ptr;
+    uint64_t values[AS_STAT_VALUES];
+
+    *is_null = 0;
+    *error = 0;
+    as_stats_get(values);
+
+    as_buffer out(res, MAX_RET_STRLEN);
+    out.put("{\"Enabled\":");
+    out.put(as_stats_enabled() ? "true" : "false");
+    for (unsigned i=0; i<AS_COUNTER_COUNT; i++) {
+        out.put(",\"");
+        out.put(as_stats_counter_name[i]);
+        out.put("\":");
+        out.putInt(values[i]);
+    }
+    out.put(",\"Phases\":{");
+    for (unsigned p=0; p<AS_PHASE_COUNT; p++) {
+        if (p > 0) out.put(',');
+        out.put('"');
+        out.put(as_stats_phase_name[p]);
+        out.put("\":{\"Count\":");
+        out.putInt(values[AS_STAT_PHASE_COUNT(p)]);
+        out.put(",\"Nanoseconds\":");
+        out.putInt(values[AS_STAT_PHASE_NS(p)]);
+        out.put('}');
+    }
+    out.put("},\"Caches\":{");
+    for (unsigned c=0; c<AS_CACHE_COUNT; c++) {
+        if (c > 0) out.put(',');
+        out.put('"');
+        out.put(as_stats_cache_name[c]);
+        out.put("\":{\"Hits\":");
+        out.putInt(values[AS_STAT_CACHE_HITS(c)]);
+        out.put(",\"Misses\":");
+        out.putInt(values[AS_STAT_CACHE_MISSES(c)]);
+        uint64_t lookups = values[AS_STAT_CACHE_HITS(c)] + values[AS_STAT_CACHE_MISSES(c)];
+        out.put(",\"HitRatio\":");
+        out.putNumber(lookups ? (double)values[AS_STAT_CACHE_HITS(c)] / lookups : 0.0, 4);
+        out.put('}');
+    }
+    out.put("}}");
+    *out.pos = '\0';
+    *length = out.pos - res;
+    return res;
+}
+
+/**
+ * astro_stats_reset
+ *
+ * Sets all counters of astro_stats() to 0, returns 1
+ * astro_stats_reset()
+ */
+bool astro_stats_reset_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    if (args->arg_count != 0) {
+        parmerror("astro_stats_reset()", args);
+        strcpy(message, "No arguments allowed (udf: astro_stats_reset)");
+        return 1;
+    }
+    return 0;
+}
+
+void astro_stats_reset_deinit(UDF_INIT *initid)
+{
+}
+
+longlong astro_stats_reset(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error)
+{
+    *is_null = 0;
+    *error = 0;
+    as_stats_reset();
+    return 1;
+}
+
+/**
+ * astro_stats_enable
+ *
+ * Switches the collection of the astro_stats() counters on (1) or off (0),
+ * returns the previous state
+ * astro_stats_enable(on)
+ */
+bool astro_stats_enable_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    if (args->arg_count != 1 || args->arg_type[0] != INT_RESULT) {
+        parmerror("astro_stats_enable()", args);
+        strcpy(message, "function argument(s) error");
+        return 1;
+    }
+    return 0;
+}
+
+void astro_stats_enable_deinit(UDF_INIT *initid)
+{
+}
+
+longlong astro_stats_enable(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error)
+{
+    *is_null = 0;
+    *error = 0;
+    if (args->args[0] == NULL) {
+        *is_null = 1;
+        return 0;
+    }
+    return as_stats_enable(*((long long*) args->args[0]) != 0);
+}
+
+
+
+
+/* Library functions */
+
+// Decoders of the (date, latitude, longitude, timezone) arguments by their type,
+// selected once within xxx_init() (see astro_args_decoders())
+typedef bool (*astro_date_func)(const char *arg, unsigned long length, int timezone, as_date *d, as_time *t);
+typedef double (*astro_real_func)(const char *arg, unsigned long length);
+
+struct astro_arg_decoders {
+    astro_date_func date;           // string, epoch/YYYYMMDDhhmmss or Julian date
+    astro_real_func latitude;       // DECIMAL or REAL
+    astro_real_func longitude;
+    bool location;                  // latitude, longitude and timezone are constant, the engine is moved there once
+};
+
+/**
+ * astro
+ *
+ * Returns astro values as JSON string
+ * astro(date, latitude, longitude, timezone [, fields [, language [, precision [, math]]]])
+ *
+ * fields is an optional constant comma separated list of JSON paths
+ * (e.g. 'Sun.Rise,Sun.Set,Moon.Phase'), only these keys are returned and
+ * only the calculations required for them are done.
+ * language is an optional constant language code for names ('en', 'de', ...).
+ * precision is an optional constant precision of rise/set times ('fast',
+ * 'standard', 'precise', see AS_PRECISION).
+ * math is an optional constant trigonometry of the engine ('libm', 'fast',
+ * see AS_MATH).
+ * date is a 'YYYY-MM-DD hh:mm:ss' string, an INTEGER UNIX epoch (or the number
+ * YYYYMMDDhhmmss, e.g. NOW() + 0) or a REAL Julian date (UT), from 1901-03-01
+ * to 2100-02-28.
+ *
+ * If all arguments are constant the result is calculated once within
+ * astro_init() and returned for every row.
+ */
+struct astro_data {
+    bool constant;                  // all arguments are constant, res is precalculated
+    bool packed;                    // binary result of astro_packed() instead of JSON
+    bool error;                     // error state of the precalculated result
+    unsigned long length;           // length of the precalculated result
+    char res[MAX_RET_STRLEN+1];
+    astro_arg_decoders decoders;    // decoders of the argument types
+    Astronomy astro;                // engine of the statement: fields, language, grid, precision, math and a constant location are set once
+    Astronomy::riseset_memo memo;   // rise/set results of recent rows
+    Astronomy::epoch_memo epochs;   // geocentric positions of recent instants
+};
+
+// Local time as seconds since 1970-01-01 00:00:00
+long long astro_seconds(as_date d, as_time t)
+{
+    // days from civil date, years starting at March 1st
+    int y = d.year - (d.month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (d.month > 2 ? d.month - 3 : d.month + 9) + 2) / 5 + d.day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long long days = (long long)era * 146097 + doe - 719468;
+    return days * 86400 + t.hour * 3600 + t.minute * 60 + t.second;
+}
+
+// Inverse of astro_seconds()
+void astro_datetime(long long seconds, as_date *d, as_time *t)
+{
+    long long days = seconds / 86400;
+    long long sod = seconds % 86400;
+    if (sod < 0) {
+        sod += 86400;
+        days--;
+    }
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned doe = (unsigned)(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d->day = doy - (153 * mp + 2) / 5 + 1;
+    d->month = mp < 10 ? mp + 3 : mp - 9;
+    d->year = yoe + era * 400 + (d->month <= 2);
+    t->hour = sod / 3600;
+    t->minute = sod / 60 % 60;
+    t->second = sod % 60;
+}
+
+// Decode up to digits decimal digits at *p, false if there is no digit
+static bool astro_parse_number(const char **p, const char *end, int digits, int *value)
+{
+    const char *s = *p;
+    int v = 0;
+    while (s < end && s - *p < digits && *s >= '0' && *s <= '9') {
+        v = v * 10 + (*s++ - '0');
+    }
+    if (s == *p) return false;
+    *p = s;
+    *value = v;
+    return true;
+}
+
+// Decode one character c at *p
+static inline bool astro_parse_char(const char **p, const char *end, char c)
+{
+    if (*p == end || **p != c) return false;
+    (*p)++;
+    return true;
+}
+
+// Days of the month of the (proleptic Gregorian) year
+static int astro_days_in_month(int year, int month)
+{
+    static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return (month == 2 && leap) ? 29 : days[month - 1];
+}
+
+#define AS_DATE_MIN                 19010301            // first day of Astronomy::CalcJD()
+#define AS_DATE_MAX                 21000228            // last day of Astronomy::CalcJD()
+
+// Valid date and time of day within the range of Astronomy::CalcJD()
+static bool astro_valid_datetime(int year, int month, int day, int hour, int minute, int second)
+{
+    long date = year * 10000L + month * 100 + day;
+    return month >= 1 && month <= 12 && day >= 1 && day <= astro_days_in_month(year, month)
+           && hour <= 23 && minute <= 59 && second <= 59 && date >= AS_DATE_MIN && date <= AS_DATE_MAX;
+}
+
+// Parse 'YYYY-MM-DD hh:mm:ss' ('T' as separator is accepted, fractional seconds
+// '.f...' are ignored) within the length bytes of str, which is neither written
+// nor needs to be terminated. Returns false on invalid dates (e.g. February 30th)
+// and on anything else after the seconds.
+bool astro_parse_datetime(const char *str, unsigned long length, as_date *d, as_time *t)
+{
+    const char *p = str;
+    const char *end = str + length;
+    int year, month, day, hour, minute, second;
+
+    while (p < end && isspace(*p)) p++;
+    if (!astro_parse_number(&p, end, 4, &year) || !astro_parse_char(&p, end, '-')
+        || !astro_parse_number(&p, end, 2, &month) || !astro_parse_char(&p, end, '-')
+        || !astro_parse_number(&p, end, 2, &day)) {
+        return false;
+    }
+    if (!astro_parse_char(&p, end, 'T')) {
+        while (p < end && isspace(*p)) p++;
+    }
+    if (!astro_parse_number(&p, end, 2, &hour) || !astro_parse_char(&p, end, ':')
+        || !astro_parse_number(&p, end, 2, &minute) || !astro_parse_char(&p, end, ':')
+        || !astro_parse_number(&p, end, 2, &second)) {
+        return false;
+    }
+    if (astro_parse_char(&p, end, '.')) {
+        const char *fraction = p;
+        while (p < end && *p >= '0' && *p <= '9') p++;
+        if (p == fraction) return false;
+    }
+    if (p != end || !astro_valid_datetime(year, month, day, hour, minute, second)) {
+        return false;
+    }
+    d->day = day;
+    d->month = month;
+    d->year = year;
+    t->hour = hour;
+    t->minute = minute;
+    t->second = second;
+    return true;
+}
+
+// Parse a DECIMAL argument (e.g. '-33.865143') within the length bytes of str,
+// the same value as atof() without a terminated copy. 0 if invalid.
+double astro_parse_decimal(const char *str, unsigned long length)
+{
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    const char *p = str;
+    const char *end = str + length;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int decimals = 0;
+    bool negative = false;
+
+    while (p < end && isspace(*p)) p++;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++, decimals++) {
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+    }
+    if (digits > 15 || (p < end && (*p == 'e' || *p == 'E'))) {
+        // beyond exact double arithmetic: convert a terminated copy
+        char buf[64];
+        size_t n = length < sizeof(buf) - 1 ? length : sizeof(buf) - 1;
+        memcpy(buf, str, n);
+        buf[n] = '\0';
+        return atof(buf);
+    }
+    // mantissa and power of ten are exact, the quotient is rounded once like strtod()
+    double value = (double)mantissa / pow10[decimals];
+    return negative ? -value : value;
+}
+
+// Decode a DECIMAL or REAL argument, NULL is 0
+double astro_arg_real(UDF_ARGS *args, unsigned i)
+{
+    if ((args->arg_type[i] == STRING_RESULT || args->arg_type[i] == DECIMAL_RESULT) && args->args[i]!=NULL) {
+        // Interpret as a decimal value
+        return astro_parse_decimal(args->args[i], args->lengths[i]);
+    }
+    else if (args->arg_type[i] == REAL_RESULT && args->args[i]!=NULL) {
+        // double value
+        return *((double*) args->args[i]);
+    }
+    return 0.0;
+}
+
+#define AS_DATETIME_NUMBER_MIN      10000000000000LL    // YYYYMMDDhhmmss of year 1000, epoch of year 318857
+#define AS_SECONDS_MIN              -2172355200LL       // 1901-03-01 00:00:00, range of Astronomy::CalcJD()
+#define AS_SECONDS_MAX              4107542399LL        // 2100-02-28 23:59:59
+
+// Date as 'YYYY-MM-DD hh:mm:ss' string
+static bool astro_date_string(const char *arg, unsigned long length, int timezone, as_date *d, as_time *t)
+{
+    return astro_parse_datetime(arg, length, d, t);
+}
+
+// Date as UNIX epoch (UTC), or as 14 digit number YYYYMMDDhhmmss in local time
+// (e.g. NOW() + 0), which is far beyond the epochs of the supported years
+static bool astro_date_int(const char *arg, unsigned long length, int timezone, as_date *d, as_time *t)
+{
+    long long value = *((long long *)arg);
+    if (value >= AS_DATETIME_NUMBER_MIN) {
+        if (value > 99991231235959LL) return false;
+        int year = value / 10000000000LL;
+        int month = value / 100000000 % 100;
+        int day = value / 1000000 % 100;
+        int hour = value / 10000 % 100;
+        int minute = value / 100 % 100;
+        int second = value % 100;
+        if (!astro_valid_datetime(year, month, day, hour, minute, second)) {
+            return false;
+        }
+        d->year = year;
+        d->month = month;
+        d->day = day;
+        t->hour = hour;
+        t->minute = minute;
+        t->second = second;
+        return true;
+    }
+    long long local = value + timezone * 3600LL;
+    if (local < AS_SECONDS_MIN || local > AS_SECONDS_MAX) return false;
+    astro_datetime(local, d, t);
+    return true;
+}
+
+// Date as Julian date (UT), rounded to seconds
+static bool astro_date_real(const char *arg, unsigned long length, int timezone, as_date *d, as_time *t)
+{
+    double local = (*((double *)arg) - 2440587.5) * 86400.0 + timezone * 3600.0;
+    if (!(local >= AS_SECONDS_MIN && local <= AS_SECONDS_MAX)) return false;
+    astro_datetime(llround(local), d, t);
+    return true;
+}
+
+static double astro_real_decimal(const char *arg, unsigned long length)
+{
+    return astro_parse_decimal(arg, length);
+}
+
+static double astro_real_double(const char *arg, unsigned long length)
+{
+    return *((double *)arg);
+}
+
+// Check the (date, latitude, longitude, timezone) arguments
+bool astro_args_valid(UDF_ARGS *args)
+{
+    return args->arg_count >= 4 && (args->arg_type[0] == STRING_RESULT || args->arg_type[0] == INT_RESULT || args->arg_type[0] == REAL_RESULT)
+                                && (args->arg_type[1] == DECIMAL_RESULT || args->arg_type[1] == REAL_RESULT)
+                                && (args->arg_type[2] == DECIMAL_RESULT || args->arg_type[2] == REAL_RESULT)
+                                && args->arg_type[3] == INT_RESULT;
+}
+
+// Decoders of arguments checked by astro_args_valid(), the types are the same for all rows
+astro_arg_decoders astro_args_decoders(UDF_ARGS *args)
+{
+    astro_arg_decoders decoders;
+    switch (args->arg_type[0]) {
+        case INT_RESULT:    decoders.date = astro_date_int;    break;
+        case REAL_RESULT:   decoders.date = astro_date_real;   break;
+        default:            decoders.date = astro_date_string; break;
+    }
+    decoders.latitude = (args->arg_type[1] == REAL_RESULT) ? astro_real_double : astro_real_decimal;
+    decoders.longitude = (args->arg_type[2] == REAL_RESULT) ? astro_real_double : astro_real_decimal;
+    decoders.location = args->args[1] != NULL && args->args[2] != NULL && args->args[3] != NULL;
+    return decoders;
+}
+
+// Decode the (latitude, longitude, timezone) arguments, NULL values are 0
+as_geo astro_args_location(UDF_ARGS *args, const astro_arg_decoders &decoders)
+{
+    as_geo geo_location = {0.0, 0.0, 0};
+
+    if (args->arg_count >= 2 && args->args[1]!=NULL) {
+        geo_location.latitude = decoders.latitude(args->args[1], args->lengths[1]);
+    }
+    if (args->arg_count >= 3 && args->args[2]!=NULL) {
+        geo_location.longitude = decoders.longitude(args->args[2], args->lengths[2]);
+    }
+    if (args->arg_count >= 4 && args->args[3]!=NULL) {
+        geo_location.timezone = (int)*((long long*) args->args[3]);
+    }
+    return geo_location;
+}
+
+// Move the engine of a statement to a constant location once within xxx_init(),
+// the rows then skip Astronomy::setLocation()
+void astro_location_init(UDF_ARGS *args, const astro_arg_decoders &decoders, Astronomy &astro)
+{
+    if (decoders.location) {
+        astro.setLocation(astro_args_location(args, decoders));
+    }
+}
+
+// Decode astro() arguments, returns false on invalid date
+bool astro_args(UDF_ARGS *args, const astro_arg_decoders &decoders, as_date *astro_date, as_time *astro_time, as_geo *geo_location)
+{
+    bool valid = true;
+
+    *geo_location = astro_args_location(args, decoders);
+    if (args->arg_count >= 1 && args->args[0]!=NULL) {
+        if (!decoders.date(args->args[0], args->lengths[0], geo_location->timezone, astro_date, astro_time)) {
+            // handle error
+            as_stats_count(AS_COUNTER_ARG_ERRORS);
+            valid = false;
+        }
+    }
+
+#ifdef DEBUG
+    syslog (LOG_NOTICE, "astro(\"%04d-%02d-%02d %02d:%02d:%02d\", %f, %f, %d)",
+        astro_date->year,
+        astro_date->month,
+        astro_date->day,
+        astro_time->hour,
+        astro_time->minute,
+        astro_time->second,
+        geo_location->latitude, geo_location->longitude, geo_location->timezone);
+#endif
+
+    return valid;
+}
+
+// Calculate astro() result for the current arguments into data->res, the engine is only moved to the row location
+bool astro_calc(UDF_ARGS *args, astro_data *data, unsigned long *length)
+{
+    Astronomy &astro = data->astro;
+    char *res = data->res;
+    as_date astro_date = {1, 1, 1970};  // day, month, year
+    as_time astro_time = {0, 0, 00};   // hour, minute, seconds
+    as_geo geo_location = {0.0, 0.0, 0};
+
+    *res = '\0';
+    *length = 0;
+    if (!astro_args(args, data->decoders, &astro_date, &astro_time, &geo_location)) {
+        return false;
+    }
+
+    if (!data->decoders.location) astro.setLocation(geo_location);
+    astro.setInput(astro_date, astro_time, AS_CALC_JSON);
+    // JSON or packed values are written directly into the result buffer
+    if (data->packed ? !astro.GetPacked(res, MAX_RET_STRLEN, length) : !astro.GetJSON(res, MAX_RET_STRLEN, length)) {
+        *res = '\0';
+        *length = 0;
+        return false;
+    }
+#ifdef DEBUG
+    syslog (LOG_NOTICE, "astro() -> %s", res);
+#endif
+
+    return true;
+}
+
+// Returns true if all arguments are constant (already set within xxx_init())
+bool astro_args_const(UDF_ARGS *args)
+{
+    for (unsigned i=0; i<args->arg_count; i++) {
+        if (args->args[i] == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Allocate astro_data, calculates the result if all arguments are constant
+bool astro_data_init(UDF_INIT *initid, UDF_ARGS *args, char *message, as_fields fields, AS_LANG lang, bool grid, AS_PRECISION precision, AS_MATH math, bool packed)
+{
+    astro_data *data = new (std::nothrow) astro_data;
+    if (data == NULL) {
+        strcpy(message, "memory allocation error");
+        return 1;
+    }
+    initid->ptr = (char *)data;
+    initid->max_length = packed ? AS_PACKED_SIZE : MAX_RET_STRLEN;
+
+    // constant arguments are already set: calculate the result only once
+    data->constant = astro_args_const(args);
+    data->packed = packed;
+    data->decoders = astro_args_decoders(args);
+    data->error = false;
+    data->length = 0;
+    *data->res = '\0';
+    memset(&data->memo, 0, sizeof(data->memo));
+    memset(&data->epochs, 0, sizeof(data->epochs));
+    data->astro.setMemo(&data->memo);
+    data->astro.setEpochMemo(&data->epochs);
+    data->astro.setFields(fields);
+    data->astro.setLanguage(lang);
+    data->astro.setGrid(grid);
+    data->astro.setPrecision(precision);
+    data->astro.setMath(math);
+    astro_location_init(args, data->decoders, data->astro);
+    if (data->constant) {
+        data->error = !astro_calc(args, data, &data->length);
+        initid->const_item = 1;
+    }
+    return 0;
+}
+
+bool astro_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    initid->ptr = NULL;
+    initid->max_length = 0;
+    if (args->arg_count >= 4 && args->arg_count <= 8 && astro_args_valid(args)
+                              && (args->arg_count < 5 || args->arg_type[4] == STRING_RESULT)
+                              && (args->arg_count < 6 || args->arg_type[5] == STRING_RESULT)
+                              && (args->arg_count < 7 || args->arg_type[6] == STRING_RESULT)
+                              && (args->arg_count < 8 || args->arg_type[7] == STRING_RESULT)
+       ) {
+        as_fields fields = AS_FIELDS_ALL;
+        AS_LANG lang = AS_LANG_DEFAULT;
+        AS_PRECISION precision = AS_PRECISION_STANDARD;
+        AS_MATH math = AS_MATH_DEFAULT;
+        if (args->arg_count >= 5) {
+            // fields are parsed only once
+            if (args->args[4] == NULL) {
+                strcpy(message, "fields argument must be a constant string");
+                return 1;
+            }
+            if (!Astronomy::ParseFields(args->args[4], args->lengths[4], &fields)) {
+                strcpy(message, "fields argument contains an unknown JSON path");
+                return 1;
+            }
+            if (fields == 0) {
+                fields = AS_FIELDS_ALL;
+            }
+        }
+        if (args->arg_count >= 6) {
+            // language is parsed only once
+            if (args->args[5] == NULL) {
+                strcpy(message, "language argument must be a constant string");
+                return 1;
+            }
+            if (args->lengths[5] != 0 && !Astronomy::ParseLanguage(args->args[5], args->lengths[5], &lang)) {
+                strcpy(message, "language argument must be one of 'en', 'de', 'es', 'fr', 'it', 'nl'");
+                return 1;
+            }
+        }
+
+        if (args->arg_count >= 7) {
+            // precision is parsed only once
+            if (args->args[6] == NULL) {
+                strcpy(message, "precision argument must be a constant string");
+                return 1;
+            }
+            if (args->lengths[6] != 0 && !Astronomy::ParsePrecision(args->args[6], args->lengths[6], &precision)) {
+                strcpy(message, "precision argument must be one of 'fast', 'standard', 'precise'");
+                return 1;
+            }
+        }
+
+        if (args->arg_count >= 8) {
+            // math is parsed only once
+            if (args->args[7] == NULL) {
+                strcpy(message, "math argument must be a constant string");
+                return 1;
+            }
+            if (args->lengths[7] != 0 && !Astronomy::ParseMath(args->args[7], args->lengths[7], &math)) {
+                strcpy(message, "math argument must be one of 'libm', 'fast'");
+                return 1;
+            }
+        }
+
+        return astro_data_init(initid, args, message, fields, lang, false, precision, math, false);
+    }
+    parmerror("astro()", args);
+    strcpy(message, "function argument(s) error");
+    return 1;
+}
+
+void astro_deinit(UDF_INIT *initid)
+{
+    if (initid->ptr != NULL) {
+#ifdef DEBUG
+        astro_data *data = (astro_data *)initid->ptr;
+        setlogmask (LOG_UPTO (LOG_NOTICE));
+        openlog (LIBNAME, LOG_CONS | LOG_PID | LOG_NDELAY, LOG_LOCAL1);
+        syslog (LOG_NOTICE, "astro_deinit(): rise/set memo %lu hits, %lu misses", data->memo.hits, data->memo.misses);
+        closelog ();
+#endif
+        delete (astro_data *)initid->ptr;
+    }
+}
+
+char* astro(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error)
+{
+    *is_null = 0;
+    *error = 0;
+
+    astro_data *data = (astro_data *)initid->ptr;
+
+    if (NULL == data) {
+        *error = 1;
+        *is_null = 1;
+        return NULL;
+    }
+
+#ifdef DEBUG
+    setlogmask (LOG_UPTO (LOG_NOTICE));
+    openlog (LIBNAME, LOG_CONS | LOG_PID | LOG_NDELAY, LOG_LOCAL1);
+    syslog (LOG_NOTICE, "astro() call with %d args", args->arg_count);
+#endif
+
+    if (data->constant) {
+        // precalculated within astro_init()
+        *length = data->length;
+        *error = data->error;
+    }
+    else if (!astro_calc(args, data, length)) {
+        *error = 1;
+    }
+    as_stats_count(AS_COUNTER_CALLS);
+    if (*error) as_stats_count(AS_COUNTER_ERRORS);
+
+#ifdef DEBUG
+    syslog (LOG_NOTICE, "astro(): %s", data->res);
+    closelog ();
+#endif
+
+    return data->res;
+}
+
+/**
+ * astro_sun_times
+ *
+ * Returns the sun rise, culmination, set and twilight times as JSON
+ * astro_sun_times(date, latitude, longitude, timezone)
+ *
+ * The result equals astro() with the fields 'Sun.Rise,Sun.Culmination,Sun.Set'.
+ * If the rise/set grid file (see astro_grid.h) is loaded and covers the day
+ * and location, the times are interpolated from it instead of calculated,
+ * which is much faster for large site catalogs. Interpolated times differ by
+ * a few seconds (see 'make grid-check'); near polar day/night the exact
+ * calculation is used.
+ */
+bool astro_sun_times_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    initid->ptr = NULL;
+    initid->max_length = 0;
+    if (args->arg_count == 4 && astro_args_valid(args)) {
+        return astro_data_init(initid, args, message, AS_FIELDS_SUN_TIMES, AS_LANG_DEFAULT, true, AS_PRECISION_STANDARD, AS_MATH_DEFAULT, false);
+    }
+    parmerror("astro_sun_times()", args);
+    strcpy(message, "function argument(s) error");
+    return 1;
+}
+
+void astro_sun_times_deinit(UDF_INIT *initid)
+{
+    astro_deinit(initid);
+}
+
+char* astro_sun_times(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error)
+{
+    return astro(initid, args, result, length, is_null, error);
+}
+
+/**
+ * astro_packed
+ *
+ * Returns all astro() values as fixed layout binary string (see astro_packed.h)
+ * astro_packed(date, latitude, longitude, timezone)
+ *
+ * The result has AS_PACKED_SIZE bytes instead of about 1.3 KB of JSON, single
+ * values are read with astro_unpack() or at their offset.
+ */
+bool astro_packed_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    initid->ptr = NULL;
+    initid->max_length = 0;
+    if (args->arg_count == 4 && astro_args_valid(args)) {
+        return astro_data_init(initid, args, message, AS_FIELDS_ALL, AS_LANG_DEFAULT, false, AS_PRECISION_STANDARD, AS_MATH_DEFAULT, true);
+    }
+    parmerror("astro_packed()", args);
+    strcpy(message, "function argument(s) error");
+    return 1;
+}
+
+void astro_packed_deinit(UDF_INIT *initid)
+{
+    astro_deinit(initid);
+}
+
+char* astro_packed(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error)
+{
+    return astro(initid, args, result, length, is_null, error);
+}
+
+/**
+ * astro_unpack
+ *
+ * Returns a single value of an astro_packed() result as REAL
+ * astro_unpack(packed, path)
+ *
+ * path is a constant JSON path of astro() (e.g. 'Sun.Azimuth', 'Sun.Rise'),
+ * it is parsed once within astro_unpack_init(). See Astronomy::Unpack() for
+ * the values; NULL if there is no such event on the day.
+ */
+struct astro_unpack_data {
+    AS_FIELD field;                 // value to read
+};
+
+bool astro_unpack_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    initid->ptr = NULL;
+    if (args->arg_count != 2 || args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+        parmerror("astro_unpack()", args);
+        strcpy(message, "function argument(s) error");
+        return 1;
+    }
+    AS_FIELD field;
+    if (args->args[1] == NULL || !Astronomy::ParseField(args->args[1], args->lengths[1], &field)) {
+        strcpy(message, "path argument must be a constant JSON path of a single value");
+        return 1;
+    }
+    astro_unpack_data *data = (astro_unpack_data *)malloc(sizeof(astro_unpack_data));
+    if (data == NULL) {
+        strcpy(message, "memory allocation error");
+        return 1;
+    }
+    data->field = field;
+    initid->ptr = (char *)data;
+    initid->maybe_null = 1;
+    return 0;
+}
+
+void astro_unpack_deinit(UDF_INIT *initid)
+{
+    if (initid->ptr != NULL) {
+        free(initid->ptr);
+    }
+}
+
+double astro_unpack(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error)
+{
+    astro_unpack_data *data = (astro_unpack_data *)initid->ptr;
+    double value = NAN_DOUBLE;
+
+    *is_null = 0;
+    *error = 0;
+    if (NULL == data) {
+        *error = 1;
+        *is_null = 1;
+        return 0.0;
+    }
+    as_stats_count(AS_COUNTER_CALLS);
+    if (args->args[0] != NULL && !Astronomy::Unpack(args->args[0], args->lengths[0], data->field, &value)) {
+        as_stats_count(AS_COUNTER_ERRORS);
+        *error = 1;
+    }
+    if (*error || isnan(value)) {
+        *is_null = 1;
+        return 0.0;
+    }
+    return value;
+}
+
+/**
+ * astro_sun_events
+ *
+ * Returns the times the sun passes given altitudes as JSON array
+ * astro_sun_events(date, latitude, longitude, timezone, altitudes)
+ *
+ * altitudes is a constant comma separated list of up to AS_SUN_ALTITUDES_MAX
+ * altitudes of the sun center in degrees, e.g. '6,-4,-8' for golden and blue
+ * hour. It is parsed once within astro_sun_events_init(). All altitudes are
+ * calculated in one pass from the same sun positions
+ * (see Astronomy::CalcSunEvents()).
+ */
+struct astro_sun_events_data {
+    int count;                      // number of altitudes
+    double altitudes[AS_SUN_ALTITUDES_MAX];
+    char res[MAX_RET_STRLEN+1];
+    astro_arg_decoders decoders;    // decoders of the argument types
+    Astronomy astro;                // engine of the statement, moved to the location of every row unless it is constant
+};
+
+// Parse the comma separated altitudes (degrees), false on invalid or too many values
+bool astro_parse_altitudes(const char *str, unsigned long length, double *altitudes, int *count)
+{
+    char buf[MAX_RET_STRLEN+1];
+    if (length > MAX_RET_STRLEN) return false;
+    memcpy(buf, str, length);
+    buf[length] = '\0';
+
+    *count = 0;
+    char *pos = buf;
+    while (true) {
+        char *end;
+        double value = strtod(pos, &end);
+        if (end == pos || !isfinite(value) || value < -90.0 || value > 90.0 || *count >= AS_SUN_ALTITUDES_MAX) {
+            return false;
+        }
+        altitudes[(*count)++] = value;
+        while (*end == ' ') end++;
+        if (*end == '\0') return true;
+        if (*end != ',') return false;
+        pos = end + 1;
+    }
+}
+
+bool astro_sun_events_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    initid->ptr = NULL;
+    initid->max_length = 0;
+    if (args->arg_count != 5 || !astro_args_valid(args) || args->arg_type[4] != STRING_RESULT) {
+        parmerror("astro_sun_events()", args);
+        strcpy(message, "function argument(s) error");
+        return 1;
+    }
+    astro_sun_events_data *data = new (std::nothrow) astro_sun_events_data;
+    if (data == NULL) {
+        strcpy(message, "memory allocation error");
+        return 1;
+    }
+    // altitudes are parsed only once
+    if (args->args[4] == NULL || !astro_parse_altitudes(args->args[4], args->lengths[4], data->altitudes, &data->count)) {
+        delete data;
+        strcpy(message, "altitudes argument must be a constant list of up to 16 comma separated degrees");
+        return 1;
+    }
+    data->decoders = astro_args_decoders(args);
+    astro_location_init(args, data->decoders, data->astro);
+    initid->ptr = (char *)data;
+    initid->max_length = MAX_RET_STRLEN;
+    initid->maybe_null = 1;
+    return 0;
+}
+
+void astro_sun_events_deinit(UDF_INIT *initid)
+{
+    if (initid->ptr != NULL) {
+        delete (astro_sun_events_data *)initid->ptr;
+    }
+}
+
+char* astro_sun_events(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error)
+{
+    astro_sun_events_data *data = (astro_sun_events_data *)initid->ptr;
+    as_date astro_date = {1, 1, 1970};  // day, month, year
+    as_time astro_time = {0, 0, 00};   // hour, minute, seconds
+    as_geo geo_location = {0.0, 0.0, 0};
+
+    *is_null = 0;
+    *error = 0;
+    as_stats_count(AS_COUNTER_CALLS);
+    if (!astro_args(args, data->decoders, &astro_date, &astro_time, &geo_location)) {
+        as_stats_count(AS_COUNTER_ERRORS);
+        *error = 1;
+        *is_null = 1;
+        return NULL;
+    }
+
+    if (!data->decoders.location) data->astro.setLocation(geo_location);
+    if (!data->astro.GetSunEventsJSON(astro_date, data->altitudes, data->count, data->res, sizeof(data->res), length)) {
+        as_stats_count(AS_COUNTER_ERRORS);
+        *error = 1;
+        *is_null = 1;
+        return NULL;
+    }
+    return data->res;
+}
+
+/**
+ * astro_series
+ *
+ * Returns astro values for a range of times as JSON array
+ * astro_series(start, end, step, latitude, longitude, timezone [, fields [, language]])
+ *
+ * Samples are taken from start to end (local time, including end) every step
+ * seconds. fields and language are the same as for astro(), every sample
+ * contains the 'Time' key. Rise/set times are calculated once per day, long
+ * ranges are split into chunks of SERIES_CHUNK_SAMPLES samples, which are
+ * calculated in order by the calling thread and up to SERIES_THREADS - 1
+ * workers of the shared pool (see astro_pool.h).
+ *
+ * The result is limited to MAX_SERIES_STRLEN bytes. If not all samples fit,
+ * the array ends with the last complete sample; the next page starts at its
+ * 'Time' + step. All threads stop as soon as the complete chunks from the
+ * first one on fill MAX_SERIES_STRLEN.
+ */
+struct astro_series_data {
+    as_fields fields;               // JSON sample fields
+    AS_LANG lang;                   // language of names
+    char res[MAX_SERIES_STRLEN+1];
+};
+
+// Samples of one chunk
+struct astro_series_chunk {
+    bool done;                      // all samples calculated
+    bool error;                     // calculation failed
+    std::string out;                // JSON samples
+    std::vector<size_t> ends;       // end of every sample within out
+};
+
+// Chunks of one call, shared by the threads working on it
+struct astro_series_job {
+    as_geo geo;
+    as_fields fields;
+    AS_LANG lang;
+    long long start;                // epoch of the first sample (local time)
+    long long step;
+    long long samples;
+    std::vector<astro_series_chunk> chunks;
+    std::atomic<size_t> next;       // next chunk to calculate
+    std::atomic<bool> stop;         // the result is complete (or failed)
+    std::atomic<bool> failed;       // memory allocation error
+    std::mutex mutex;               // guards complete and bytes
+    size_t complete;                // number of done chunks from the first one on
+    size_t bytes;                   // JSON length of these chunks
+};
+
+// Mark a chunk as done, stop all threads once the complete chunks from the
+// first one on fill the result
+static void astro_series_done(astro_series_job *job, size_t c)
+{
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->chunks[c].done = true;
+    while (job->complete < job->chunks.size() && job->chunks[job->complete].done) {
+        const astro_series_chunk &chunk = job->chunks[job->complete++];
+        job->bytes += chunk.out.size() + chunk.ends.size();    // samples and separators
+    }
+    if (job->bytes > MAX_SERIES_STRLEN) {
+        job->stop.store(true, std::memory_order_relaxed);
+    }
+}
+
+// Calculate chunks in order until all are taken or the result is complete
+static void astro_series_calc(void *arg)
+{
+    astro_series_job *job = (astro_series_job *)arg;
+    Astronomy::riseset_memo memo;
+    char buf[MAX_RET_STRLEN+1];
+
+    memset(&memo, 0, sizeof(memo));
+    try {
+        Astronomy astro(job->geo);
+        astro.setMemo(&memo);
+        astro.setFields(job->fields);
+        astro.setLanguage(job->lang);
+        for (;;) {
+            size_t c = job->next.fetch_add(1, std::memory_order_relaxed);
+            if (c >= job->chunks.size() || job->stop.load(std::memory_order_relaxed)) return;
+            astro_series_chunk &chunk = job->chunks[c];
+            long long first = c * SERIES_CHUNK_SAMPLES;
+            long long count = std::min((long long)SERIES_CHUNK_SAMPLES, job->samples - first);
+            for (long long i = 0; i < count && !chunk.error; i++) {
+                if (job->stop.load(std::memory_order_relaxed)) return;
+                as_date astro_date;
+                as_time astro_time;
+                unsigned long length;
+                astro_datetime(job->start + (first + i) * job->step, &astro_date, &astro_time);
+                astro.setInput(astro_date, astro_time, AS_CALC_JSON);
+                if (!astro.GetJSON(buf, sizeof(buf), &length)) {
+                    chunk.error = true;
+                    break;
+                }
+                chunk.out.append(buf, length);
+                chunk.ends.push_back(chunk.out.size());
+            }
+            astro_series_done(job, c);
+        }
+    }
+    catch (const std::bad_alloc &) {
+        job->failed.store(true, std::memory_order_relaxed);
+        job->stop.store(true, std::memory_order_relaxed);
+    }
+}
 
+// Check the (start, end, step, latitude, longitude, timezone) arguments
+bool astro_series_args_valid(UDF_ARGS *args)
+{
+    return args->arg_count >= 6 && args->arg_type[0] == STRING_RESULT
+                                && args->arg_type[1] == STRING_RESULT
+                                && args->arg_type[2] == INT_RESULT
+                                && (args->arg_type[3] == DECIMAL_RESULT || args->arg_type[3] == REAL_RESULT)
+                                && (args->arg_type[4] == DECIMAL_RESULT || args->arg_type[4] == REAL_RESULT)
+                                && args->arg_type[5] == INT_RESULT;
+}
 
-/* Library functions */
+// Decode a 'YYYY-MM-DD hh:mm:ss' argument, returns false on invalid date
+bool astro_arg_datetime(UDF_ARGS *args, unsigned i, as_date *astro_date, as_time *astro_time)
+{
+    if (!astro_parse_datetime(args->args[i], args->lengths[i], astro_date, astro_time)) {
+        as_stats_count(AS_COUNTER_ARG_ERRORS);
+        return false;
+    }
+    return true;
+}
+
+bool astro_series_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+{
+    initid->ptr = NULL;
+    if (args->arg_count < 6 || args->arg_count > 8 || !astro_series_args_valid(args)
+                            || (args->arg_count >= 7 && args->arg_type[6] != STRING_RESULT)
+                            || (args->arg_count >= 8 && args->arg_type[7] != STRING_RESULT)
+       ) {
+        parmerror("astro_series()", args);
+        strcpy(message, "function argument(s) error");
+        return 1;
+    }
+    as_fields fields = AS_FIELDS_ALL;
+    AS_LANG lang = AS_LANG_DEFAULT;
+    if (args->arg_count >= 7) {
+        if (args->args[6] == NULL) {
+            strcpy(message, "fields argument must be a constant string");
+            return 1;
+        }
+        if (!Astronomy::ParseFields(args->args[6], args->lengths[6], &fields)) {
+            strcpy(message, "fields argument contains an unknown JSON path");
+            return 1;
+        }
+        if (fields == 0) {
+            fields = AS_FIELDS_ALL;
+        }
+    }
+    if (args->arg_count >= 8) {
+        if (args->args[7] == NULL) {
+            strcpy(message, "language argument must be a constant string");
+            return 1;
+        }
+        if (args->lengths[7] != 0 && !Astronomy::ParseLanguage(args->args[7], args->lengths[7], &lang)) {
+            strcpy(message, "language argument must be one of 'en', 'de', 'es', 'fr', 'it', 'nl'");
+            return 1;
+        }
+    }
+
+    astro_series_data *data = (astro_series_data *)malloc(sizeof(astro_series_data));
+    if (data == NULL) {
+        strcpy(message, "memory allocation error");
+        return 1;
+    }
+    initid->ptr = (char *)data;
+    initid->max_length = MAX_SERIES_STRLEN;
+    initid->maybe_null = 1;
+
+    // the sample time is needed to continue a truncated result
+    data->fields = fields | (((as_fields)1) << AS_FIELD_TIME);
+    data->lang = lang;
+    return 0;
+}
+
+void astro_series_deinit(UDF_INIT *initid)
+{
+    if (initid->ptr != NULL) {
+        free(initid->ptr);
+    }
+}
+
+char* astro_series(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error)
+{
+    astro_series_data *data = (astro_series_data *)initid->ptr;
+    as_date start_date, end_date;
+    as_time start_time, end_time;
+
+    *is_null = 0;
+    *error = 0;
+    as_stats_count(AS_COUNTER_CALLS);
+    for (unsigned i=0; i<6; i++) {
+        if (args->args[i] == NULL) {
+            *is_null = 1;
+            return NULL;
+        }
+    }
+    long long step = *((long long*)args->args[2]);
+    if (!astro_arg_datetime(args, 0, &start_date, &start_time) || !astro_arg_datetime(args, 1, &end_date, &end_time) || step <= 0) {
+        as_stats_count(AS_COUNTER_ERRORS);
+        *error = 1;
+        *is_null = 1;
+        return NULL;
+    }
+    as_geo geo_location;
+    geo_location.latitude = astro_arg_real(args, 3);
+    geo_location.longitude = astro_arg_real(args, 4);
+    geo_location.timezone = (int)*((long long*)args->args[5]);
+
+    long long start = astro_seconds(start_date, start_time);
+    long long end = astro_seconds(end_date, end_time);
+    long long samples = (end < start) ? 0 : (end - start) / step + 1;
+    // every sample takes at least 32 bytes ('{"Time":"YYYY-MM-DDThh:mm:ss"},'), more can not be returned
+    if (samples > MAX_SERIES_STRLEN / 32 + 1) {
+        samples = MAX_SERIES_STRLEN / 32 + 1;
+    }
+
+    // split the samples into chunks, one thread per chunk at most
+    long long chunks = (samples + SERIES_CHUNK_SAMPLES - 1) / SERIES_CHUNK_SAMPLES;
+    long long threads = std::thread::hardware_concurrency();
+    if (threads < 1 || threads > SERIES_THREADS) threads = SERIES_THREADS;
+    if (threads > chunks) threads = chunks;
+
+    as_buffer out(data->res, MAX_SERIES_STRLEN);
+    try {
+        astro_series_job job;
+        job.geo = geo_location;
+        job.fields = data->fields;
+        job.lang = data->lang;
+        job.start = start;
+        job.step = step;
+        job.samples = samples;
+        job.chunks.resize(chunks);
+        job.next = 0;
+        job.stop = false;
+        job.failed = false;
+        job.complete = 0;
+        job.bytes = 0;
+        for (astro_series_chunk &chunk : job.chunks) {
+            chunk.done = false;
+            chunk.error = false;
+        }
+        as_pool_run(astro_series_calc, &job, threads > 1 ? threads - 1 : 0);
+        if (job.failed) {
+            throw std::bad_alloc();
+        }
+
+        // join complete samples as long as the closing bracket fits, chunks after
+        // a stop are not done and beyond the result
+        out.put('[');
+        bool first = true;
+        for (size_t c = 0; c < job.chunks.size() && job.chunks[c].done && !out.overflow; c++) {
+            const astro_series_chunk &chunk = job.chunks[c];
+            if (chunk.error) {
+                as_stats_count(AS_COUNTER_ERRORS);
+                *error = 1;
+                *is_null = 1;
+                return NULL;
+            }
+            size_t begin = 0;
+            for (size_t end : chunk.ends) {
+                if ((unsigned long)(out.end - out.pos) < (end - begin) + 2) {
+                    out.overflow = true;
+                    break;
+                }
+                if (!first) out.put(',');
+                first = false;
+                memcpy(out.pos, chunk.out.data() + begin, end - begin);
+                out.pos += end - begin;
+                begin = end;
+            }
+        }
+        out.put(']');
+    }
+    catch (const std::bad_alloc &) {
+        as_stats_count(AS_COUNTER_ERRORS);
+        *error = 1;
+        *is_null = 1;
+        return NULL;
+    }
+    *out.pos = '\0';
+    *length = out.pos - data->res;
+    return data->res;
+}
 
 /**
- * astro
+ * astro_calendar
  *
- * Returns astro values as JSON string
- * astro(date, latitude, longitude, timezone)
+ * Returns sun and moon rise/set times and the moon phase of consecutive days as JSON array
+ * astro_calendar(start, days, latitude, longitude, timezone [, language])
  *
+ * One element per local day from the date of start: 'Time', the sun rise,
+ * set and twilight times, the moon rise, culmination and set times of the
+ * day and the moon phase and age at the time of day of start. The positions
+ * at the day boundaries and the UTC events of every day are calculated once
+ * for all days (see Astronomy::CalcRiseSetDays()). days is limited to
+ * MAX_CALENDAR_DAYS.
  */
-bool astro_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
+struct astro_calendar_data {
+    AS_LANG lang;                   // language of names
+    char res[MAX_SERIES_STRLEN+1];
+};
+
+bool astro_calendar_init(UDF_INIT *initid, UDF_ARGS *args, char *message)
 {
     initid->ptr = NULL;
-    initid->max_length = 0;
-    if (args->arg_count == 4 && args->arg_type[0] == STRING_RESULT && args->args[0] != NULL
-                              && (args->arg_type[1] == DECIMAL_RESULT || args->arg_type[1] == REAL_RESULT)
-                              && (args->arg_type[2] == DECIMAL_RESULT || args->arg_type[2] == REAL_RESULT)
-                              && args->arg_type[3] == INT_RESULT
+    if (args->arg_count < 5 || args->arg_count > 6
+                            || args->arg_type[0] != STRING_RESULT
+                            || args->arg_type[1] != INT_RESULT
+                            || (args->arg_type[2] != DECIMAL_RESULT && args->arg_type[2] != REAL_RESULT)
+                            || (args->arg_type[3] != DECIMAL_RESULT && args->arg_type[3] != REAL_RESULT)
+                            || args->arg_type[4] != INT_RESULT
+                            || (args->arg_count >= 6 && args->arg_type[5] != STRING_RESULT)
        ) {
-        initid->ptr = (char *)malloc(MAX_RET_STRLEN+1);
-        if (initid->ptr == NULL) {
-            strcpy(message, "memory allocation error");
+        parmerror("astro_calendar()", args);
+        strcpy(message, "function argument(s) error");
+        return 1;
+    }
+    AS_LANG lang = AS_LANG_DEFAULT;
+    if (args->arg_count >= 6) {
+        if (args->args[5] == NULL) {
+            strcpy(message, "language argument must be a constant string");
+            return 1;
+        }
+        if (args->lengths[5] != 0 && !Astronomy::ParseLanguage(args->args[5], args->lengths[5], &lang)) {
+            strcpy(message, "language argument must be one of 'en', 'de', 'es', 'fr', 'it', 'nl'");
             return 1;
         }
-        initid->max_length = MAX_RET_STRLEN;
-        return 0;
     }
-    parmerror("astro()", args);
-    strcpy(message, "function argument(s) error");
-    return 1;
+
+    astro_calendar_data *data = (astro_calendar_data *)malloc(sizeof(astro_calendar_data));
+    if (data == NULL) {
+        strcpy(message, "memory allocation error");
+        return 1;
+    }
+    initid->ptr = (char *)data;
+    initid->max_length = MAX_SERIES_STRLEN;
+    initid->maybe_null = 1;
+    data->lang = lang;
+    return 0;
 }
 
-void astro_deinit(UDF_INIT *initid)
+void astro_calendar_deinit(UDF_INIT *initid)
 {
     if (initid->ptr != NULL) {
         free(initid->ptr);
     }
 }
 
-char* astro(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error)
+char* astro_calendar(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error)
 {
+    astro_calendar_data *data = (astro_calendar_data *)initid->ptr;
+    as_date start_date;
+    as_time start_time;
+    char buf[MAX_RET_STRLEN+1];
+
     *is_null = 0;
     *error = 0;
+    as_stats_count(AS_COUNTER_CALLS);
+    for (unsigned i=0; i<5; i++) {
+        if (args->args[i] == NULL) {
+            *is_null = 1;
+            return NULL;
+        }
+    }
+    long long days = *((long long*)args->args[1]);
+    if (!astro_arg_datetime(args, 0, &start_date, &start_time) || days < 0 || days > MAX_CALENDAR_DAYS) {
+        as_stats_count(AS_COUNTER_ERRORS);
+        *error = 1;
+        *is_null = 1;
+        return NULL;
+    }
+    as_geo geo_location;
+    geo_location.latitude = astro_arg_real(args, 2);
+    geo_location.longitude = astro_arg_real(args, 3);
+    geo_location.timezone = (int)*((long long*)args->args[4]);
+
+    as_buffer out(data->res, MAX_SERIES_STRLEN);
+    try {
+        Astronomy::riseset_days riseset;
+        Astronomy astro(geo_location);
+        astro.setFields(AS_FIELDS_CALENDAR);
+        astro.setLanguage(data->lang);
+        astro.CalcRiseSetDays(start_date, (unsigned)days, AS_CALC_SUNRISE | AS_CALC_MOONRISE, &riseset);
+        astro.setDays(&riseset);
+
+        long long start = astro_seconds(start_date, start_time);
+        out.put('[');
+        for (long long i = 0; i < days; i++) {
+            as_date astro_date;
+            as_time astro_time;
+            unsigned long len;
+            astro_datetime(start + i * 86400, &astro_date, &astro_time);
+            astro.setInput(astro_date, astro_time, AS_CALC_JSON);
+            if (!astro.GetJSON(buf, sizeof(buf), &len) || (unsigned long)(out.end - out.pos) < len + 2) {
+                as_stats_count(AS_COUNTER_ERRORS);
+                *error = 1;
+                *is_null = 1;
+                return NULL;
+            }
+            if (i > 0) out.put(',');
+            memcpy(out.pos, buf, len);
+            out.pos += len;
+        }
+        out.put(']');
+    }
+    catch (const std::bad_alloc &) {
+        as_stats_count(AS_COUNTER_ERRORS);
+        *error = 1;
+        *is_null = 1;
+        return NULL;
+    }
+    *out.pos = '\0';
+    *length = out.pos - data->res;
+    return data->res;
+}
 
-    char *res = (char *)initid->ptr;
+/**
+ * astro_sun_altitude, astro_sun_rise_seconds, ...
+ *
+ * Returns a single astro value as REAL or INTEGER
+ * astro_xxx(date, latitude, longitude, timezone)
+ *
+ * Every function instantiates Astronomy::setInput() with only the stages
+ * needed for its value, no JSON is created. Times are returned as seconds of the local day, NULL if there is
+ * no such event on the given day.
+ */
+typedef void (*astro_input_func)(Astronomy &astro, as_date d, as_time t);
+typedef double (*astro_value_func)(Astronomy &astro);
+
+struct astro_value_data {
+    bool constant;                  // all arguments are constant, value is precalculated
+    bool error;                     // error state of the precalculated value
+    astro_input_func input;         // Astronomy::setInput() of the required stages
+    astro_value_func func;          // value getter, NAN for NULL
+    double value;                   // precalculated value
+    astro_arg_decoders decoders;    // decoders of the argument types
+    Astronomy astro;                // engine of the statement, moved to the location of every row unless it is constant
+    Astronomy::riseset_memo memo;   // rise/set results of recent rows
+    Astronomy::epoch_memo epochs;   // geocentric positions of recent instants
+};
+
+// Calculate the value for the current arguments, returns false on invalid arguments
+bool astro_value_calc(UDF_ARGS *args, astro_value_data *data, double *value)
+{
+    as_date astro_date = {1, 1, 1970};  // day, month, year
+    as_time astro_time = {0, 0, 00};   // hour, minute, seconds
+    as_geo geo_location = {0.0, 0.0, 0};
+
+    *value = NAN_DOUBLE;
+    if (!astro_args(args, data->decoders, &astro_date, &astro_time, &geo_location)) {
+        return false;
+    }
+
+    if (!data->decoders.location) data->astro.setLocation(geo_location);
+    data->input(data->astro, astro_date, astro_time);
+    *value = data->func(data->astro);
+
+    return true;
+}
+
+bool astro_value_init(UDF_INIT *initid, UDF_ARGS *args, char *message, const char *context, astro_input_func input, astro_value_func func)
+{
+    initid->ptr = NULL;
+    if (args->arg_count != 4 || !astro_args_valid(args)) {
+        parmerror(context, args);
+        strcpy(message, "function argument(s) error");
+        return 1;
+    }
+    astro_value_data *data = new (std::nothrow) astro_value_data;
+    if (data == NULL) {
+        strcpy(message, "memory allocation error");
+        return 1;
+    }
+    initid->ptr = (char *)data;
+    initid->maybe_null = 1;
+
+    data->input = input;
+    data->func = func;
+    data->value = NAN_DOUBLE;
+    data->error = false;
+    memset(&data->memo, 0, sizeof(data->memo));
+    memset(&data->epochs, 0, sizeof(data->epochs));
+    data->astro.setMemo(&data->memo);
+    data->astro.setEpochMemo(&data->epochs);
+    data->decoders = astro_args_decoders(args);
+    astro_location_init(args, data->decoders, data->astro);
+    // constant arguments are already set: calculate the value only once
+    data->constant = astro_args_const(args);
+    if (data->constant) {
+        data->error = !astro_value_calc(args, data, &data->value);
+        initid->const_item = 1;
+    }
+    return 0;
+}
+
+void astro_value_deinit(UDF_INIT *initid)
+{
+    if (initid->ptr != NULL) {
+        delete (astro_value_data *)initid->ptr;
+    }
+}
 
-    if (NULL == res) {
+double astro_value(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error)
+{
+    astro_value_data *data = (astro_value_data *)initid->ptr;
+    double value;
+
+    *is_null = 0;
+    *error = 0;
+    if (NULL == data) {
         *error = 1;
         *is_null = 1;
-        return res;
+        return 0.0;
     }
+    if (data->constant) {
+        value = data->value;
+        *error = data->error;
+    }
+    else if (!astro_value_calc(args, data, &value)) {
+        *error = 1;
+    }
+    as_stats_count(AS_COUNTER_CALLS);
+    if (*error) as_stats_count(AS_COUNTER_ERRORS);
+    if (*error || isnan(value)) {
+        *is_null = 1;
+        return 0.0;
+    }
+    return value;
+}
 
-#ifdef DEBUG
-    setlogmask (LOG_UPTO (LOG_NOTICE));
-    openlog (LIBNAME, LOG_CONS | LOG_PID | LOG_NDELAY, LOG_LOCAL1);
-#endif
+#define ASTRO_REAL_FUNCTION(name, calc, getter) \
+bool name##_init(UDF_INIT *initid, UDF_ARGS *args, char *message) \
+{ \
+    return astro_value_init(initid, args, message, #name "()", \
+        [](Astronomy &astro, as_date d, as_time t) {astro.setInput<calc>(d, t);}, \
+        [](Astronomy &astro) {return (double)(getter);}); \
+} \
+void name##_deinit(UDF_INIT *initid) \
+{ \
+    astro_value_deinit(initid); \
+} \
+double name(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) \
+{ \
+    return astro_value(initid, args, is_null, error); \
+}
+
+#define ASTRO_INT_FUNCTION(name, calc, getter) \
+bool name##_init(UDF_INIT *initid, UDF_ARGS *args, char *message) \
+{ \
+    return astro_value_init(initid, args, message, #name "()", \
+        [](Astronomy &astro, as_date d, as_time t) {astro.setInput<calc>(d, t);}, \
+        [](Astronomy &astro) {return (double)(getter);}); \
+} \
+void name##_deinit(UDF_INIT *initid) \
+{ \
+    astro_value_deinit(initid); \
+} \
+longlong name(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) \
+{ \
+    return llround(astro_value(initid, args, is_null, error)); \
+}
+
+ASTRO_REAL_FUNCTION(astro_sun_distance,         AS_CALC_SUN,        astro.GetSunDistance())
+ASTRO_REAL_FUNCTION(astro_sun_ecliptic,         AS_CALC_SUN,        astro.GetSunLon())
+ASTRO_REAL_FUNCTION(astro_sun_declination,      AS_CALC_SUN,        astro.GetSunDec())
+ASTRO_REAL_FUNCTION(astro_sun_azimuth,          AS_CALC_SUN,        astro.GetSunAz())
+ASTRO_REAL_FUNCTION(astro_sun_altitude,         AS_CALC_SUN,        astro.GetSunAlt())
+ASTRO_REAL_FUNCTION(astro_sun_diameter,         AS_CALC_SUN,        astro.GetSunDiameter())
+ASTRO_INT_FUNCTION(astro_sun_astronomical_dawn_seconds, AS_CALC_SUNRISE, astro.GetSunAstronomicalTwilightMorning() * 3600.0)
+ASTRO_INT_FUNCTION(astro_sun_nautical_dawn_seconds,     AS_CALC_SUNRISE, astro.GetSunNauticalTwilightMorning() * 3600.0)
+ASTRO_INT_FUNCTION(astro_sun_civil_dawn_seconds,        AS_CALC_SUNRISE, astro.GetSunCivilTwilightMorning() * 3600.0)
+ASTRO_INT_FUNCTION(astro_sun_rise_seconds,              AS_CALC_SUNRISE, astro.GetSunRise() * 3600.0)
+ASTRO_INT_FUNCTION(astro_sun_transit_seconds,           AS_CALC_SUNRISE, astro.GetSunTransit() * 3600.0)
+ASTRO_INT_FUNCTION(astro_sun_set_seconds,               AS_CALC_SUNRISE, astro.GetSunSet() * 3600.0)
+ASTRO_INT_FUNCTION(astro_sun_civil_dusk_seconds,        AS_CALC_SUNRISE, astro.GetSunCivilTwilightEvening() * 3600.0)
+ASTRO_INT_FUNCTION(astro_sun_nautical_dusk_seconds,     AS_CALC_SUNRISE, astro.GetSunNauticalTwilightEvening() * 3600.0)
+ASTRO_INT_FUNCTION(astro_sun_astronomical_dusk_seconds, AS_CALC_SUNRISE, astro.GetSunAstronomicalTwilightEvening() * 3600.0)
+ASTRO_REAL_FUNCTION(astro_moon_distance,        AS_CALC_MOON,       astro.GetMoonDistance())
+ASTRO_REAL_FUNCTION(astro_moon_declination,     AS_CALC_MOON,       astro.GetMoonDec())
+ASTRO_REAL_FUNCTION(astro_moon_azimuth,         AS_CALC_MOON,       astro.GetMoonAz())
+ASTRO_REAL_FUNCTION(astro_moon_altitude,        AS_CALC_MOON,       astro.GetMoonAlt())
+ASTRO_REAL_FUNCTION(astro_moon_diameter,        AS_CALC_MOON,       astro.GetMoonDiameter())
+ASTRO_REAL_FUNCTION(astro_moon_phase_number,    AS_CALC_MOON,       astro.GetMoonPhaseNumber())
+ASTRO_REAL_FUNCTION(astro_moon_age,             AS_CALC_MOON,       astro.GetMoonAge())
+ASTRO_INT_FUNCTION(astro_moon_phase,                    AS_CALC_MOON,     astro.GetMoonPhaseValue())
+ASTRO_INT_FUNCTION(astro_moon_rise_seconds,             AS_CALC_MOONRISE, astro.GetMoonRise() * 3600.0)
+ASTRO_INT_FUNCTION(astro_moon_transit_seconds,          AS_CALC_MOONRISE, astro.GetMoonTransit() * 3600.0)
+ASTRO_INT_FUNCTION(astro_moon_set_seconds,              AS_CALC_MOONRISE, astro.GetMoonSet() * 3600.0)
+
+
+
+
+/**
+ * astro_daylight_hours_sum, astro_moon_visible_hours_sum, astro_twilight_minutes_avg
+ *
+ * Aggregate functions over the days of a group
+ * astro_xxx(date, latitude, longitude, timezone)
+ *
+ * Every distinct day and location of a group is calculated and counted only
+ * once, the time of day of the date argument is ignored.
+ */
+typedef double (*astro_day_func)(Astronomy &astro);
+
+struct astro_day_key {
+    int year, month, day;
+    double latitude, longitude;
+    int timezone;
+    bool operator<(const astro_day_key &k) const {
+        return std::tie(year, month, day, latitude, longitude, timezone) < std::tie(k.year, k.month, k.day, k.latitude, k.longitude, k.timezone);
+    }
+};
+
+struct astro_aggregate_data {
+    astro_input_func input;         // Astronomy::setInput() of the required stages
+    astro_day_func func;            // day value, NAN if not available
+    bool average;                   // return average instead of sum
+    double sum;                     // sum of day values
+    unsigned long count;            // number of day values
+    bool failed;                    // memory allocation error within the group
+    std::set<astro_day_key> days;   // days already added
+    astro_arg_decoders decoders;    // decoders of the argument types
+    Astronomy astro;                // engine of the statement, moved to the location of every day unless it is constant
+    Astronomy::epoch_memo epochs;   // geocentric positions of recent instants (noon of the day in a zone)
+};
+
+// Duration in hours the body is above the horizon on the local day of rise and set (hours)
+double astro_visible_hours(double rise, double set, double alt)
+{
+    if (isnan(rise) && isnan(set)) return (alt > 0.0) ? 24.0 : 0.0; // no rise and set: always up or down
+    if (isnan(rise)) return set;                                  // up since midnight
+    if (isnan(set)) return 24.0 - rise;                           // up until midnight
+    if (set < rise) return set + 24.0 - rise;                     // set before rise
+    return set - rise;
+}
+
+bool astro_aggregate_init(UDF_INIT *initid, UDF_ARGS *args, char *message, const char *context, astro_input_func input, astro_day_func func, bool average)
+{
+    initid->ptr = NULL;
+    if (args->arg_count != 4 || !astro_args_valid(args)) {
+        parmerror(context, args);
+        strcpy(message, "function argument(s) error");
+        return 1;
+    }
+    astro_aggregate_data *data = new (std::nothrow) astro_aggregate_data;
+    if (data == NULL) {
+        strcpy(message, "memory allocation error");
+        return 1;
+    }
+    initid->ptr = (char *)data;
+    initid->maybe_null = 1;
+    initid->decimals = 2;
+
+    data->input = input;
+    data->func = func;
+    data->average = average;
+    data->sum = 0.0;
+    data->count = 0;
+    data->failed = false;
+    memset(&data->epochs, 0, sizeof(data->epochs));
+    data->astro.setEpochMemo(&data->epochs);
+    data->decoders = astro_args_decoders(args);
+    astro_location_init(args, data->decoders, data->astro);
+    return 0;
+}
+
+void astro_aggregate_deinit(UDF_INIT *initid)
+{
+    if (initid->ptr != NULL) {
+        delete (astro_aggregate_data *)initid->ptr;
+    }
+}
 
-    //Set the Date/Time
-    char *date = (char *)"";
+void astro_aggregate_clear(UDF_INIT *initid, char *is_null, char *error)
+{
+    astro_aggregate_data *data = (astro_aggregate_data *)initid->ptr;
+
+    data->sum = 0.0;
+    data->count = 0;
+    data->failed = false;
+    data->days.clear();
+}
+
+void astro_aggregate_add(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error)
+{
+    astro_aggregate_data *data = (astro_aggregate_data *)initid->ptr;
     as_date astro_date = {1, 1, 1970};  // day, month, year
     as_time astro_time = {0, 0, 00};   // hour, minute, seconds
-	double latitude = 0.0;
-	double longitude = 0.0;
-	int timezone = 0;
-
-#ifdef DEBUG
-    syslog (LOG_NOTICE, "astro() call with %d args", args->arg_count);
-#endif
+    as_geo geo_location = {0.0, 0.0, 0};
 
-    if (args->arg_count >= 1 && args->args[0]!=NULL) {
-        date = (char *)args->args[0];
-        date[args->lengths[0]]  = '\0';
-        int year, month, day;
-        int hour, minute, second;
-        if (std::sscanf(date, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6) {
-            // handle error
-            *error = 1;
-            *res = '\0';
-        }
-        astro_date.day = day;
-        astro_date.month = month;
-        astro_date.year = year;
-        astro_time.hour = hour;
-        astro_time.minute = minute;
-        astro_time.second = second;
-    }
-    if (args->arg_count >= 2) {
-        if ((args->arg_type[1] == STRING_RESULT || args->arg_type[1] == DECIMAL_RESULT) && args->args[1]!=NULL) {
-            // Interpret as a decimal value
-            latitude = atof((char *)args->args[1]);
-        }
-        else if (args->arg_type[1] == REAL_RESULT) {
-            // double value
-            latitude  = *((double*) args->args[1]);
+    as_stats_count(AS_COUNTER_CALLS);
+    for (unsigned i=0; i<args->arg_count; i++) {
+        if (args->args[i] == NULL) {
+            return; // ignore NULL values
         }
     }
-    if (args->arg_count >= 3) {
-        if ((args->arg_type[2] == STRING_RESULT || args->arg_type[2] == DECIMAL_RESULT) && args->args[2]!=NULL) {
-            // Interpret as a decimal value
-            longitude = atof((char *)args->args[2]);
-        }
-        else if (args->arg_type[2] == REAL_RESULT) {
-            // double value
-            longitude  = *((double*)args->args[2]);
+    if (!astro_args(args, data->decoders, &astro_date, &astro_time, &geo_location)) {
+        return; // ignore invalid dates
+    }
+
+    astro_day_key key = {astro_date.year, astro_date.month, astro_date.day, geo_location.latitude, geo_location.longitude, geo_location.timezone};
+    try {
+        if (!data->days.insert(key).second) {
+            return; // day already added
         }
     }
-    if (args->arg_count >= 4) {
-        timezone  = (int)*((long long*) args->args[3]);
+    catch (const std::bad_alloc &) {
+        // the group result is an error, see astro_aggregate()
+        as_stats_count(AS_COUNTER_ERRORS);
+        data->failed = true;
+        *error = 1;
+        return;
     }
 
-#ifdef DEBUG
-    syslog (LOG_NOTICE, "astro(\"%s\" = \"%04d-%02d-%02d %02d:%02d:%02d\", %f, %f, %d)",
-        date,
-        astro_date.year,
-        astro_date.month,
-        astro_date.day,
-        astro_time.hour,
-        astro_time.minute,
-        astro_time.second,
-        latitude, longitude, timezone);
-#endif
-
-    if (0 == *error) {
-        as_geo geo_location = { longitude, latitude, timezone};
-        Astronomy astro(geo_location);
-        astro.setInput(astro_date, astro_time);
-#ifdef DEBUG
-        syslog (LOG_NOTICE, "astro() -> %s", astro.GetAll().c_str());
-#endif
-        snprintf(res, MAX_RET_STRLEN, "%s", astro.GetAll().c_str());
-        *length = strlen(res);
+    // day values are calculated at local noon
+    astro_time.hour = 12;
+    astro_time.minute = 0;
+    astro_time.second = 0;
+    if (!data->decoders.location) data->astro.setLocation(geo_location);
+    data->input(data->astro, astro_date, astro_time);
+    double value = data->func(data->astro);
+    if (!isnan(value)) {
+        data->sum += value;
+        data->count++;
     }
+}
 
-#ifdef DEBUG
-    syslog (LOG_NOTICE, "astro(): %s", res);
-    closelog ();
-#endif
+double astro_aggregate(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error)
+{
+    astro_aggregate_data *data = (astro_aggregate_data *)initid->ptr;
 
-    return res;
+    *is_null = 0;
+    *error = 0;
+    if (data->failed) {
+        *error = 1;
+        *is_null = 1;
+        return 0.0;
+    }
+    if (data->count == 0) {
+        *is_null = 1;
+        return 0.0;
+    }
+    return data->average ? data->sum / data->count : data->sum;
 }
 
+#define ASTRO_AGGREGATE_FUNCTION(name, calc, average, func) \
+bool name##_init(UDF_INIT *initid, UDF_ARGS *args, char *message) \
+{ \
+    return astro_aggregate_init(initid, args, message, #name "()", \
+        [](Astronomy &astro, as_date d, as_time t) {astro.setInput<calc>(d, t);}, \
+        [](Astronomy &astro) {return (double)(func);}, average); \
+} \
+void name##_deinit(UDF_INIT *initid) \
+{ \
+    astro_aggregate_deinit(initid); \
+} \
+void name##_clear(UDF_INIT *initid, char *is_null, char *error) \
+{ \
+    astro_aggregate_clear(initid, is_null, error); \
+} \
+void name##_add(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) \
+{ \
+    astro_aggregate_add(initid, args, is_null, error); \
+} \
+double name(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error) \
+{ \
+    return astro_aggregate(initid, args, is_null, error); \
+}
 
+ASTRO_AGGREGATE_FUNCTION(astro_daylight_hours_sum, AS_CALC_SUN | AS_CALC_SUNRISE, false,
+    astro_visible_hours(astro.GetSunRise(), astro.GetSunSet(), astro.GetSunAlt()))
+ASTRO_AGGREGATE_FUNCTION(astro_moon_visible_hours_sum, AS_CALC_MOON | AS_CALC_MOONRISE, false,
+    astro_visible_hours(astro.GetMoonRise(), astro.GetMoonSet(), astro.GetMoonAlt()))
+ASTRO_AGGREGATE_FUNCTION(astro_twilight_minutes_avg, AS_CALC_SUNRISE, true,
+    60.0 * ((astro.GetSunRise() - astro.GetSunCivilTwilightMorning()) + (astro.GetSunCivilTwilightEvening() - astro.GetSunSet())))
+
+
+
+
+
+const char *const Astronomy::LanguageCode[AS_LANG_COUNT] = {"en", "de", "es", "fr", "it", "nl"};
+const char *const Astronomy::PrecisionName[AS_PRECISION_COUNT] = {"fast", "standard", "precise"};
+const char *const Astronomy::MathName[AS_MATH_COUNT] = {"libm", "fast"};
+
+const char *const Astronomy::ZodiacSign[AS_LANG_COUNT][12] = {
+	{	// AS_LANG_EN
+		"Aries",
+		"Taurus",
+		"Gemini",
+		"Cancer",
+		"Leo",
+		"Virgo",
+		"Libra",
+		"Scorpio",
+		"Sagittarius",
+		"Capricorn",
+		"Aquarius",
+		"Pisces"
+	},
+	{	// AS_LANG_DE
+		"Widder",
+		"Stier",
+		"Zwillinge",
+		"Krebs",
+		"Löwe",
+		"Jungfrau",
+		"Waage",
+		"Skorpion",
+		"Schütze",
+		"Steinbock",
+		"Wassermann",
+		"Fische"
+	},
+	{	// AS_LANG_ES
+		"Aries",
+		"Tauro",
+		"Géminis",
+		"Cáncer",
+		"Leo",
+		"Virgo",
+		"Libra",
+		"Escorpio",
+		"Sagitario",
+		"Capricornio",
+		"Acuario",
+		"Piscis"
+	},
+	{	// AS_LANG_FR
+		"Bélier",
+		"Taureau",
+		"Gémeaux",
+		"Cancer",
+		"Lion",
+		"Vierge",
+		"Balance",
+		"Scorpion",
+		"Sagittaire",
+		"Capricorne",
+		"Verseau",
+		"Poissons"
+	},
+	{	// AS_LANG_IT
+		"Ariete",
+		"Toro",
+		"Gemelli",
+		"Cancro",
+		"Leone",
+		"Vergine",
+		"Bilancia",
+		"Scorpione",
+		"Sagittario",
+		"Capricorno",
+		"Aquario",
+		"Pesci"
+	},
+	{	// AS_LANG_NL
+		"Ram",
+		"Stier",
+		"Tweelingen",
+		"Kreeft",
+		"Leeuw",
+		"Maagd",
+		"Weegschaal",
+		"Schorpioen",
+		"Boogschutter",
+		"Steenbok",
+		"Waterman",
+		"Vissen"
+	}
+};
+
+const char *const Astronomy::lunaphase[AS_LANG_COUNT][8] = {
+	{	// AS_LANG_EN
+		"New Moon",
+		"Waxing crescent",
+		"First quarter",
+		"Waxing gibbous",
+		"Full Moon",
+		"Waning gibbous",
+		"Third quarter",
+		"Waning crescent"
+	},
+	{	// AS_LANG_DE
+		"Neumond",
+		"Zunehmende Sichel",
+		"Erstes Viertel",
+		"Zunehmender Mond",
+		"Vollmond",
+		"Abnehmender Mond",
+		"Letztes Viertel",
+		"Abnehmende Sichel"
+	},
+	{	// AS_LANG_ES
+		"Luna nueva",
+		"Luna creciente",
+		"Cuarto creciente",
+		"Luna gibosa creciente",
+		"Luna llena",
+		"Luna gibosa menguante",
+		"Cuarto menguante",
+		"Luna menguante"
+	},
+	{	// AS_LANG_FR
+		"Nouvelle lune",
+		"Premier croissant ou lune croissante",
+		"Premier quartier",
+		"Lune gibbeuse croissante",
+		"Pleine lune",
+		"Lune gibbeuse décroissante",
+		"Dernier quartier",
+		"Dernier croissant ou lune décroissante"
+	},
+	{	// AS_LANG_IT
+		"Luna nuova",
+		"Luna crescente crescente",
+		"Primo quarto",
+		"Luna crescente",
+		"Luna piena",
+		"Luna calante",
+		"Ultimo quarto",
+		"Luna crescente calante"
+	},
+	{	// AS_LANG_NL
+		"Nieuwe maan",
+		"Wassende",
+		"Eerste kwartier",
+		"Wassende maan",
+		"Volle maan",
+		"Krimpende of afnemende maan",
+		"Laatste kwartier",
+		"Krimpende"
+	}
+};
+
+// Parse a language code ('en', 'de', 'es', 'fr', 'it', 'nl'), returns false on unknown codes
+bool Astronomy::ParseLanguage(const char *str, unsigned long length, AS_LANG *lang){
+	for (int l = 0; l < AS_LANG_COUNT; l++) {
+		unsigned long i = 0;
+		while (i < length && LanguageCode[l][i] == tolower(str[i])) i++;
+		if (i == length && LanguageCode[l][i] == '\0') {
+			*lang = (AS_LANG)l;
+			return true;
+		}
+	}
+	return false;
+}
 
+// Precision name ('fast', 'standard', 'precise', case insensitive), false if unknown
+bool Astronomy::ParsePrecision(const char *str, unsigned long length, AS_PRECISION *precision){
+	for (int p = 0; p < AS_PRECISION_COUNT; p++) {
+		unsigned long i = 0;
+		while (i < length && PrecisionName[p][i] == tolower(str[i])) i++;
+		if (i == length && PrecisionName[p][i] == '\0') {
+			*precision = (AS_PRECISION)p;
+			return true;
+		}
+	}
+	return false;
+}
 
+// Trigonometry name ('libm', 'fast', case insensitive), false if unknown
+bool Astronomy::ParseMath(const char *str, unsigned long length, AS_MATH *math){
+	for (int m = 0; m < AS_MATH_COUNT; m++) {
+		unsigned long i = 0;
+		while (i < length && MathName[m][i] == tolower(str[i])) i++;
+		if (i == length && MathName[m][i] == '\0') {
+			*math = (AS_MATH)m;
+			return true;
+		}
+	}
+	return false;
+}
 
 Astronomy::Astronomy(as_geo geoa, int8_t deltaT){
+	setLocation(geoa);
+	m_DeltaT  = deltaT; // time lag to Universal Time Coordinated [UTC] seconds
+}
+
+// Observer of the next setInput(), an instance is reused for all rows of a statement
+void Astronomy::setLocation(as_geo geoa){
 	m_Lat     = geoa.latitude;
 	m_Lon     = geoa.longitude;
 	m_Zone    = geoa.timezone;
-	m_DeltaT  = deltaT; // time lag to Universal Time Coordinated [UTC] seconds
+	m_Observer = Observer(m_Lon * DEG, m_Lat * DEG);
+}
+
+void Astronomy::setMath(AS_MATH math){
+	m_Math = math;
+	m_Observer = Observer(m_Observer.lon, m_Observer.lat); // trigonometry of the new math
 }
 
 Astronomy::~Astronomy(){
@@ -344,37 +2140,94 @@ double Astronomy::InterpolateGMST(double gmst0, double gmst1, double gmst2, doub
 	return ((timefactor * 24.07 * gmst1 - gmst0 * (gmst2 - gmst1)) / (timefactor * 24.07 + gmst1 - gmst2));
 }
 
-// Calculate observers cartesian equatorial coordinates (x,y,z in celestial frame)
-// from geodetic coordinates (longitude, latitude, height above WGS84 ellipsoid)
-// Currently only used to calculate distance of a body from the observer
-Astronomy::coor Astronomy::Observer2EquCart(double lon, double lat, double height, double gmst)
+inline double Astronomy::Sin(double x){
+	if (m_Math == AS_MATH_LIBM) return sin(x);
+	double s, c;
+	as_fast_sincos(x, &s, &c);
+	return s;
+}
+
+inline double Astronomy::Cos(double x){
+	if (m_Math == AS_MATH_LIBM) return cos(x);
+	double s, c;
+	as_fast_sincos(x, &s, &c);
+	return c;
+}
+
+inline double Astronomy::Tan(double x){
+	if (m_Math == AS_MATH_LIBM) return tan(x);
+	double s, c;
+	as_fast_sincos(x, &s, &c);
+	return s / c;
+}
+
+inline double Astronomy::Atan2(double y, double x){
+	return m_Math == AS_MATH_LIBM ? atan2(y, x) : as_fast_atan2(y, x);
+}
+
+inline double Astronomy::Asin(double x){
+	return m_Math == AS_MATH_LIBM ? asin(x) : as_fast_asin(x);
+}
+
+inline double Astronomy::Acos(double x){
+	return m_Math == AS_MATH_LIBM ? acos(x) : as_fast_acos(x);
+}
+
+// Observer at geographic position lon/lat (radians), the geocentric values are
+// only calculated by ObserverGeocentric() if needed
+Astronomy::observer Astronomy::Observer(double lon, double lat)
+{
+	observer obs;
+	obs.lon = lon;
+	obs.lat = lat;
+	obs.lonHours = RAD * lon / 15;
+	obs.sinLat = Sin(lat);
+	obs.cosLat = Cos(lat);
+	obs.geocentric = false;
+	obs.radius = obs.geoLat = obs.x = obs.y = obs.z = 0.0;
+	return obs;
+}
+
+// Geocentric latitude, distance and cartesian coordinates of the observer (height above
+// WGS84 ellipsoid 0) from its geodetic coordinates
+void Astronomy::ObserverGeocentric(observer *obs)
 {
 	double flat = 298.257223563;        // WGS84 flatening of earth
 	double aearth = 6378.137;           // GRS80/WGS84 semi major axis of earth ellipsoid
-	coor xyz;
+	double height = 0 * 0.001;          // altiude of observer in meters above WGS84 ellipsoid (and converted to kilometers)
 	// Calculate geocentric latitude from geodetic latitude
-	double co = cos(lat);
-	double si = sin(lat);
+	double co = obs->cosLat;
+	double si = obs->sinLat;
 	double fl = 1.0 - 1.0 / flat;
 	fl = fl * fl;
 	si = si * si;
 	double u = 1.0 / sqrt(co * co + fl * si);
 	double a = aearth * u + height;
 	double b = aearth * fl * u + height;
-	double radius = sqrt(a * a * co * co + b * b * si); // geocentric distance from earth center
-	xyz.y = acos(a * co / radius); // geocentric latitude, rad
-	xyz.x = lon; // longitude stays the same
-	if (lat < 0.0) { xyz.y = -xyz.y; } // adjust sign
-	xyz = EquPolar2Cart(xyz.x, xyz.y, radius); // convert from geocentric polar to geocentric cartesian, with regard to Greenwich
+	obs->radius = sqrt(a * a * co * co + b * b * si); // geocentric distance from earth center
+	obs->geoLat = Acos(a * co / obs->radius); // geocentric latitude, rad
+	if (obs->lat < 0.0) { obs->geoLat = -obs->geoLat; } // adjust sign
+	coor xyz = EquPolar2Cart(obs->lon, obs->geoLat, obs->radius); // convert from geocentric polar to geocentric cartesian, with regard to Greenwich
+	obs->x = xyz.x;
+	obs->y = xyz.y;
+	obs->z = xyz.z;
+	obs->geocentric = true;
+}
+
+// Calculate observers cartesian equatorial coordinates (x,y,z in celestial frame)
+// from its geocentric coordinates (see ObserverGeocentric())
+// Currently only used to calculate distance of a body from the observer
+Astronomy::coor Astronomy::Observer2EquCart(const observer &obs, double gmst)
+{
+	coor xyz;
 	// rotate around earth's polar axis to align coordinate system from Greenwich to vernal equinox
-	double x = xyz.x;
-	double y = xyz.y;
 	double rotangle = gmst / 24.0 * 2.0 * M_PI; // sideral time gmst given in hours. Convert to radians
-	xyz.x = x * cos(rotangle) - y * sin(rotangle);
-	xyz.y = x * sin(rotangle) + y * cos(rotangle);
-	xyz.r = radius;
-	xyz.lon = lon;
-	xyz.lat = lat;
+	xyz.x = obs.x * Cos(rotangle) - obs.y * Sin(rotangle);
+	xyz.y = obs.x * Sin(rotangle) + obs.y * Cos(rotangle);
+	xyz.z = obs.z;
+	xyz.r = obs.radius;
+	xyz.lon = obs.lon;
+	xyz.lat = obs.lat;
 	return xyz;
 }
 
@@ -385,45 +2238,68 @@ Astronomy::SIGN Astronomy::Sign(double lon){
 
 
 
-// Calculate cartesian from polar coordinates
-Astronomy::coor Astronomy::EquPolar2Cart(double lon, double lat, double distance){
-	coor xyz;
-	double rcd = cos(lat) * distance;
-	xyz.x = rcd * cos(lon);
-	xyz.y = rcd * sin(lon);
-	xyz.z = distance * sin(lat);
-	return xyz;
+// Calculate cartesian from polar coordinates
+Astronomy::coor Astronomy::EquPolar2Cart(double lon, double lat, double distance){
+	coor xyz;
+	double rcd = Cos(lat) * distance;
+	xyz.x = rcd * Cos(lon);
+	xyz.y = rcd * Sin(lon);
+	xyz.z = distance * Sin(lat);
+	return xyz;
+}
+
+// Ecliptic longitude (rad) and distance (AU) of the sun from the analytic model
+void Astronomy::SunOrbit(double TDT, double *lon, double *distance){
+	double D = TDT - 2447891.5;
+
+	double eg = 279.403303 * DEG;
+	double wg = 282.768422 * DEG;
+	double e = 0.016713;
+	double MSun = 360 * DEG / 365.242191 * D + eg - wg;
+	double nu = MSun + 360.0 * DEG / M_PI * e * Sin(MSun);
+
+	*lon = nu + wg;
+	*distance = (1 - e*e) / (1 + e * Cos(nu)); // distance in astronomical units
 }
 
 // Calculate coordinates for Sun
 // Coordinates are accurate to about 10s (right ascension)
 // and a few minutes of arc (declination)
-Astronomy::coor Astronomy::SunPosition(double TDT, double geolat, double lmst){
+Astronomy::coor Astronomy::SunPosition(double TDT, const observer *obs, double lmst){
 
 	double D = TDT - 2447891.5;
 
 	double eg = 279.403303 * DEG;
 	double wg = 282.768422 * DEG;
-	double e = 0.016713;
 	double a = 149598500; // km
 	double diameter0 = 0.533128 * DEG; // angular diameter of Moon at a distance
 	double MSun = 360 * DEG / 365.242191 * D + eg - wg;
-	double nu = MSun + 360.0 * DEG / M_PI * e * sin(MSun);
+	double eph[AS_EPHEM_SUN_VALUES];
+
+	// precalculated ephemeris if available, including the equatorial coordinates
+	bool ephemeris = as_ephem_eval(AS_EPHEM_SUN, TDT, eph);
+	if (!ephemeris) {
+		SunOrbit(TDT, &eph[AS_EPHEM_SUN_LON], &eph[AS_EPHEM_SUN_DIST]);
+	}
 
 	Astronomy::coor sunCoor;
-	sunCoor.lon = Mod2Pi(nu + wg);
+	sunCoor.lon = Mod2Pi(eph[AS_EPHEM_SUN_LON]);
 	sunCoor.lat= 0;
 	sunCoor.anomalyMean = MSun;
-	sunCoor.distance = (1 - e*e) / (1 + e * cos(nu)); // distance in astronomical units
+	sunCoor.distance = eph[AS_EPHEM_SUN_DIST]; // distance in astronomical units
 	sunCoor.diameter = diameter0 / sunCoor.distance; // angular diameter in radians
 	sunCoor.distance *=  a;         // distance in km
 	sunCoor.parallax = 6378.137 / sunCoor.distance;  // horizonal parallax
-	sunCoor = Ecl2Equ(sunCoor, TDT);
+	if (ephemeris) {
+		sunCoor.ra = Mod2Pi(eph[AS_EPHEM_SUN_RA]);
+		sunCoor.dec = eph[AS_EPHEM_SUN_DEC];
+	}
+	else sunCoor = Ecl2Equ(sunCoor, TDT);
 
 	// Calculate horizonal coordinates of sun, if geographic positions is given
-	if (!isnan(geolat) && !isnan(lmst))
+	if (obs != NULL && !isnan(lmst))
 	{
-		sunCoor = Equ2Altaz(sunCoor, TDT, geolat, lmst);
+		sunCoor = Equ2Altaz(sunCoor, TDT, *obs, lmst);
 	}
 	return sunCoor;
 }
@@ -432,11 +2308,11 @@ Astronomy::coor Astronomy::SunPosition(double TDT, double geolat, double lmst){
 Astronomy::coor Astronomy::Ecl2Equ(Astronomy::coor co, double TDT){
 	double T = (TDT - 2451545.0) / 36525.0; // Epoch 2000 January 1.5
 	double eps = (23.0 + (26 + 21.45 / 60.0) / 60.0 + T * (-46.815 + T * (-0.0006 + T * 0.00181)) / 3600.0) * DEG;
-	double coseps = cos(eps);
-	double sineps = sin(eps);
-	double sinlon = sin(co.lon);
-	co.ra = Mod2Pi(atan2((sinlon * coseps - tan(co.lat) * sineps), cos(co.lon)));
-	co.dec = asin(sin(co.lat) * coseps + cos(co.lat) * sineps * sinlon);
+	double coseps = Cos(eps);
+	double sineps = Sin(eps);
+	double sinlon = Sin(co.lon);
+	co.ra = Mod2Pi(Atan2((sinlon * coseps - Tan(co.lat) * sineps), Cos(co.lon)));
+	co.dec = Asin(Sin(co.lat) * coseps + Cos(co.lat) * sineps * sinlon);
 
 	return co;
 }
@@ -447,26 +2323,26 @@ Astronomy::coor Astronomy::Ecl2Equ(Astronomy::coor co, double TDT){
 
 // Transform equatorial coordinates (RA/Dec) to horizonal coordinates (azimuth/altitude)
 // Refraction is ignored
-Astronomy::coor Astronomy::Equ2Altaz(Astronomy:: coor co, double TDT, double geolat, double lmst){
-	double cosdec = cos(co.dec);
-	double sindec = sin(co.dec);
+Astronomy::coor Astronomy::Equ2Altaz(Astronomy:: coor co, double TDT, const observer &obs, double lmst){
+	double cosdec = Cos(co.dec);
+	double sindec = Sin(co.dec);
 	double lha = lmst - co.ra;
-	double coslha = cos(lha);
-	double sinlha = sin(lha);
-	double coslat = cos(geolat);
-	double sinlat = sin(geolat);
+	double coslha = Cos(lha);
+	double sinlha = Sin(lha);
+	double coslat = obs.cosLat;
+	double sinlat = obs.sinLat;
 
 	double N = -cosdec * sinlha;
 	double D = sindec * coslat - cosdec * coslha * sinlat;
-	co.az = Mod2Pi(atan2(N, D));
-	co.alt = asin(sindec * sinlat + cosdec * coslha * coslat);
+	co.az = Mod2Pi(Atan2(N, D));
+	co.alt = Asin(sindec * sinlat + cosdec * coslha * coslat);
 
 	return co;
 }
 
-// Calculate data and coordinates for the Moon
-// Coordinates are accurate to about 1/5 degree (in ecliptic coordinates)
-Astronomy::coor Astronomy::MoonPosition(Astronomy::coor sunCoor, double TDT, Astronomy::coor observer, double lmst){
+// Ecliptic coordinates (rad), true orbital longitude (rad) and distance
+// relative to the semi major axis of the Moon from the analytic model
+void Astronomy::MoonOrbit(Astronomy::coor sunCoor, double TDT, double *lon, double *lat, double *orbitLon, double *distance){
 	double D = TDT - 2447891.5;
 
 	// Mean Moon orbit elements as of 1990.0
@@ -475,53 +2351,76 @@ Astronomy::coor Astronomy::MoonPosition(Astronomy::coor sunCoor, double TDT, Ast
 	double N0 = 318.510107 * DEG;
 	double i = 5.145396 * DEG;
 	double e = 0.054900;
-	double a = 384401; // km
-	double diameter0 = 0.5181 * DEG; // angular diameter of Moon at a distance
-	double parallax0 = 0.9507 * DEG; // parallax at distance a
 
 	double l = 13.1763966 * DEG * D + l0;
 	double MMoon = l - 0.1114041 * DEG * D - P0; // Moon's mean anomaly M
 	double N = N0 - 0.0529539 * DEG * D;       // Moon's mean ascending node longitude
 	double C = l - sunCoor.lon;
-	double Ev = 1.2739 * DEG * sin(2 * C - MMoon);
-	double Ae = 0.1858 * DEG * sin(sunCoor.anomalyMean);
-	double A3 = 0.37 * DEG * sin(sunCoor.anomalyMean);
+	double Ev = 1.2739 * DEG * Sin(2 * C - MMoon);
+	double Ae = 0.1858 * DEG * Sin(sunCoor.anomalyMean);
+	double A3 = 0.37 * DEG * Sin(sunCoor.anomalyMean);
 	double MMoon2 = MMoon + Ev - Ae - A3;  // corrected Moon anomaly
-	double Ec = 6.2886 * DEG * sin(MMoon2);  // equation of centre
-	double A4 = 0.214 * DEG * sin(2 * MMoon2);
+	double Ec = 6.2886 * DEG * Sin(MMoon2);  // equation of centre
+	double A4 = 0.214 * DEG * Sin(2 * MMoon2);
 	double l2 = l + Ev + Ec - Ae + A4; // corrected Moon's longitude
-	double V = 0.6583 * DEG * sin(2 * (l2 - sunCoor.lon));
+	double V = 0.6583 * DEG * Sin(2 * (l2 - sunCoor.lon));
 	double l3 = l2 + V; // true orbital longitude;
 
-	double N2 = N - 0.16 * DEG * sin(sunCoor.anomalyMean);
+	double N2 = N - 0.16 * DEG * Sin(sunCoor.anomalyMean);
+
+	*lon = N2 + Atan2(Sin(l3 - N2) * Cos(i), Cos(l3 - N2));
+	*lat = Asin(Sin(l3 - N2) * Sin(i));
+	*orbitLon = l3;
+	// relative distance to semi mayor axis of lunar oribt
+	*distance = (1 - e*e) / (1 + e * Cos(MMoon2 + Ec));
+}
+
+// Calculate data and coordinates for the Moon
+// Coordinates are accurate to about 1/5 degree (in ecliptic coordinates)
+// The topocentric coordinates need the geocentric values of the observer (see ObserverGeocentric())
+Astronomy::coor Astronomy::MoonPosition(Astronomy::coor sunCoor, double TDT, const observer *obs, double lmst){
+	Astronomy::coor moonCoor = MoonGeocentric(sunCoor, TDT);
+
+	// Calculate horizonal coordinates of sun, if geographic positions is given
+	if (obs != NULL && !isnan(lmst))
+	{
+		moonCoor = MoonTopocentric(moonCoor, TDT, *obs, lmst);
+	}
+	return moonCoor;
+}
+
+// Geocentric part of MoonPosition(): coordinates, distance, age and phase, the same for all observers
+Astronomy::coor Astronomy::MoonGeocentric(Astronomy::coor sunCoor, double TDT){
+	double a = 384401; // km
+	double diameter0 = 0.5181 * DEG; // angular diameter of Moon at a distance
+	double parallax0 = 0.9507 * DEG; // parallax at distance a
+	double eph[AS_EPHEM_MOON_VALUES];
+
+	// precalculated ephemeris if available, including the equatorial coordinates
+	bool ephemeris = as_ephem_eval(AS_EPHEM_MOON, TDT, eph);
+	if (!ephemeris) {
+		MoonOrbit(sunCoor, TDT, &eph[AS_EPHEM_MOON_LON], &eph[AS_EPHEM_MOON_LAT], &eph[AS_EPHEM_MOON_ORBITLON], &eph[AS_EPHEM_MOON_DIST]);
+	}
+	double l3 = eph[AS_EPHEM_MOON_ORBITLON]; // true orbital longitude
 
 	Astronomy::coor moonCoor;
-	moonCoor.lon = Mod2Pi(N2 + atan2(sin(l3 - N2) * cos(i), cos(l3 - N2)));
-	moonCoor.lat = asin(sin(l3 - N2) * sin(i));
+	moonCoor.lon = Mod2Pi(eph[AS_EPHEM_MOON_LON]);
+	moonCoor.lat = eph[AS_EPHEM_MOON_LAT];
 	moonCoor.orbitLon = l3;
 
-	moonCoor = Ecl2Equ(moonCoor, TDT);
-	// relative distance to semi mayor axis of lunar oribt
-	moonCoor.distance = (1 - e*e) / (1 + e * cos(MMoon2 + Ec));
+	if (ephemeris) {
+		moonCoor.ra = Mod2Pi(eph[AS_EPHEM_MOON_RA]);
+		moonCoor.dec = eph[AS_EPHEM_MOON_DEC];
+	}
+	else moonCoor = Ecl2Equ(moonCoor, TDT);
+	moonCoor.distance = eph[AS_EPHEM_MOON_DIST];
 	moonCoor.diameter = diameter0 / moonCoor.distance; // angular diameter in radians
 	moonCoor.parallax = parallax0 / moonCoor.distance; // horizontal parallax in radians
 	moonCoor.distance = moonCoor.distance * a; // distance in km
 
-	// Calculate horizonal coordinates of sun, if geographic positions is given
-	if ((observer.lat+observer.r) > 0 && !isnan(lmst))
-	{
-		// transform geocentric coordinates into topocentric (==observer based) coordinates
-		moonCoor = GeoEqu2TopoEqu(moonCoor, observer, lmst);
-		moonCoor.raGeocentric = moonCoor.ra; // backup geocentric coordinates
-		moonCoor.decGeocentric = moonCoor.dec;
-		moonCoor.ra = moonCoor.raTopocentric;
-		moonCoor.dec = moonCoor.decTopocentric;
-		moonCoor = Equ2Altaz(moonCoor, TDT, observer.lat, lmst); // now ra and dec are topocentric
-	}
-
 	// Age of Moon in radians since New Moon (0) - Full Moon (pi)
 	moonCoor.moonAge = Mod2Pi(l3 - sunCoor.lon);
-	moonCoor.phase = 0.5 * (1 - cos(moonCoor.moonAge)); // Moon phase, 0-1
+	moonCoor.phase = 0.5 * (1 - Cos(moonCoor.moonAge)); // Moon phase, 0-1
 
 	double mainPhase = 1.0 / 29.53 * 360 * DEG; // show 'Newmoon, 'Quarter' for +/-1 day arond the actual event
 	double p = Mod(moonCoor.moonAge, 90.0 * DEG);
@@ -532,48 +2431,85 @@ Astronomy::coor Astronomy::MoonPosition(Astronomy::coor sunCoor, double TDT, Ast
 	return moonCoor;
 }
 
+// Observer part of MoonPosition(): topocentric and horizontal coordinates of the geocentric moonCoor
+Astronomy::coor Astronomy::MoonTopocentric(Astronomy::coor moonCoor, double TDT, const observer &obs, double lmst){
+	// transform geocentric coordinates into topocentric (==observer based) coordinates
+	moonCoor = GeoEqu2TopoEqu(moonCoor, obs, lmst);
+	moonCoor.raGeocentric = moonCoor.ra; // backup geocentric coordinates
+	moonCoor.decGeocentric = moonCoor.dec;
+	moonCoor.ra = moonCoor.raTopocentric;
+	moonCoor.dec = moonCoor.decTopocentric;
+	return Equ2Altaz(moonCoor, TDT, obs, lmst); // now ra and dec are topocentric
+}
+
+// Geocentric position of the sun (sunCoor NULL) or of the moon (sunCoor is the sun at TDT) at
+// TDT, shared with earlier calls at the same instant by the epoch memo
+Astronomy::coor Astronomy::EpochPosition(double TDT, const coor *sunCoor){
+	unsigned stage = (sunCoor == NULL) ? AS_CALC_SUN : AS_CALC_MOON;
+	if (m_EpochMemo == NULL) {
+		return (stage == AS_CALC_SUN) ? SunPosition(TDT) : MoonGeocentric(*sunCoor, TDT);
+	}
+
+	uint64_t bits;
+	memcpy(&bits, &TDT, sizeof(bits));
+	auto &entry = m_EpochMemo->entry[((bits * 0x9e3779b97f4a7c15ULL) >> 32) % EPOCH_MEMO_SIZE];
+	if (entry.TDT != TDT) {
+		entry.calc = 0;
+		entry.TDT = TDT;
+	}
+	bool hit = (entry.calc & stage) != 0;
+	if (!hit) {
+		if (stage == AS_CALC_SUN) entry.sun = SunPosition(TDT);
+		else entry.moon = MoonGeocentric(*sunCoor, TDT);
+		entry.calc |= stage;
+		m_EpochMemo->misses++;
+	}
+	else m_EpochMemo->hits++;
+	as_stats_cache(AS_CACHE_EPOCH, hit);
+	return (stage == AS_CALC_SUN) ? entry.sun : entry.moon;
+}
+
 // Transform geocentric equatorial coordinates (RA/Dec) to topocentric equatorial coordinates
-Astronomy::coor Astronomy::GeoEqu2TopoEqu(Astronomy::coor co, Astronomy::coor observer, double lmst){
-	double cosdec = cos(co.dec);
-	double sindec = sin(co.dec);
-	double coslst = cos(lmst);
-	double sinlst = sin(lmst);
-	double coslat = cos(observer.lat); // we should use geocentric latitude, not geodetic latitude
-	double sinlat = sin(observer.lat);
-	double rho = observer.r; // observer-geocenter in Kilometer
-
-	double x = co.distance * cosdec * cos(co.ra) - rho * coslat * coslst;
-	double y = co.distance * cosdec * sin(co.ra) - rho * coslat * sinlst;
+Astronomy::coor Astronomy::GeoEqu2TopoEqu(Astronomy::coor co, const observer &obs, double lmst){
+	double cosdec = Cos(co.dec);
+	double sindec = Sin(co.dec);
+	double coslst = Cos(lmst);
+	double sinlst = Sin(lmst);
+	double coslat = obs.cosLat; // we should use geocentric latitude, not geodetic latitude
+	double sinlat = obs.sinLat;
+	double rho = obs.radius; // observer-geocenter in Kilometer
+
+	double x = co.distance * cosdec * Cos(co.ra) - rho * coslat * coslst;
+	double y = co.distance * cosdec * Sin(co.ra) - rho * coslat * sinlst;
 	double z = co.distance * sindec - rho * sinlat;
 
 	co.distanceTopocentric = sqrt(x * x + y * y + z * z);
-	co.decTopocentric = asin(z / co.distanceTopocentric);
-	co.raTopocentric = Mod2Pi(atan2(y, x));
+	co.decTopocentric = Asin(z / co.distanceTopocentric);
+	co.raTopocentric = Mod2Pi(Atan2(y, x));
 
 	return co;
 }
+// Hours (0 <= tdiff <= 24) rounded to seconds
 Astronomy::timespan Astronomy::TimeSpan(double tdiff){
-	Astronomy::timespan ts;
-	char buf[10];std::string hms;
-	m_hh=0; m_mm=0; m_ss=0; m_dv=tdiff;
+	Astronomy::timespan ts = {TS_NONE};
 	if (tdiff == 0.0 || isnan(tdiff)) return ts;
 	double m = (tdiff - floor(tdiff)) * 60.0;
-	m_hh = Int(tdiff);
+	int hh = (int)floor(tdiff);
 	double s = (m - floor(m)) * 60.0;
-	m_mm = Int(m);
-	if (s >= 59.5) { m_mm++; s -= 60.0; }
-	if (m_mm >= 60) { m_hh++; m_mm -= 60; }
-	m_ss = (int)roundl(s);
-	ts.Hour=m_hh;
-	ts.Minute=m_mm;
-	ts.Second=m_ss;
-	sprintf(buf, "%02d:%02d:%02d", m_hh, m_mm, m_ss);
-	ts.HHMMSS= std::string(buf);
-	ts.TotalHour=((float)m_hh + ((float)m_mm + (float)m_ss / 60.0f) / 60.0f);
-	ts.TotalMinute=((float)(m_hh * 60 + m_mm) + (float)m_ss / 60.0f);
-	ts.TotalSecond=((float)((m_hh * 60 + m_mm) * 60 + m_ss));
+	int mm = (int)floor(m);
+	if (s >= 59.5) { mm++; s -= 60.0; }
+	ts.Seconds = (hh * 60 + mm) * 60 + (int)roundl(s);
 	return ts;
 }
+
+// Hours of a timespan as single precision value, NAN if there is no such time
+double Astronomy::Hours(const timespan &ts){
+	if (ts.Seconds == TS_NONE) return NAN_DOUBLE;
+	uint32_t hh = ts.Seconds / 3600;
+	uint32_t mm = ts.Seconds / 60 % 60;
+	uint32_t ss = ts.Seconds % 60;
+	return ((float)hh + ((float)mm + (float)ss / 60.0f) / 60.0f);
+}
 // Rough refraction formula using standard atmosphere: 1015 mbar and 10°C
 // Input true altitude in radians, Output: increase in altitude in degrees
 double Astronomy::Refraction(double alt){
@@ -582,7 +2518,7 @@ double Astronomy::Refraction(double alt){
 
 	double pressure = 1015;
 	double temperature = 10;
-	if (altdeg > 15) return (0.00452 * pressure / ((273 + temperature) * tan(alt)));
+	if (altdeg > 15) return (0.00452 * pressure / ((273 + temperature) * Tan(alt)));
 
 	double y = alt;
 	double D = 0.0;
@@ -594,7 +2530,7 @@ double Astronomy::Refraction(double alt){
 	for (int i = 0; i < 3; i++)
 	{
 		double N = y + (7.31 / (y + 4.4));
-		N = 1.0 / tan(N * DEG);
+		N = 1.0 / Tan(N * DEG);
 		D = N * P / (60.0 + Q * (N + 39.0));
 		N = y - y0;
 		y0 = D - D0 - N;
@@ -606,81 +2542,91 @@ double Astronomy::Refraction(double alt){
 	}
 	return D; // Hebung durch Refraktion in radians
 }
-// returns Greenwich sidereal time (hours) of time of rise
-// and set of object with coordinates coor.ra/coor.dec
-// at geographic position lon/lat (all values in radians)
-// Correction for refraction and semi-diameter/parallax of body is taken care of in function RiseSet
-// h is used to calculate the twilights. It gives the required elevation of the disk center of the sun
-Astronomy::coor Astronomy::GMSTRiseSet(Astronomy::coor co, double lon, double lat, double hn){
-	double h = isnan(hn) ? 0.0: hn; // set default value
-	Astronomy::coor riseset;
-	//  double tagbogen = std::acos(-std::tan(lat)*std::tan(coor["dec"])); // simple formula if twilight is not required
-	double tagbogen = acos((sin(h) - sin(lat) * sin(co.dec)) / (cos(lat) * cos(co.dec)));
-
-	riseset.transit = RAD / 15 * (+co.ra - lon);
-	riseset.rise = 24.0 + RAD / 15 * (-tagbogen + co.ra - lon); // calculate GMST of rise of object
-	riseset.set = RAD / 15 * (+tagbogen + co.ra - lon); // calculate GMST of set of object
-
-	// using the modulo function Mod, the day number goes missing. This may get a problem for the moon
-	riseset.transit = Mod(riseset.transit, 24);
-	riseset.rise = Mod(riseset.rise, 24);
-	riseset.set = Mod(riseset.set, 24);
-
-	return riseset;
-}
 // Find GMST of rise/set of object from the two calculates
 // (start)points (day 1 and 2) and at midnight UT(0)
 double InterpolateGMST(double gmst0, double gmst1, double gmst2, double timefactor){
 	return ((timefactor * 24.07 * gmst1 - gmst0 * (gmst2 - gmst1)) / (timefactor * 24.07 + gmst1 - gmst2));
 }
 // JD is the Julian Date of 0h UTC time (midnight)
-Astronomy::coor Astronomy::RiseSet(double jd0UT, Astronomy::coor  coor1, Astronomy::coor  coor2, double lon, double lat, double timeinterval, double naltitude)
+Astronomy::coor Astronomy::RiseSet(double jd0UT, Astronomy::coor  coor1, Astronomy::coor  coor2, const observer &obs, double timeinterval, double naltitude)
 {
-	// altitude of sun center: semi-diameter, horizontal parallax and (standard) refraction of 34'
-	double alt = 0.0; // calculate
-	double altitude = isnan(naltitude) ? 0.0 : naltitude; // set default value
-
-	// true height of sun center for sunrise and set calculation. Is kept 0 for twilight (ie. altitude given):
-	if (altitude == 0.0) alt = 0.5 * coor1.diameter - coor1.parallax + 34.0 / 60 * DEG;
-
-	Astronomy::coor rise1 = GMSTRiseSet(coor1, lon, lat, altitude);
-	Astronomy::coor rise2 = GMSTRiseSet(coor2, lon, lat, altitude);
-
 	Astronomy::coor rise;
+	RiseSetMulti(jd0UT, coor1, coor2, obs, timeinterval, &naltitude, 1, &rise);
+	return (rise);
+}
 
-	// unwrap GMST in case we move across 24h -> 0h
-	if (rise1.transit > rise2.transit && abs(rise1.transit - rise2.transit) > 18) rise2.transit += 24.0;
-	if (rise1.rise > rise2.rise && abs(rise1.rise - rise2.rise) > 18) rise2.rise += 24.0;
-	if (rise1.set > rise2.set && abs(rise1.set - rise2.set) > 18) rise2.set += 24.0;
+// Rise, transit and set (hours UTC) of the object with coordinates coor1/coor2 (day 1 and 2) at
+// the observer position at count altitudes of the disk center (radians, NAN or 0:
+// rise/set corrected for refraction and semi-diameter/parallax) in one pass: the sidereal times,
+// the transit and the refraction/parallax terms are shared by all altitudes
+void Astronomy::RiseSetMulti(double jd0UT, const coor &coor1, const coor &coor2, const observer &obs, double timeinterval, const double *naltitudes, int count, coor *rise)
+{
+	double lon = obs.lon;
 	double T0 = CalcGMST(jd0UT);
 	//  var T02 = T0-zone*1.002738; // Greenwich sidereal time at 0h time zone (zone: hours)
 
 	// Greenwich sidereal time for 0h at selected longitude
-	double T02 = T0 - lon * RAD / 15 * 1.002738;
+	double T02 = T0 - obs.lonHours * 1.002738;
 	if (T02 < 0) T02 += 24.0;
 
-	if (rise1.transit < T02) { rise1.transit += 24.0; rise2.transit += 24.0; }
-	if (rise1.rise < T02) { rise1.rise += 24.0; rise2.rise += 24.0; }
-	if (rise1.set < T02) { rise1.set += 24.0; rise2.set += 24.0; }
+	// GMST of transit of object on day 1 and 2,
+	// using the modulo function Mod, the day number goes missing. This may get a problem for the moon
+	double transit1 = Mod(RAD / 15 * (+coor1.ra - lon), 24);
+	double transit2 = Mod(RAD / 15 * (+coor2.ra - lon), 24);
+	// unwrap GMST in case we move across 24h -> 0h
+	if (transit1 > transit2 && abs(transit1 - transit2) > 18) transit2 += 24.0;
+	if (transit1 < T02) { transit1 += 24.0; transit2 += 24.0; }
+	double transit = GMST2UT(jd0UT, InterpolateGMST(T0, transit1, transit2, timeinterval));
+
+	// terms of the semi-diurnal arc independent of the altitude
+	double sin1 = obs.sinLat * Sin(coor1.dec);
+	double cos1 = obs.cosLat * Cos(coor1.dec);
+	double sin2 = obs.sinLat * Sin(coor2.dec);
+	double cos2 = obs.cosLat * Cos(coor2.dec);
 
 	// Refraction and Parallax correction
 	double decMean = 0.5 * (coor1.dec + coor2.dec);
-	double psi = acos(sin(lat) / cos(decMean));
-	double y = asin(sin(alt) / sin(psi));
-	double dt = 240 * RAD * y / cos(decMean) / 3600; // time correction due to refraction, parallax
-	rise.transit = GMST2UT(jd0UT, InterpolateGMST(T0, rise1.transit, rise2.transit, timeinterval));
-	rise.rise = GMST2UT(jd0UT, InterpolateGMST(T0, rise1.rise, rise2.rise, timeinterval) - dt);
-	rise.set = GMST2UT(jd0UT, InterpolateGMST(T0, rise1.set, rise2.set, timeinterval) + dt);
-
-	return (rise);
+	double psi = Acos(obs.sinLat / Cos(decMean));
+
+	for (int i = 0; i < count; i++) {
+		// altitude of sun center: semi-diameter, horizontal parallax and (standard) refraction of 34'
+		double alt = 0.0; // calculate
+		double altitude = isnan(naltitudes[i]) ? 0.0 : naltitudes[i]; // set default value
+
+		// true height of sun center for sunrise and set calculation. Is kept 0 for twilight (ie. altitude given):
+		if (altitude == 0.0) alt = 0.5 * coor1.diameter - coor1.parallax + 34.0 / 60 * DEG;
+
+		//  double tagbogen = std::acos(-std::tan(lat)*std::tan(coor["dec"])); // simple formula if twilight is not required
+		double sinh = Sin(altitude);
+		double tagbogen1 = Acos((sinh - sin1) / cos1);
+		double tagbogen2 = Acos((sinh - sin2) / cos2);
+
+		// GMST of rise/set of object on day 1 and 2
+		double rise1 = Mod(24.0 + RAD / 15 * (-tagbogen1 + coor1.ra - lon), 24);
+		double rise2 = Mod(24.0 + RAD / 15 * (-tagbogen2 + coor2.ra - lon), 24);
+		double set1 = Mod(RAD / 15 * (+tagbogen1 + coor1.ra - lon), 24);
+		double set2 = Mod(RAD / 15 * (+tagbogen2 + coor2.ra - lon), 24);
+
+		// unwrap GMST in case we move across 24h -> 0h
+		if (rise1 > rise2 && abs(rise1 - rise2) > 18) rise2 += 24.0;
+		if (set1 > set2 && abs(set1 - set2) > 18) set2 += 24.0;
+		if (rise1 < T02) { rise1 += 24.0; rise2 += 24.0; }
+		if (set1 < T02) { set1 += 24.0; set2 += 24.0; }
+
+		double y = Asin(Sin(alt) / Sin(psi));
+		double dt = 240 * RAD * y / Cos(decMean) / 3600; // time correction due to refraction, parallax
+		rise[i].transit = transit;
+		rise[i].rise = GMST2UT(jd0UT, InterpolateGMST(T0, rise1, rise2, timeinterval) - dt);
+		rise[i].set = GMST2UT(jd0UT, InterpolateGMST(T0, set1, set2, timeinterval) + dt);
+	}
 }
 // Find local time of moonrise and moonset
 // JD is the Julian Date of 0h local time (midnight)
-// Accurate to about 5 minutes or better
+// Accurate to about 5 minutes or better (AS_PRECISION_STANDARD, see AS_PRECISION for the others)
 // recursive: 1 - calculate rise/set in UTC
 // recursive: 0 - find rise/set on the current local day (set could also be first)
 // returns '' for moonrise/set does not occur on selected day
-Astronomy::coor Astronomy::CalcMoonRise(double JD, double deltaT, double lon, double lat, int zone, bool recursive){
+Astronomy::coor Astronomy::CalcMoonRise(double JD, double deltaT, const observer &obs, int zone, bool recursive){
 	double timeinterval = 0.5;
 	double jd0UT = floor(JD - 0.5) + 0.5;   // JD at 0 hours UT
 	Astronomy::coor suncoor1 = SunPosition(jd0UT + deltaT / 24.0 / 3600.0);
@@ -689,68 +2635,89 @@ Astronomy::coor Astronomy::CalcMoonRise(double JD, double deltaT, double lon, do
 	// calculations for next day's midnight
 	Astronomy::coor coor2 = MoonPosition(suncoor2, jd0UT + timeinterval + deltaT / 24.0 / 3600.0);
 
-	Astronomy::coor risetemp;
 	// rise/set time in UTC, time zone corrected later.
 	// Taking into account refraction, semi-diameter and parallax
-	Astronomy::coor rise = RiseSet(jd0UT, coor1, coor2, lon, lat, timeinterval);
+	Astronomy::coor rise = RiseSet(jd0UT, coor1, coor2, obs, timeinterval);
+	if (m_Precision == AS_PRECISION_PRECISE) RefineRiseSet(jd0UT, deltaT, obs, true, NAN_DOUBLE, &rise);
 
 	if (!recursive)
 	{ // check and adjust to have rise/set time on local calendar day
-		if (zone > 0)
-		{
-			// recursive call to MoonRise returns events in UTC
-			risetemp = CalcMoonRise(JD - 1.0, deltaT, lon, lat, zone, true);
-			if (rise.transit >= 24.0 - zone || rise.transit < -zone)
-			{ // transit time is tomorrow local time
-				if (risetemp.transit < 24.0 - zone) rise.transit = NAN_DOUBLE; // there is no moontransit today
-				else rise.transit = risetemp.transit;
-			}
+		int other = MoonRiseOtherDay(rise, zone);
+		Astronomy::coor risetemp = rise;
+		if (other != 0 && m_Precision == AS_PRECISION_FAST) {
+			// events of the other UTC day estimated by the mean daily delay of the moon
+			risetemp.rise = Mod(rise.rise + other * AS_MOON_RETARDATION, 24.0);
+			risetemp.transit = Mod(rise.transit + other * AS_MOON_RETARDATION, 24.0);
+			risetemp.set = Mod(rise.set + other * AS_MOON_RETARDATION, 24.0);
+		}
+		// recursive call to MoonRise returns events in UTC
+		else if (other != 0) risetemp = CalcMoonRise(JD + other, deltaT, obs, zone, true);
+		rise = MoonRiseLocal(rise, risetemp, zone);
+	}
+	return rise;
+}
 
-			if (rise.rise >= 24.0 - zone || rise.rise < -zone)
-			{ // rise time is tomorrow local time
-				if (risetemp.rise < 24.0 - zone) rise.rise = NAN_DOUBLE; // there is no moontransit today
-				else rise.rise = risetemp.rise;
-			}
+// UTC day before (-1) or after (+1) the one of the moon events rise (hours UTC) that
+// MoonRiseLocal() needs to find the events of the local day, 0 if none
+int Astronomy::MoonRiseOtherDay(const coor &rise, int zone){
+	if (zone > 0) return -1;
+	if (zone < 0 && (rise.rise < -zone || rise.set < -zone || rise.transit < -zone)) return 1;
+	return 0;
+}
 
-			if (rise.set >= 24.0 - zone || rise.set < -zone)
-			{ // set time is tomorrow local time
-				if (risetemp.set < 24.0 - zone) rise.set = NAN_DOUBLE; // there is no moontransit today
-				else rise.set = risetemp.set;
-			}
+// Moon events of the local day from the ones of its UTC day (rise) and of the
+// other UTC day (risetemp, see MoonRiseOtherDay()), hours local time
+Astronomy::coor Astronomy::MoonRiseLocal(coor rise, const coor &risetemp, int zone){
+	if (zone > 0)
+	{
+		if (rise.transit >= 24.0 - zone || rise.transit < -zone)
+		{ // transit time is tomorrow local time
+			if (risetemp.transit < 24.0 - zone) rise.transit = NAN_DOUBLE; // there is no moontransit today
+			else rise.transit = risetemp.transit;
+		}
 
+		if (rise.rise >= 24.0 - zone || rise.rise < -zone)
+		{ // rise time is tomorrow local time
+			if (risetemp.rise < 24.0 - zone) rise.rise = NAN_DOUBLE; // there is no moontransit today
+			else rise.rise = risetemp.rise;
 		}
-		else if (zone < 0)
-		{
-			// rise/set time was tomorrow local time -> calculate rise time for former UTC day
-			if (rise.rise < -zone || rise.set < -zone || rise.transit < -zone)
-			{
-				risetemp = CalcMoonRise(JD + 1.0, deltaT, lon, lat, zone, true);
 
-				if (rise.rise < -zone)
-				{
-					if (risetemp.rise > -zone) rise.rise = NAN_DOUBLE; // there is no moonrise today
-					else rise.rise = risetemp.rise;
-				}
+		if (rise.set >= 24.0 - zone || rise.set < -zone)
+		{ // set time is tomorrow local time
+			if (risetemp.set < 24.0 - zone) rise.set = NAN_DOUBLE; // there is no moontransit today
+			else rise.set = risetemp.set;
+		}
 
-				if (rise.transit < -zone)
-				{
-					if (risetemp.transit > -zone) rise.transit = NAN_DOUBLE; // there is no moonset today
-					else rise.transit = risetemp.transit;
-				}
+	}
+	else if (zone < 0)
+	{
+		// rise/set time was tomorrow local time -> calculate rise time for former UTC day
+		if (rise.rise < -zone || rise.set < -zone || rise.transit < -zone)
+		{
+			if (rise.rise < -zone)
+			{
+				if (risetemp.rise > -zone) rise.rise = NAN_DOUBLE; // there is no moonrise today
+				else rise.rise = risetemp.rise;
+			}
 
-				if (rise.set < -zone)
-				{
-					if (risetemp.set > -zone) rise.set = NAN_DOUBLE; // there is no moonset today
-					else rise.set = risetemp.set;
-				}
+			if (rise.transit < -zone)
+			{
+				if (risetemp.transit > -zone) rise.transit = NAN_DOUBLE; // there is no moonset today
+				else rise.transit = risetemp.transit;
+			}
 
+			if (rise.set < -zone)
+			{
+				if (risetemp.set > -zone) rise.set = NAN_DOUBLE; // there is no moonset today
+				else rise.set = risetemp.set;
 			}
-		}
 
-		if (rise.rise != NAN_DOUBLE) rise.rise = Mod(rise.rise + zone, 24.0);    // correct for time zone, if time is valid
-		if (rise.transit != NAN_DOUBLE) rise.transit = Mod(rise.transit + zone, 24.0); // correct for time zone, if time is valid
-		if (rise.set != NAN_DOUBLE) rise.set = Mod(rise.set + zone, 24.0);    // correct for time zone, if time is valid
+		}
 	}
+
+	if (rise.rise != NAN_DOUBLE) rise.rise = Mod(rise.rise + zone, 24.0);    // correct for time zone, if time is valid
+	if (rise.transit != NAN_DOUBLE) rise.transit = Mod(rise.transit + zone, 24.0); // correct for time zone, if time is valid
+	if (rise.set != NAN_DOUBLE) rise.set = Mod(rise.set + zone, 24.0);    // correct for time zone, if time is valid
 	return rise;
 }
 
@@ -758,208 +2725,909 @@ Astronomy::coor Astronomy::CalcMoonRise(double JD, double deltaT, double lon, do
 
 // Find (local) time of sunrise and sunset, and twilights
 // JD is the Julian Date of 0h local time (midnight)
-// Accurate to about 1-2 minutes
+// Accurate to about 1-2 minutes (AS_PRECISION_STANDARD, see AS_PRECISION for the others)
 // recursive: 1 - calculate rise/set in UTC in a second run
 // recursive: 0 - find rise/set on the current local day. This is set when doing the first call to this function
-Astronomy::coor Astronomy::CalcSunRise(double JD, double deltaT, double lon, double lat, int zone, bool recursive){
+Astronomy::coor Astronomy::CalcSunRise(double JD, double deltaT, const observer &obs, int zone, bool recursive){
 	double jd0UT = floor(JD - 0.5) + 0.5;   // JD at 0 hours UT
+	Astronomy::coor events[AS_SUN_EVENTS];
+
+	if (m_Precision == AS_PRECISION_FAST) {
+		// one position at noon UT for the whole day, the events of the other UTC day
+		// are estimated by the ones of this day (they differ by less than 1-2 minutes)
+		Astronomy::coor coor = SunPosition(jd0UT + 0.5 + deltaT / 24.0 / 3600.0);
+		SunEventsUTC(jd0UT, coor, coor, obs, events);
+		return recursive ? events[0] : SunRiseLocal(events, events[0], zone);
+	}
+
 	Astronomy::coor coor1 = SunPosition(jd0UT + deltaT / 24.0 / 3600.0);
 	Astronomy::coor coor2 = SunPosition(jd0UT + 1.0 + deltaT / 24.0 / 3600.0); // calculations for next day's UTC midnight
 
-	Astronomy::coor risetemp;
 	// rise/set time in UTC.
-	Astronomy::coor rise = RiseSet(jd0UT, coor1, coor2, lon, lat, 1);
-	if (!recursive)
-	{ // check and adjust to have rise/set time on local calendar day
-		if (zone > 0)
-		{
-			// rise time was yesterday local time -> calculate rise time for next UTC day
-			if (rise.rise >= 24 - zone || rise.transit >= 24 - zone || rise.set >= 24 - zone)
-			{
-				risetemp = CalcSunRise(JD + 1, deltaT, lon, lat, zone, true);
-				if (rise.rise >= 24 - zone) rise.rise = risetemp.rise;
-				if (rise.transit >= 24 - zone) rise.transit = risetemp.transit;
-				if (rise.set >= 24 - zone) rise.set = risetemp.set;
-			}
+	if (recursive) {
+		Astronomy::coor rise = RiseSet(jd0UT, coor1, coor2, obs, 1);
+		if (m_Precision == AS_PRECISION_PRECISE) RefineRiseSet(jd0UT, deltaT, obs, false, NAN_DOUBLE, &rise);
+		return rise;
+	}
+
+	// check and adjust to have rise/set time on local calendar day
+	SunEventsUTC(jd0UT, coor1, coor2, obs, events);
+	if (m_Precision == AS_PRECISION_PRECISE) {
+		const double altitudes[AS_SUN_EVENTS] = {NAN_DOUBLE, -6.0 * DEG, -12.0 * DEG, -18.0 * DEG};
+		for (int i = 0; i < AS_SUN_EVENTS; i++) RefineRiseSet(jd0UT, deltaT, obs, false, altitudes[i], &events[i]);
+	}
+	int other = SunRiseOtherDay(events[0], zone);
+	Astronomy::coor risetemp = events[0];
+	if (other != 0) risetemp = CalcSunRise(JD + other, deltaT, obs, zone, true);
+	return SunRiseLocal(events, risetemp, zone);
+}
+
+// Time (hours UTC of the day jd0UT) of the event (-1 rise, 0 transit, +1 set) of the sun
+// or moon next to the estimate t. The position at t and the hour angle at which the body
+// passes the altitude (radians, NAN or 0: rise/set corrected for refraction and
+// semi-diameter/parallax like RiseSet()) are iterated until the time step is below
+// AS_PRECISE_SECONDS. The iteration stays within AS_PRECISE_MAX_SHIFT of the estimate
+// (about twice the largest error of the standard tier), if it does not converge there
+// the estimate is kept. NaN if the altitude is not reached.
+double Astronomy::RefineEvent(double jd0UT, double deltaT, const observer &obs, bool moon, int event, double naltitude, double t){
+	double altitude = isnan(naltitude) ? 0.0 : naltitude;
+	// hours of sidereal time per hour: the moon moves eastwards about 13 degrees a day
+	double rate = moon ? 0.9661 : 1.002738;
+	double estimate = t;
+	for (int i = 0; i < AS_PRECISE_ITERATIONS && !isnan(t); i++) {
+		double jd = jd0UT + t / 24.0;
+		double TDT = jd + deltaT / 24.0 / 3600.0;
+		Astronomy::coor co = SunPosition(TDT);
+		if (moon) co = MoonPosition(co, TDT);
+
+		double h = altitude;
+		if (altitude == 0.0) h = -(0.5 * co.diameter - co.parallax + 34.0 / 60 * DEG);
+		double target = 0.0;
+		if (event != 0) target = event * Acos((Sin(h) - obs.sinLat * Sin(co.dec)) / (obs.cosLat * Cos(co.dec)));
+		double hourAngle = GMST2LMST(CalcGMST(jd), obs) * 15.0 * DEG - co.ra;
+		double dt = remainder(target - hourAngle, 2.0 * M_PI) * RAD / 15.0 / rate;
+		t += dt;
+		// a step to another crossing of the altitude (or of the meridian)
+		if (fabs(t - estimate) > AS_PRECISE_MAX_SHIFT) return estimate;
+		if (fabs(dt) * 3600.0 < AS_PRECISE_SECONDS) return t;
+	}
+	// not converged or the altitude is not reached near the estimate (grazing)
+	return isnan(t) ? t : estimate;
+}
+
+// Refine the rise, transit and set time (hours UTC of the day jd0UT) of RiseSet(), see RefineEvent()
+void Astronomy::RefineRiseSet(double jd0UT, double deltaT, const observer &obs, bool moon, double naltitude, coor *rise){
+	if (!isnan(rise->rise)) rise->rise = RefineEvent(jd0UT, deltaT, obs, moon, -1, naltitude, rise->rise);
+	if (!isnan(rise->transit)) rise->transit = RefineEvent(jd0UT, deltaT, obs, moon, 0, naltitude, rise->transit);
+	if (!isnan(rise->set)) rise->set = RefineEvent(jd0UT, deltaT, obs, moon, 1, naltitude, rise->set);
+}
+
+// Sun rise/set and the civil, nautical and astronomical twilights (events[AS_SUN_EVENTS],
+// hours UTC) of the UTC day jd0UT from the sun positions coor1/coor2 at its start and end
+void Astronomy::SunEventsUTC(double jd0UT, const coor &coor1, const coor &coor2, const observer &obs, coor *events){
+	const double altitudes[AS_SUN_EVENTS] = {NAN_DOUBLE, -6.0 * DEG, -12.0 * DEG, -18.0 * DEG};
+	RiseSetMulti(jd0UT, coor1, coor2, obs, 1, altitudes, AS_SUN_EVENTS, events);
+}
+
+// UTC day before (-1) or after (+1) the one of the sun events rise (hours UTC) that
+// SunRiseLocal() needs to find the events of the local day, 0 if none
+int Astronomy::SunRiseOtherDay(const coor &rise, int zone){
+	// rise time was yesterday local time -> calculate rise time for next UTC day
+	if (zone > 0 && (rise.rise >= 24 - zone || rise.transit >= 24 - zone || rise.set >= 24 - zone)) return 1;
+	if (zone < 0 && (rise.rise < -zone || rise.transit < -zone || rise.set < -zone)) return -1;
+	return 0;
+}
+
+// Sun events and twilights of the local day from the ones of its UTC day (events, see
+// SunEventsUTC()) and of the other UTC day (risetemp, see SunRiseOtherDay()), hours local time
+Astronomy::coor Astronomy::SunRiseLocal(const coor *events, const coor &risetemp, int zone){
+	Astronomy::coor rise = events[0];
+	if (zone > 0)
+	{
+		if (rise.rise >= 24 - zone) rise.rise = risetemp.rise;
+		if (rise.transit >= 24 - zone) rise.transit = risetemp.transit;
+		if (rise.set >= 24 - zone) rise.set = risetemp.set;
+	}
+	else if (zone < 0)
+	{
+		if (rise.rise < -zone) rise.rise = risetemp.rise;
+		if (rise.transit < -zone) rise.transit = risetemp.transit;
+		if (rise.set < -zone) rise.set = risetemp.set;
+	}
+
+	rise.transit = Mod(rise.transit + zone, 24.0);
+	rise.rise = Mod(rise.rise + zone, 24.0);
+	rise.set = Mod(rise.set + zone, 24.0);
+
+	// Twilight calculation
+	rise.cicilTwilightMorning = Mod(events[1].rise + zone, 24.0);
+	rise.cicilTwilightEvening = Mod(events[1].set + zone, 24.0);
+	rise.nauticalTwilightMorning = Mod(events[2].rise + zone, 24.0);
+	rise.nauticalTwilightEvening = Mod(events[2].set + zone, 24.0);
+	rise.astronomicalTwilightMorning = Mod(events[3].rise + zone, 24.0);
+	rise.astronomicalTwilightEvening = Mod(events[3].set + zone, 24.0);
+	return rise;
+}
+
+// Rise, transit, set and twilight events (AS_GRID_EVENT) of the UTC day jd0UT in hours UTC,
+// not adjusted to a local day (values of the rise/set grid)
+void Astronomy::CalcSunRiseUTC(double jd0UT, double deltaT, const observer &obs, double *events){
+	Astronomy::coor coor1 = SunPosition(jd0UT + deltaT / 24.0 / 3600.0);
+	Astronomy::coor coor2 = SunPosition(jd0UT + 1.0 + deltaT / 24.0 / 3600.0);
+
+	Astronomy::coor rise[AS_SUN_EVENTS];
+	SunEventsUTC(jd0UT, coor1, coor2, obs, rise);
+	events[AS_GRID_RISE] = rise[0].rise;
+	events[AS_GRID_TRANSIT] = rise[0].transit;
+	events[AS_GRID_SET] = rise[0].set;
+	events[AS_GRID_CIVIL_MORNING] = rise[1].rise;
+	events[AS_GRID_CIVIL_EVENING] = rise[1].set;
+	events[AS_GRID_NAUTICAL_MORNING] = rise[2].rise;
+	events[AS_GRID_NAUTICAL_EVENING] = rise[2].set;
+	events[AS_GRID_ASTRONOMICAL_MORNING] = rise[3].rise;
+	events[AS_GRID_ASTRONOMICAL_EVENING] = rise[3].set;
+}
+
+// Times (hours local time, NaN if the altitude is not reached) at which the sun center passes
+// the count altitudes (degrees, 0 is sunrise/sunset) in the morning and the evening of the local
+// day d. Like the twilights of CalcSunRise() all altitudes are taken from the UTC day of d.
+void Astronomy::CalcSunEvents(as_date d, const double *altitudes, int count, double *morning, double *evening){
+	as_stats_timer timer;
+	double jd0UT = CalcJD(d.day, d.month, d.year);
+	Astronomy::coor coor1 = SunPosition(jd0UT + m_DeltaT / 24.0 / 3600.0);
+	Astronomy::coor coor2 = SunPosition(jd0UT + 1.0 + m_DeltaT / 24.0 / 3600.0);
+
+	double naltitudes[AS_SUN_ALTITUDES_MAX] = {0};
+	Astronomy::coor rise[AS_SUN_ALTITUDES_MAX];
+	if (count > AS_SUN_ALTITUDES_MAX) count = AS_SUN_ALTITUDES_MAX;
+	for (int i = 0; i < count; i++) naltitudes[i] = altitudes[i] * DEG;
+	RiseSetMulti(jd0UT, coor1, coor2, m_Observer, 1, naltitudes, count, rise);
+	for (int i = 0; i < count; i++) {
+		morning[i] = Mod(rise[i].rise + m_Zone, 24.0);
+		evening[i] = Mod(rise[i].set + m_Zone, 24.0);
+	}
+	timer.stop(AS_PHASE_SUNRISE);
+}
+
+// JSON array of CalcSunEvents(): [{"Altitude":6,"Morning":"hh:mm:ss","Evening":"hh:mm:ss"},...]
+bool Astronomy::GetSunEventsJSON(as_date d, const double *altitudes, int count, char *buf, unsigned long size, unsigned long *length){
+	double morning[AS_SUN_ALTITUDES_MAX];
+	double evening[AS_SUN_ALTITUDES_MAX];
+	if (count > AS_SUN_ALTITUDES_MAX) count = AS_SUN_ALTITUDES_MAX;
+	CalcSunEvents(d, altitudes, count, morning, evening);
+
+	as_stats_timer timer;
+	as_buffer out(buf, size - 1);
+	out.put('[');
+	for (int i = 0; i < count; i++) {
+		if (i > 0) out.put(',');
+		out.put("{\"Altitude\":");
+		out.putNumber(altitudes[i], 3);
+		out.put(",\"Morning\":\"");
+		WriteHHMMSS(out, TimeSpan(morning[i]));
+		out.put("\",\"Evening\":\"");
+		WriteHHMMSS(out, TimeSpan(evening[i]));
+		out.put("\"}");
+	}
+	out.put(']');
+	timer.stop(AS_PHASE_JSON);
+	*out.pos = '\0';
+	*length = out.pos - buf;
+	return !out.overflow;
+}
+
+// CalcSunRise() of the local day JD0 interpolated from the rise/set grid, false if the
+// grid can not answer (not loaded, not covered or near polar day/night)
+bool Astronomy::GridSunRise(double JD0, double lon, double lat, int zone, Astronomy::coor *rise){
+	double day[AS_GRID_EVENTS], other[AS_GRID_EVENTS];
+	double jd0UT = floor(JD0 - 0.5) + 0.5;
+	if (!as_grid_sunrise(jd0UT, lat * RAD, lon * RAD, m_DeltaT, day)) return false;
+
+	// same adjustment to the local calendar day as CalcSunRise(), interpolated times
+	// close to the day boundary may end up on the wrong day
+	double rs = day[AS_GRID_RISE], tr = day[AS_GRID_TRANSIT], st = day[AS_GRID_SET];
+	double boundary = (zone > 0) ? 24 - zone : -zone;
+	double margin = AS_GRID_MARGIN / 3600.0;
+	if (zone != 0 && (fabs(rs - boundary) < margin || fabs(tr - boundary) < margin || fabs(st - boundary) < margin)) {
+		return false;
+	}
+	if (zone > 0 && (rs >= 24 - zone || tr >= 24 - zone || st >= 24 - zone)) {
+		if (!as_grid_sunrise(jd0UT + 1, lat * RAD, lon * RAD, m_DeltaT, other)) return false;
+		if (rs >= 24 - zone) rs = other[AS_GRID_RISE];
+		if (tr >= 24 - zone) tr = other[AS_GRID_TRANSIT];
+		if (st >= 24 - zone) st = other[AS_GRID_SET];
+	}
+	else if (zone < 0 && (rs < -zone || tr < -zone || st < -zone)) {
+		if (!as_grid_sunrise(jd0UT - 1, lat * RAD, lon * RAD, m_DeltaT, other)) return false;
+		if (rs < -zone) rs = other[AS_GRID_RISE];
+		if (tr < -zone) tr = other[AS_GRID_TRANSIT];
+		if (st < -zone) st = other[AS_GRID_SET];
+	}
+
+	rise->rise = Mod(rs + zone, 24.0);
+	rise->transit = Mod(tr + zone, 24.0);
+	rise->set = Mod(st + zone, 24.0);
+	rise->cicilTwilightMorning = Mod(day[AS_GRID_CIVIL_MORNING] + zone, 24.0);
+	rise->cicilTwilightEvening = Mod(day[AS_GRID_CIVIL_EVENING] + zone, 24.0);
+	rise->nauticalTwilightMorning = Mod(day[AS_GRID_NAUTICAL_MORNING] + zone, 24.0);
+	rise->nauticalTwilightEvening = Mod(day[AS_GRID_NAUTICAL_EVENING] + zone, 24.0);
+	rise->astronomicalTwilightMorning = Mod(day[AS_GRID_ASTRONOMICAL_MORNING] + zone, 24.0);
+	rise->astronomicalTwilightEvening = Mod(day[AS_GRID_ASTRONOMICAL_EVENING] + zone, 24.0);
+	return true;
+}
+
+// Sun rise/set of the local day JD0, from the rise/set grid if enabled and possible
+Astronomy::coor Astronomy::SunRise(double JD0, const observer &obs){
+	Astronomy::coor rise;
+	if (m_Grid && m_Precision != AS_PRECISION_PRECISE) {
+		bool hit = GridSunRise(JD0, obs.lon, obs.lat, m_Zone, &rise);
+		as_stats_cache(AS_CACHE_GRID, hit);
+		if (hit) return rise;
+	}
+	return CalcSunRise(JD0, m_DeltaT, obs, m_Zone, false);
+}
+
+// Rise/set events of a coor in the rise/set cache and back
+void Astronomy::ToCache(const coor &rise, as_cache_riseset *c){
+	c->rise = rise.rise;
+	c->transit = rise.transit;
+	c->set = rise.set;
+	c->civilMorning = rise.cicilTwilightMorning;
+	c->civilEvening = rise.cicilTwilightEvening;
+	c->nauticalMorning = rise.nauticalTwilightMorning;
+	c->nauticalEvening = rise.nauticalTwilightEvening;
+	c->astronomicalMorning = rise.astronomicalTwilightMorning;
+	c->astronomicalEvening = rise.astronomicalTwilightEvening;
+}
+
+void Astronomy::FromCache(const as_cache_riseset &c, coor *rise){
+	rise->rise = c.rise;
+	rise->transit = c.transit;
+	rise->set = c.set;
+	rise->cicilTwilightMorning = c.civilMorning;
+	rise->cicilTwilightEvening = c.civilEvening;
+	rise->nauticalTwilightMorning = c.nauticalMorning;
+	rise->nauticalTwilightEvening = c.nauticalEvening;
+	rise->astronomicalTwilightMorning = c.astronomicalMorning;
+	rise->astronomicalTwilightEvening = c.astronomicalEvening;
+}
+
+// Calculate sun and/or moon rise/set (calc) for the local day JD0 at the observer position,
+// reusing the results of all connections if the rise/set cache is enabled
+void Astronomy::SharedRiseSet(double JD0, const observer &obs, unsigned calc, coor *sun, coor *moon){
+	if (calc == 0) return;
+	if (!as_cache_enabled()) {
+		if (calc & AS_CALC_SUNRISE) {
+			as_stats_timer timer;
+			*sun = SunRise(JD0, obs);
+			timer.stop(AS_PHASE_SUNRISE);
 		}
-		else if (zone < 0)
-		{
-			// rise time was yesterday local time -> calculate rise time for next UTC day
-			if (rise.rise < -zone || rise.transit < -zone || rise.set < -zone)
-			{
-				risetemp = CalcSunRise(JD - 1, deltaT, lon, lat, zone, true);
-				if (rise.rise < -zone) rise.rise = risetemp.rise;
-				if (rise.transit < -zone) rise.transit = risetemp.transit;
-				if (rise.set < -zone) rise.set = risetemp.set;
-			}
+		if (calc & AS_CALC_MOONRISE) {
+			as_stats_timer timer;
+			*moon = CalcMoonRise(JD0, m_DeltaT, obs, m_Zone, false);
+			timer.stop(AS_PHASE_MOONRISE);
 		}
+		return;
+	}
 
-		rise.transit = Mod(rise.transit + zone, 24.0);
-		rise.rise = Mod(rise.rise + zone, 24.0);
-		rise.set = Mod(rise.set + zone, 24.0);
+	// nearby sites share the results at the center of their cell
+	observer cell = obs;
+	double quant = as_cache_quant();
+	if (quant > 0.0) {
+		cell = Observer(floor(obs.lon * RAD / quant + 0.5) * quant * DEG, floor(obs.lat * RAD / quant + 0.5) * quant * DEG);
+	}
+	as_cache_key key = {JD0, cell.lon, cell.lat, m_Zone, m_DeltaT, m_Grid, m_Precision, m_Math};
+	as_cache_value value;
+	if (!as_cache_get(&key, &value)) value.calc = 0;
+
+	unsigned missing = calc & ~value.calc;
+	if (missing & AS_CALC_SUNRISE) {
+		as_stats_timer timer;
+		ToCache(SunRise(JD0, cell), &value.sun);
+		timer.stop(AS_PHASE_SUNRISE);
+	}
+	if (missing & AS_CALC_MOONRISE) {
+		as_stats_timer timer;
+		ToCache(CalcMoonRise(JD0, m_DeltaT, cell, m_Zone, false), &value.moon);
+		timer.stop(AS_PHASE_MOONRISE);
+	}
+	as_stats_cache(AS_CACHE_SHARED, !missing);
+	if (missing) {
+		value.calc |= missing;
+		as_cache_put(&key, &value);
+	}
 
-		// Twilight calculation
-		// civil twilight time in UTC.
-		risetemp = RiseSet(jd0UT, coor1, coor2, lon, lat, 1, -6.0 * DEG);
-		rise.cicilTwilightMorning = Mod(risetemp.rise + zone, 24.0);
-		rise.cicilTwilightEvening = Mod(risetemp.set + zone, 24.0);
+	if (calc & AS_CALC_SUNRISE) FromCache(value.sun, sun);
+	if (calc & AS_CALC_MOONRISE) FromCache(value.moon, moon);
+}
 
-		// nautical twilight time in UTC.
-		risetemp = RiseSet(jd0UT, coor1, coor2, lon, lat, 1, -12.0 * DEG);
-		rise.nauticalTwilightMorning = Mod(risetemp.rise + zone, 24.0);
-		rise.nauticalTwilightEvening = Mod(risetemp.set + zone, 24.0);
+// Calculate sunRise and/or moonRise (calc: AS_CALC_SUNRISE, AS_CALC_MOONRISE) for the local
+// day JD0 at the observer position, reusing results of the attached memo if there are any
+void Astronomy::CalcRiseSet(double JD0, const observer &obs, unsigned calc){
+	calc &= AS_CALC_SUNRISE | AS_CALC_MOONRISE;
+	if (m_Days != NULL && (calc & ~m_Days->calc) == 0) {
+		double day = JD0 - m_Days->JD0;
+		if (day >= 0 && day < m_Days->sunRise.size() && day == floor(day)) {
+			if (calc & AS_CALC_SUNRISE) sunRise = m_Days->sunRise[(size_t)day];
+			if (calc & AS_CALC_MOONRISE) moonRise = m_Days->moonRise[(size_t)day];
+			return;
+		}
+	}
+	if (m_Memo == NULL) {
+		SharedRiseSet(JD0, obs, calc, &sunRise, &moonRise);
+		return;
+	}
 
-		// astronomical twilight time in UTC.
-		risetemp = RiseSet(jd0UT, coor1, coor2, lon, lat, 1, -18.0 * DEG);
-		rise.astronomicalTwilightMorning = Mod(risetemp.rise + zone, 24.0);
-		rise.astronomicalTwilightEvening = Mod(risetemp.set + zone, 24.0);
+	unsigned i;
+	for (i = 0; i < RISESET_MEMO_SIZE; i++) {
+		if (m_Memo->entry[i].calc && m_Memo->entry[i].JD0 == JD0 && m_Memo->entry[i].lon == obs.lon
+		 && m_Memo->entry[i].lat == obs.lat && m_Memo->entry[i].zone == m_Zone) {
+			break;
+		}
 	}
-	return rise;
+	if (i == RISESET_MEMO_SIZE) {
+		// replace the oldest entry
+		i = m_Memo->next;
+		m_Memo->next = (i + 1) % RISESET_MEMO_SIZE;
+		m_Memo->entry[i].calc = 0;
+		m_Memo->entry[i].JD0 = JD0;
+		m_Memo->entry[i].lon = obs.lon;
+		m_Memo->entry[i].lat = obs.lat;
+		m_Memo->entry[i].zone = m_Zone;
+	}
+
+	unsigned missing = calc & ~m_Memo->entry[i].calc;
+	SharedRiseSet(JD0, obs, missing, &m_Memo->entry[i].sunRise, &m_Memo->entry[i].moonRise);
+	m_Memo->entry[i].calc |= missing;
+	if (missing) m_Memo->misses++;
+	else m_Memo->hits++;
+	as_stats_cache(AS_CACHE_MEMO, !missing);
+
+	sunRise = m_Memo->entry[i].sunRise;
+	moonRise = m_Memo->entry[i].moonRise;
 }
 
+// Calculate sun and/or moon rise/set (calc) of count local days starting at first. Every
+// position is calculated once: the sun at 0h UT is shared by the two UTC days it bounds,
+// and the UTC events of a day are shared with the neighbouring local days that need them.
+void Astronomy::CalcRiseSetDays(as_date first, unsigned count, unsigned calc, riseset_days *days){
+	double JD0 = CalcJD(first.day, first.month, first.year);
+	double dT = m_DeltaT / 24.0 / 3600.0;
+	int zone = (int)m_Zone;
+
+	days->JD0 = JD0;
+	days->calc = calc & (AS_CALC_SUNRISE | AS_CALC_MOONRISE);
+	days->sunRise.resize(count);
+	days->moonRise.resize(count);
+	if (days->calc == 0 || count == 0) return;
+
+	// UTC days -1 .. count (index k: JD0 + k - 1), sun at 0h UT of the days -1 .. count + 1
+	std::vector<coor> sun0(count + 3);
+	std::vector<coor> utc(count + 2);
+	{
+		as_stats_timer timer;
+		for (unsigned k = 0; k < count + 3; k++) {
+			sun0[k] = SunPosition(JD0 + k - 1.0 + dT);
+		}
+		timer.stop(AS_PHASE_SUN);
+	}
+
+	if (calc & AS_CALC_SUNRISE) {
+		as_stats_timer timer;
+		// all events of the local days, rise/set of the days before and after
+		std::vector<coor> events((count + 2) * AS_SUN_EVENTS);
+		for (unsigned k = 0; k < count + 2; k++) {
+			if (k == 0 || k == count + 1) events[k * AS_SUN_EVENTS] = RiseSet(JD0 + k - 1.0, sun0[k], sun0[k + 1], m_Observer, 1);
+			else SunEventsUTC(JD0 + k - 1.0, sun0[k], sun0[k + 1], m_Observer, &events[k * AS_SUN_EVENTS]);
+		}
+		for (unsigned i = 0; i < count; i++) {
+			const coor *day = &events[(i + 1) * AS_SUN_EVENTS];
+			int other = SunRiseOtherDay(day[0], zone);
+			days->sunRise[i] = SunRiseLocal(day, day[other * AS_SUN_EVENTS], zone);
+		}
+		timer.stop(AS_PHASE_SUNRISE);
+	}
+
+	if (calc & AS_CALC_MOONRISE) {
+		as_stats_timer timer;
+		for (unsigned k = 0; k < count + 2; k++) {
+			double jd0UT = JD0 + k - 1.0;
+			Astronomy::coor coor1 = MoonPosition(sun0[k], jd0UT + dT);
+			Astronomy::coor suncoor2 = SunPosition(jd0UT + 0.5 + dT);
+			Astronomy::coor coor2 = MoonPosition(suncoor2, jd0UT + 0.5 + dT);
+			utc[k] = RiseSet(jd0UT, coor1, coor2, m_Observer, 0.5);
+		}
+		for (unsigned i = 0; i < count; i++) {
+			int other = MoonRiseOtherDay(utc[i + 1], zone);
+			days->moonRise[i] = MoonRiseLocal(utc[i + 1], utc[i + 1 + other], zone);
+		}
+		timer.stop(AS_PHASE_MOONRISE);
+	}
+}
 
+template<unsigned CALC>
 void Astronomy::setInput(as_date d, as_time t){
-	std::string res="";  char buf[20];
+	constexpr unsigned calc = (CALC & AS_CALC_MOON) ? CALC | AS_CALC_SUN : CALC; // moon position depends on the sun position
 
 	double JD0 = CalcJD(d.day, d.month, d.year);
 	double jd = JD0 + (t.hour - m_Zone + t.minute / 60.0 + t.second / 3600.0) / 24.0;
 	double TDT = jd + m_DeltaT / 24.0 / 3600.0;
-	double lat = m_Lat * DEG; // geodetic latitude of observer on WGS84
-	double lon = m_Lon * DEG; // latitude of observer
-	double height = 0 * 0.001; // altiude of observer in meters above WGS84 ellipsoid (and converted to kilometers)
 	double gmst = CalcGMST(jd);
-	double lmst = GMST2LMST(gmst, lon);
-	observerCart = Observer2EquCart(lon, lat, height, gmst); // geocentric cartesian coordinates of observer
-	sunCoor = SunPosition(TDT, lat, lmst * 15.0 * DEG);   // Calculate data for the Sun at given time
-	moonCoor = MoonPosition(sunCoor, TDT, observerCart, lmst * 15.0 * DEG);    // Calculate data for the Moon at given time
+	double lmst = GMST2LMST(gmst, m_Observer);
 
 	m_JD = round100000(jd);
-	m_GMST = TimeSpan(gmst);
-	m_LMST = TimeSpan(lmst);
-
-	m_SunLon = round1000(sunCoor.lon * RAD);
-	m_SunRA = TimeSpan(sunCoor.ra * RAD / 15);
-	m_SunDec = round1000(sunCoor.dec * RAD);
-	m_SunAz = round100(sunCoor.az * RAD);
-	m_SunAlt = round10(sunCoor.alt * RAD + Refraction(sunCoor.alt));  // including refraction
-
-	m_SunSign = Sign(sunCoor.lon);
-	m_SunDiameter = round100(sunCoor.diameter * RAD * 60.0); // angular diameter in arc seconds
-	m_SunDistance = round10(sunCoor.distance);
-
-	// Calculate distance from the observer (on the surface of earth) to the center of the sun
-	sunCart = EquPolar2Cart(sunCoor.ra, sunCoor.dec, sunCoor.distance);
-	double sunCardxSqr=(sunCart.x - observerCart.x) * (sunCart.x - observerCart.x);
-	double sunCardySqr=(sunCart.y - observerCart.y) * (sunCart.y - observerCart.y);
-	double sunCartzSqr=(sunCart.z - observerCart.z) * (sunCart.z - observerCart.z);
-	m_SunDistanceObserver = round10(sqrt(sunCardxSqr  + sunCardySqr  + sunCartzSqr));
-
-	sunRise = CalcSunRise(JD0, m_DeltaT, lon, lat, m_Zone, false);
-	m_SunTransit = TimeSpan(sunRise.transit);
-	m_SunRise = TimeSpan(sunRise.rise);
-	m_SunSet = TimeSpan(sunRise.set);
-	m_SunCivilTwilightMorning = TimeSpan(sunRise.cicilTwilightMorning);
-	m_SunCivilTwilightEvening = TimeSpan(sunRise.cicilTwilightEvening);
-	m_SunNauticalTwilightMorning = TimeSpan(sunRise.nauticalTwilightMorning);
-	m_SunNauticalTwilightEvening = TimeSpan(sunRise.nauticalTwilightEvening);
-	m_SunAstronomicalTwilightMorning = TimeSpan(sunRise.astronomicalTwilightMorning);
-	m_SunAstronomicalTwilightEvening = TimeSpan(sunRise.astronomicalTwilightEvening);
-
-	m_MoonLon = round1000(moonCoor.lon * RAD);
-	m_MoonLat = round1000(moonCoor.lat * RAD);
-	m_MoonRA = TimeSpan(moonCoor.ra * RAD / 15.0);
-	m_MoonDec = round1000(moonCoor.dec * RAD);
-	m_MoonAz = round100(moonCoor.az * RAD);
-	m_MoonAlt = round10(moonCoor.alt * RAD + Refraction(moonCoor.alt));  // including refraction
-	m_MoonAge = round1000(moonCoor.moonAge * RAD);
-	m_MoonPhaseNumber = round1000(moonCoor.phase);
-
-	int phase = (int)moonCoor.moonPhase;
-	if (phase == 8) phase = 0;
-	m_MoonPhase = (LUNARPHASE)phase;
-
-	m_MoonSign = Sign(moonCoor.lon);
-	m_MoonDistance = round10(moonCoor.distance);
-	m_MoonDiameter = round100(moonCoor.diameter * RAD * 60.0); // angular diameter in arc seconds
-
-	// Calculate distance from the observer (on the surface of earth) to the center of the moon
-	moonCart = EquPolar2Cart(moonCoor.raGeocentric, moonCoor.decGeocentric, moonCoor.distance);
-	double moonCardxSqr=(moonCart.x - observerCart.x) * (moonCart.x - observerCart.x);
-	double moonCardySqr=(moonCart.y - observerCart.y) * (moonCart.y - observerCart.y);
-	double moonCartzSqr=(moonCart.z - observerCart.z) * (moonCart.z - observerCart.z);
-	m_MoonDistanceObserver = round10(sqrt(moonCardxSqr + moonCardySqr + moonCartzSqr));
-
-	moonRise = CalcMoonRise(JD0, m_DeltaT, lon, lat, m_Zone, false);
-
-	m_MoonTransit = TimeSpan(moonRise.transit);
-	m_MoonRise = TimeSpan(moonRise.rise);
-	m_MoonSet = TimeSpan(moonRise.set);
-
-    sprintf(buf, "%02d:%02d:%02d", t.hour, t.minute, t.second);
-    m_Time = std::string(buf);
-    sprintf(buf, "%04d-%02d-%02d", d.year, d.month, d.day);
-    m_Date = std::string(buf);
-    m_os+= "{";
-        m_os+= "\"Time\":\"" + m_Date + "T" + m_Time + "\",";
-        m_os+= "\"Zone\":" + std::to_string((int)m_Zone) + ",";
-        m_os+= "\"Latitude\":" + std::to_string(m_Lat) + ",";
-        m_os+= "\"Longitude\":" + std::to_string(m_Lon) + ",";
-        m_os+= "\"deltaT\":" + std::to_string(m_DeltaT) +  ",";
-        m_os+= "\"JulianDate\":" + std::to_string(m_JD) + ",";
-        m_os+= "\"GMST\":\"" + m_GMST.HHMMSS + "\",";
-        m_os+= "\"LMST\":\"" + m_LMST.HHMMSS + "\",";
-
-        m_os+= "\"Sun\":{";
-            m_os+= "\"Distance\":{";
-                m_os+= "\"Earth\":" + std::to_string(m_SunDistance) + ",";
-                m_os+= "\"Observer\":" + std::to_string(m_SunDistanceObserver) + "";
-            m_os+= "},";
-            m_os+= "\"Ecliptic\":" + std::to_string(m_SunLon) + ",";
-            m_os+= "\"Declination\":" + std::to_string(m_SunDec) + ",";
-            m_os+= "\"Azimuth\":" + std::to_string(m_SunAz) + ",";
-            m_os+= "\"Height\":" + std::to_string(m_SunAlt) + ",";
-            m_os+= "\"Diameter\":" + std::to_string(m_SunDiameter) + ",";
-            m_os+= "\"Rise\":{";
-                m_os+= "\"Astronomical\":\"" + m_SunAstronomicalTwilightMorning.HHMMSS + "\",";
-                m_os+= "\"Nautical\":\"" + m_SunNauticalTwilightMorning.HHMMSS + "\",";
-                m_os+= "\"Civil\":\"" + m_SunCivilTwilightMorning.HHMMSS + "\",";
-                m_os+= "\"Sunrise\":\"" + m_SunRise.HHMMSS + "\"";
-            m_os+= "},";
-            m_os+= "\"Culmination\":\"" + m_SunTransit.HHMMSS + "\",";
-            m_os+= "\"Set\":{";
-                m_os+= "\"Sunset\":\"" + m_SunSet.HHMMSS + "\",";
-                m_os+= "\"Civil\":\"" + m_SunCivilTwilightEvening.HHMMSS + "\",";
-                m_os+= "\"Nautical\":\"" + m_SunNauticalTwilightEvening.HHMMSS + "\",";
-                m_os+= "\"Astronomical\":\"" + m_SunAstronomicalTwilightEvening.HHMMSS + "\"";
-            m_os+= "},";
-            m_os+= "\"Ascension\":\"" + m_SunRA.HHMMSS + "\",";
-            m_os+= "\"Zodiac\":\"" + ZodiacSign[(int)m_SunSign] + "\"";
-        m_os+= "},";
-
-        m_os+= "\"Moon\":{";
-            m_os+= "\"Distance\":{";
-                m_os+= "\"Earth\":" + std::to_string(m_MoonDistance) + ",";
-                m_os+= "\"Observer\":" + std::to_string(m_MoonDistanceObserver) + "";
-            m_os+= "},";
-            m_os+= "\"Ecliptic\":{";
-                m_os+= "\"Latitude\":" + std::to_string(m_MoonLat) + ",";
-                m_os+= "\"Longitude\":" + std::to_string(m_MoonLon) + "";
-            m_os+= "},";
-            m_os+= "\"Declination\":" + std::to_string(m_MoonDec) + ",";
-            m_os+= "\"Azimuth\":" + std::to_string(m_MoonAz) + ",";
-            m_os+= "\"Height\":" + std::to_string(m_MoonAlt) + ",";
-            m_os+= "\"Diameter\":" + std::to_string(m_MoonDiameter) + ",";
-            m_os+= "\"Rise\":\"" + m_MoonRise.HHMMSS + "\",";
-            m_os+= "\"Culmination\":\"" + m_MoonTransit.HHMMSS + "\",";
-            m_os+= "\"Set\":\"" + m_MoonSet.HHMMSS + "\",";
-            m_os+= "\"Ascension\":\"" + m_MoonRA.HHMMSS + "\",";
-            m_os+= "\"Phase\":{";
-                m_os+= "\"Name\":\"" + lunaphase[(int)m_MoonPhase] + "\",";
-                m_os+= "\"Value\":" + std::to_string((int)m_MoonPhase) + ",";
-                m_os+= "\"Number\":" + std::to_string(m_MoonPhaseNumber)+ "";
-            m_os+= "},";
-            m_os+= "\"Age\":" + std::to_string(m_MoonAge) + ",";
-            m_os+= "\"Sign\":\"" + ZodiacSign[(int)m_MoonSign] + "\"";
-        m_os+= "}";
-    m_os+= "}";
+	if (calc & AS_CALC_JSON) {
+		m_GMST = TimeSpan(gmst);
+		m_LMST = TimeSpan(lmst);
+	}
+
+	coor observerCart, sunCoor;
+	if (calc & AS_CALC_SUN) {
+		as_stats_timer timer;
+		if (calc & (AS_CALC_MOON | AS_CALC_JSON)) {
+			if (!m_Observer.geocentric) ObserverGeocentric(&m_Observer);
+			observerCart = Observer2EquCart(m_Observer, gmst); // geocentric cartesian coordinates of observer
+		}
+		sunCoor = EpochPosition(TDT);   // Calculate data for the Sun at given time
+		sunCoor = Equ2Altaz(sunCoor, TDT, m_Observer, lmst * 15.0 * DEG);
+		timer.stop(AS_PHASE_SUN);
+
+		m_SunLon = round1000(sunCoor.lon * RAD);
+		m_SunDec = round1000(sunCoor.dec * RAD);
+		m_SunAz = round100(sunCoor.az * RAD);
+		m_SunAlt = round10(sunCoor.alt * RAD + Refraction(sunCoor.alt));  // including refraction
+		m_SunDiameter = round100(sunCoor.diameter * RAD * 60.0); // angular diameter in arc seconds
+		m_SunDistance = round10(sunCoor.distance);
+
+		if (calc & AS_CALC_JSON) {
+			m_SunRA = TimeSpan(sunCoor.ra * RAD / 15);
+			m_SunSign = Sign(sunCoor.lon);
+
+			// Calculate distance from the observer (on the surface of earth) to the center of the sun
+			coor sunCart = EquPolar2Cart(sunCoor.ra, sunCoor.dec, sunCoor.distance);
+			double sunCardxSqr=(sunCart.x - observerCart.x) * (sunCart.x - observerCart.x);
+			double sunCardySqr=(sunCart.y - observerCart.y) * (sunCart.y - observerCart.y);
+			double sunCartzSqr=(sunCart.z - observerCart.z) * (sunCart.z - observerCart.z);
+			m_SunDistanceObserver = round10(sqrt(sunCardxSqr  + sunCardySqr  + sunCartzSqr));
+		}
+	}
+
+	if (calc & (AS_CALC_SUNRISE | AS_CALC_MOONRISE)) {
+		CalcRiseSet(JD0, m_Observer, calc);
+	}
+
+	if (calc & AS_CALC_SUNRISE) {
+		m_SunTransit = TimeSpan(sunRise.transit);
+		m_SunRise = TimeSpan(sunRise.rise);
+		m_SunSet = TimeSpan(sunRise.set);
+		m_SunCivilTwilightMorning = TimeSpan(sunRise.cicilTwilightMorning);
+		m_SunCivilTwilightEvening = TimeSpan(sunRise.cicilTwilightEvening);
+		m_SunNauticalTwilightMorning = TimeSpan(sunRise.nauticalTwilightMorning);
+		m_SunNauticalTwilightEvening = TimeSpan(sunRise.nauticalTwilightEvening);
+		m_SunAstronomicalTwilightMorning = TimeSpan(sunRise.astronomicalTwilightMorning);
+		m_SunAstronomicalTwilightEvening = TimeSpan(sunRise.astronomicalTwilightEvening);
+	}
+
+	if (calc & AS_CALC_MOON) {
+		as_stats_timer timer;
+		coor moonCoor = EpochPosition(TDT, &sunCoor);    // Calculate data for the Moon at given time
+		moonCoor = MoonTopocentric(moonCoor, TDT, m_Observer, lmst * 15.0 * DEG);
+		timer.stop(AS_PHASE_MOON);
+
+		m_MoonLon = round1000(moonCoor.lon * RAD);
+		m_MoonLat = round1000(moonCoor.lat * RAD);
+		m_MoonDec = round1000(moonCoor.dec * RAD);
+		m_MoonAz = round100(moonCoor.az * RAD);
+		m_MoonAlt = round10(moonCoor.alt * RAD + Refraction(moonCoor.alt));  // including refraction
+		m_MoonAge = round1000(moonCoor.moonAge * RAD);
+		m_MoonPhaseNumber = round1000(moonCoor.phase);
+
+		int phase = (int)moonCoor.moonPhase;
+		if (phase == 8) phase = 0;
+		m_MoonPhase = (LUNARPHASE)phase;
+
+		m_MoonDistance = round10(moonCoor.distance);
+		m_MoonDiameter = round100(moonCoor.diameter * RAD * 60.0); // angular diameter in arc seconds
+
+		if (calc & AS_CALC_JSON) {
+			m_MoonRA = TimeSpan(moonCoor.ra * RAD / 15.0);
+			m_MoonSign = Sign(moonCoor.lon);
+
+			// Calculate distance from the observer (on the surface of earth) to the center of the moon
+			coor moonCart = EquPolar2Cart(moonCoor.raGeocentric, moonCoor.decGeocentric, moonCoor.distance);
+			double moonCardxSqr=(moonCart.x - observerCart.x) * (moonCart.x - observerCart.x);
+			double moonCardySqr=(moonCart.y - observerCart.y) * (moonCart.y - observerCart.y);
+			double moonCartzSqr=(moonCart.z - observerCart.z) * (moonCart.z - observerCart.z);
+			m_MoonDistanceObserver = round10(sqrt(moonCardxSqr + moonCardySqr + moonCartzSqr));
+		}
+	}
+
+	if (calc & AS_CALC_MOONRISE) {
+		m_MoonTransit = TimeSpan(moonRise.transit);
+		m_MoonRise = TimeSpan(moonRise.rise);
+		m_MoonSet = TimeSpan(moonRise.set);
+	}
+
+	m_InDate = d;
+	m_InTime = t;
+}
+
+// setInput() of every combination of stages, indexed by the stages
+typedef void (Astronomy::*as_setinput_func)(as_date, as_time);
+
+template<size_t... CALC>
+static constexpr std::array<as_setinput_func, sizeof...(CALC)> as_setinput_table(std::index_sequence<CALC...>){
+	return {{&Astronomy::setInput<CALC>...}};
+}
+
+static constexpr std::array<as_setinput_func, AS_CALC_ALL + 1> as_setinput_stages = as_setinput_table(std::make_index_sequence<AS_CALC_ALL + 1>());
+
+// for callers in other translation units
+template void Astronomy::setInput<AS_CALC_SUN>(as_date, as_time);
+template void Astronomy::setInput<AS_CALC_MOON>(as_date, as_time);
+template void Astronomy::setInput<AS_CALC_SUNRISE>(as_date, as_time);
+template void Astronomy::setInput<AS_CALC_MOONRISE>(as_date, as_time);
+template void Astronomy::setInput<AS_CALC_ALL>(as_date, as_time);
+
+void Astronomy::setInput(as_date d, as_time t, unsigned calc){
+	if (calc & AS_CALC_JSON) calc |= FieldsCalc(m_Fields); // values of the JSON result fields
+	(this->*as_setinput_stages[calc & AS_CALC_ALL])(d, t);
+}
+
+const Astronomy::fieldinfo Astronomy::m_FieldInfo[AS_FIELD_COUNT] = {
+	{{"Time"},                                      0,                  FT_DATETIME,        0, NULL,                       NULL, PT_DATETIME, offsetof(as_packed, year)},
+	{{"Zone"},                                      0,                  FT_INT,             0, &Astronomy::m_Zone,         NULL, PT_INT32, offsetof(as_packed, zone)},
+	{{"Latitude"},                                  0,                  FT_DOUBLE,          6, &Astronomy::m_Lat,          NULL, PT_INT32, offsetof(as_packed, latitude)},
+	{{"Longitude"},                                 0,                  FT_DOUBLE,          6, &Astronomy::m_Lon,          NULL, PT_INT32, offsetof(as_packed, longitude)},
+	{{"deltaT"},                                    0,                  FT_DOUBLE,          0, &Astronomy::m_DeltaT,       NULL, PT_INT32, offsetof(as_packed, delta_t)},
+	{{"JulianDate"},                                0,                  FT_DOUBLE,          5, &Astronomy::m_JD,           NULL, PT_DOUBLE, offsetof(as_packed, julian_date)},
+	{{"GMST"},                                      0,                  FT_TIMESPAN,        0, NULL,                       &Astronomy::m_GMST, PT_INT32, offsetof(as_packed, gmst)},
+	{{"LMST"},                                      0,                  FT_TIMESPAN,        0, NULL,                       &Astronomy::m_LMST, PT_INT32, offsetof(as_packed, lmst)},
+	{{"Sun", "Distance", "Earth"},                  AS_CALC_SUN,        FT_DOUBLE,          1, &Astronomy::m_SunDistance,  NULL, PT_INT32, offsetof(as_packed, sun_distance_earth)},
+	{{"Sun", "Distance", "Observer"},               AS_CALC_SUN,        FT_DOUBLE,          1, &Astronomy::m_SunDistanceObserver, NULL, PT_INT32, offsetof(as_packed, sun_distance_observer)},
+	{{"Sun", "Ecliptic"},                           AS_CALC_SUN,        FT_DOUBLE,          3, &Astronomy::m_SunLon,       NULL, PT_INT32, offsetof(as_packed, sun_ecliptic)},
+	{{"Sun", "Declination"},                        AS_CALC_SUN,        FT_DOUBLE,          3, &Astronomy::m_SunDec,       NULL, PT_INT32, offsetof(as_packed, sun_declination)},
+	{{"Sun", "Azimuth"},                            AS_CALC_SUN,        FT_DOUBLE,          2, &Astronomy::m_SunAz,        NULL, PT_INT32, offsetof(as_packed, sun_azimuth)},
+	{{"Sun", "Height"},                             AS_CALC_SUN,        FT_DOUBLE,          1, &Astronomy::m_SunAlt,       NULL, PT_INT32, offsetof(as_packed, sun_height)},
+	{{"Sun", "Diameter"},                           AS_CALC_SUN,        FT_DOUBLE,          2, &Astronomy::m_SunDiameter,  NULL, PT_INT32, offsetof(as_packed, sun_diameter)},
+	{{"Sun", "Rise", "Astronomical"},               AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunAstronomicalTwilightMorning, PT_INT32, offsetof(as_packed, sun_rise_astronomical)},
+	{{"Sun", "Rise", "Nautical"},                   AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunNauticalTwilightMorning, PT_INT32, offsetof(as_packed, sun_rise_nautical)},
+	{{"Sun", "Rise", "Civil"},                      AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunCivilTwilightMorning, PT_INT32, offsetof(as_packed, sun_rise_civil)},
+	{{"Sun", "Rise", "Sunrise"},                    AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunRise, PT_INT32, offsetof(as_packed, sun_rise)},
+	{{"Sun", "Culmination"},                        AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunTransit, PT_INT32, offsetof(as_packed, sun_culmination)},
+	{{"Sun", "Set", "Sunset"},                      AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunSet, PT_INT32, offsetof(as_packed, sun_set)},
+	{{"Sun", "Set", "Civil"},                       AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunCivilTwilightEvening, PT_INT32, offsetof(as_packed, sun_set_civil)},
+	{{"Sun", "Set", "Nautical"},                    AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunNauticalTwilightEvening, PT_INT32, offsetof(as_packed, sun_set_nautical)},
+	{{"Sun", "Set", "Astronomical"},                AS_CALC_SUNRISE,    FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunAstronomicalTwilightEvening, PT_INT32, offsetof(as_packed, sun_set_astronomical)},
+	{{"Sun", "Ascension"},                          AS_CALC_SUN,        FT_TIMESPAN,        0, NULL,                       &Astronomy::m_SunRA, PT_INT32, offsetof(as_packed, sun_ascension)},
+	{{"Sun", "Zodiac"},                             AS_CALC_SUN,        FT_SUNSIGN,         0, NULL,                       NULL, PT_UINT8, offsetof(as_packed, sun_zodiac)},
+	{{"Moon", "Distance", "Earth"},                 AS_CALC_MOON,       FT_DOUBLE,          1, &Astronomy::m_MoonDistance, NULL, PT_INT32, offsetof(as_packed, moon_distance_earth)},
+	{{"Moon", "Distance", "Observer"},              AS_CALC_MOON,       FT_DOUBLE,          1, &Astronomy::m_MoonDistanceObserver, NULL, PT_INT32, offsetof(as_packed, moon_distance_observer)},
+	{{"Moon", "Ecliptic", "Latitude"},              AS_CALC_MOON,       FT_DOUBLE,          3, &Astronomy::m_MoonLat,      NULL, PT_INT32, offsetof(as_packed, moon_ecliptic_latitude)},
+	{{"Moon", "Ecliptic", "Longitude"},             AS_CALC_MOON,       FT_DOUBLE,          3, &Astronomy::m_MoonLon,      NULL, PT_INT32, offsetof(as_packed, moon_ecliptic_longitude)},
+	{{"Moon", "Declination"},                       AS_CALC_MOON,       FT_DOUBLE,          3, &Astronomy::m_MoonDec,      NULL, PT_INT32, offsetof(as_packed, moon_declination)},
+	{{"Moon", "Azimuth"},                           AS_CALC_MOON,       FT_DOUBLE,          2, &Astronomy::m_MoonAz,       NULL, PT_INT32, offsetof(as_packed, moon_azimuth)},
+	{{"Moon", "Height"},                            AS_CALC_MOON,       FT_DOUBLE,          1, &Astronomy::m_MoonAlt,      NULL, PT_INT32, offsetof(as_packed, moon_height)},
+	{{"Moon", "Diameter"},                          AS_CALC_MOON,       FT_DOUBLE,          2, &Astronomy::m_MoonDiameter, NULL, PT_INT32, offsetof(as_packed, moon_diameter)},
+	{{"Moon", "Rise"},                              AS_CALC_MOONRISE,   FT_TIMESPAN,        0, NULL,                       &Astronomy::m_MoonRise, PT_INT32, offsetof(as_packed, moon_rise)},
+	{{"Moon", "Culmination"},                       AS_CALC_MOONRISE,   FT_TIMESPAN,        0, NULL,                       &Astronomy::m_MoonTransit, PT_INT32, offsetof(as_packed, moon_culmination)},
+	{{"Moon", "Set"},                               AS_CALC_MOONRISE,   FT_TIMESPAN,        0, NULL,                       &Astronomy::m_MoonSet, PT_INT32, offsetof(as_packed, moon_set)},
+	{{"Moon", "Ascension"},                         AS_CALC_MOON,       FT_TIMESPAN,        0, NULL,                       &Astronomy::m_MoonRA, PT_INT32, offsetof(as_packed, moon_ascension)},
+	{{"Moon", "Phase", "Name"},                     AS_CALC_MOON,       FT_MOONPHASE_NAME,  0, NULL,                       NULL, PT_UINT8, offsetof(as_packed, moon_phase)},
+	{{"Moon", "Phase", "Value"},                    AS_CALC_MOON,       FT_MOONPHASE_VALUE, 0, NULL,                       NULL, PT_UINT8, offsetof(as_packed, moon_phase)},
+	{{"Moon", "Phase", "Number"},                   AS_CALC_MOON,       FT_DOUBLE,          3, &Astronomy::m_MoonPhaseNumber, NULL, PT_INT32, offsetof(as_packed, moon_phase_number)},
+	{{"Moon", "Age"},                               AS_CALC_MOON,       FT_DOUBLE,          3, &Astronomy::m_MoonAge,      NULL, PT_INT32, offsetof(as_packed, moon_age)},
+	{{"Moon", "Sign"},                              AS_CALC_MOON,       FT_MOONSIGN,        0, NULL,                       NULL, PT_UINT8, offsetof(as_packed, moon_sign)},
+};
+
+// Parse a comma separated list of JSON paths (e.g. 'Sun.Rise,Sun.Set,$.Moon.Phase.Name')
+// into a field bitset. A path selects all fields below it. Returns false on unknown paths.
+bool Astronomy::ParseFields(const char *str, unsigned long length, as_fields *fields){
+	const char *end = str + length;
+	*fields = 0;
+
+	while (str < end) {
+		while (str < end && (*str == ',' || isspace(*str))) str++;
+		const char *path = str;
+		while (str < end && *str != ',') str++;
+		const char *pathend = str;
+		while (pathend > path && isspace(pathend[-1])) pathend--;
+		if (pathend - path >= 2 && path[0] == '$' && path[1] == '.') path += 2;
+		if (pathend == path) continue;
+
+		bool found = false;
+		for (int f = 0; f < AS_FIELD_COUNT; f++) {
+			// compare path with the field's 'group.group.key' path
+			const char *p = path;
+			bool match = true;
+			for (int n = 0; n < 3 && match && m_FieldInfo[f].name[n] != NULL; n++) {
+				if (n > 0) {
+					if (p == pathend) break;
+					match = (*p++ == '.');
+				}
+				size_t len = strlen(m_FieldInfo[f].name[n]);
+				match = match && (size_t)(pathend - p) >= len && strncmp(p, m_FieldInfo[f].name[n], len) == 0;
+				if (match) p += len;
+			}
+			if (match && p == pathend) {
+				*fields |= ((as_fields)1) << f;
+				found = true;
+			}
+		}
+		if (!found) return false;
+	}
+	return true;
+}
+
+// Parse the JSON path of a single value (e.g. 'Sun.Azimuth'), the groups 'Sun.Rise'
+// and 'Sun.Set' select the sun rise and set. Returns false on unknown or group paths.
+bool Astronomy::ParseField(const char *str, unsigned long length, AS_FIELD *field){
+	as_fields fields;
+	if (!ParseFields(str, length, &fields) || fields == 0) return false;
+	if (fields == AS_FIELDS_RANGE(AS_FIELD_SUN_RISE_ASTRONOMICAL, AS_FIELD_SUN_RISE_SUNRISE)) {
+		fields = ((as_fields)1) << AS_FIELD_SUN_RISE_SUNRISE;
+	}
+	else if (fields == AS_FIELDS_RANGE(AS_FIELD_SUN_SET_SUNSET, AS_FIELD_SUN_SET_ASTRONOMICAL)) {
+		fields = ((as_fields)1) << AS_FIELD_SUN_SET_SUNSET;
+	}
+	if ((fields & (fields - 1)) != 0) return false;
+	for (int f = 0; f < AS_FIELD_COUNT; f++) {
+		if (fields == ((as_fields)1) << f) *field = (AS_FIELD)f;
+	}
+	return true;
+}
+
+// Returns the setInput() calculation stages required for the fields
+unsigned Astronomy::FieldsCalc(as_fields fields){
+	unsigned calc = AS_CALC_JSON;
+	for (int f = 0; f < AS_FIELD_COUNT; f++) {
+		if (fields & (((as_fields)1) << f)) calc |= m_FieldInfo[f].calc;
+	}
+	return calc;
+}
+
+// Write the JSON result of the selected fields
+void Astronomy::WriteJSON(as_buffer &out){
+	const char *group[2];
+	int depth = 0;
+	bool first = true;
+
+	out.put('{');
+	for (int f = 0; f < AS_FIELD_COUNT; f++) {
+		if (!(m_Fields & (((as_fields)1) << f))) continue;
+		const fieldinfo &info = m_FieldInfo[f];
+
+		// close and open groups
+		int n = 0;
+		while (n < 2 && info.name[n+1] != NULL) n++;
+		int common = 0;
+		while (common < depth && common < n && strcmp(group[common], info.name[common]) == 0) common++;
+		for (; depth > common; depth--) {
+			out.put('}');
+			first = false;
+		}
+		for (; depth < n; depth++) {
+			if (!first) out.put(',');
+			out.put('"');
+			out.put(info.name[depth]);
+			out.put("\":{");
+			group[depth] = info.name[depth];
+			first = true;
+		}
+
+		if (!first) out.put(',');
+		first = false;
+		out.put('"');
+		out.put(info.name[n]);
+		out.put("\":");
+		switch (info.type) {
+			case FT_DATETIME:
+				out.put('"');
+				out.putDigits(m_InDate.year, 4);
+				out.put('-');
+				out.putDigits(m_InDate.month, 2);
+				out.put('-');
+				out.putDigits(m_InDate.day, 2);
+				out.put('T');
+				out.putDigits(m_InTime.hour, 2);
+				out.put(':');
+				out.putDigits(m_InTime.minute, 2);
+				out.put(':');
+				out.putDigits(m_InTime.second, 2);
+				out.put('"');
+				break;
+			case FT_INT:
+				out.putInt((int)(this->*info.value));
+				break;
+			case FT_DOUBLE:
+				out.putNumber(this->*info.value, info.decimals);
+				break;
+			case FT_TIMESPAN:
+				out.put('"');
+				WriteHHMMSS(out, this->*info.time);
+				out.put('"');
+				break;
+			case FT_SUNSIGN:
+				out.put('"');
+				out.put(ZodiacSign[m_Lang][(int)m_SunSign]);
+				out.put('"');
+				break;
+			case FT_MOONSIGN:
+				out.put('"');
+				out.put(ZodiacSign[m_Lang][(int)m_MoonSign]);
+				out.put('"');
+				break;
+			case FT_MOONPHASE_NAME:
+				out.put('"');
+				out.put(lunaphase[m_Lang][(int)m_MoonPhase]);
+				out.put('"');
+				break;
+			case FT_MOONPHASE_VALUE:
+				out.putInt((int)m_MoonPhase);
+				break;
+		}
+	}
+	for (; depth > 0; depth--) {
+		out.put('}');
+	}
+	out.put('}');
+}
+
+// Write the JSON result into buf (size including the terminating NUL),
+// returns false if the buffer is too small
+bool Astronomy::GetJSON(char *buf, unsigned long size, unsigned long *length){
+	as_stats_timer timer;
+	as_buffer out(buf, size - 1);
+	WriteJSON(out);
+	timer.stop(AS_PHASE_JSON);
+	*out.pos = '\0';
+	*length = out.pos - buf;
+	return !out.overflow;
+}
+
+static_assert(sizeof(as_packed) == AS_PACKED_SIZE, "as_packed must not be padded");
+
+static const double as_pow10[] = {1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0};
+
+// Write all values into buf as astro_packed() result (see astro_packed.h),
+// setInput() must have calculated all fields. Returns false if the buffer is too small.
+bool Astronomy::GetPacked(char *buf, unsigned long size, unsigned long *length){
+	unsigned char *out = (unsigned char *)buf;
+	*length = 0;
+	if (size < AS_PACKED_SIZE) return false;
+	memset(out, 0, AS_PACKED_SIZE);
+	out[offsetof(as_packed, version)] = AS_PACKED_VERSION;
+	for (int f = 0; f < AS_FIELD_COUNT; f++) {
+		const fieldinfo &info = m_FieldInfo[f];
+		unsigned char *p = out + info.offset;
+		switch (info.packed) {
+			case PT_DATETIME:
+				as_packed_put16(p, m_InDate.year);
+				p[offsetof(as_packed, month) - offsetof(as_packed, year)] = m_InDate.month;
+				p[offsetof(as_packed, day) - offsetof(as_packed, year)] = m_InDate.day;
+				p[offsetof(as_packed, hour) - offsetof(as_packed, year)] = m_InTime.hour;
+				p[offsetof(as_packed, minute) - offsetof(as_packed, year)] = m_InTime.minute;
+				p[offsetof(as_packed, second) - offsetof(as_packed, year)] = m_InTime.second;
+				break;
+			case PT_UINT8:
+				if (info.type == FT_SUNSIGN) *p = m_SunSign;
+				else if (info.type == FT_MOONSIGN) *p = m_MoonSign;
+				else *p = m_MoonPhase;
+				break;
+			case PT_INT32: {
+				int32_t v = AS_PACKED_NONE;
+				if (info.type == FT_TIMESPAN) {
+					if ((this->*info.time).Seconds != TS_NONE) v = (this->*info.time).Seconds;
+				}
+				else if (!isnan(this->*info.value)) {
+					v = (int32_t)llround(this->*info.value * as_pow10[info.decimals]);
+				}
+				as_packed_put32(p, (uint32_t)v);
+				break;
+			}
+			case PT_DOUBLE:
+				as_packed_put64(p, this->*info.value);
+				break;
+		}
+	}
+	*length = AS_PACKED_SIZE;
+	return true;
+}
+
+// Value of a field of an astro_packed() result: values as in the JSON result,
+// times in seconds of the day, NAN for missing values, 'Time' as YYYYMMDDhhmmss
+// and names as index. Returns false if buf is no result of this version.
+bool Astronomy::Unpack(const char *buf, unsigned long length, AS_FIELD field, double *value){
+	const unsigned char *in = (const unsigned char *)buf;
+	if (length != AS_PACKED_SIZE || in[offsetof(as_packed, version)] != AS_PACKED_VERSION) return false;
+
+	const fieldinfo &info = m_FieldInfo[field];
+	const unsigned char *p = in + info.offset;
+	switch (info.packed) {
+		case PT_DATETIME:
+			*value = as_packed_get16(p);
+			for (size_t i = offsetof(as_packed, month); i <= offsetof(as_packed, second); i++) {
+				*value = *value * 100.0 + in[i];
+			}
+			break;
+		case PT_UINT8:
+			*value = *p;
+			break;
+		case PT_INT32: {
+			int32_t v = (int32_t)as_packed_get32(p);
+			if (v == AS_PACKED_NONE) *value = NAN_DOUBLE;
+			else if (info.type == FT_TIMESPAN) *value = v;
+			else *value = v / as_pow10[info.decimals];
+			break;
+		}
+		case PT_DOUBLE:
+			*value = as_packed_get64(p);
+			break;
+	}
+	return true;
+}
+
+// Write a timespan as 'hh:mm:ss', nothing if there is no valid time
+void Astronomy::WriteHHMMSS(as_buffer &out, const timespan &ts){
+	if (ts.Seconds == TS_NONE) return;
+	out.putDigits(ts.Seconds / 3600, 2);
+	out.put(':');
+	out.putDigits(ts.Seconds / 60 % 60, 2);
+	out.put(':');
+	out.putDigits(ts.Seconds % 60, 2);
+}
+
+
+// Write value zero padded to at least digits digits
+void as_buffer::putDigits(unsigned value, int digits){
+	char buf[12];
+	int n = 0;
+	do {
+		buf[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	while (n < digits && n < (int)sizeof(buf)) buf[n++] = '0';
+	while (n > 0) put(buf[--n]);
+}
+
+void as_buffer::putInt(long long value){
+	unsigned long long u = (unsigned long long)value;
+	if (value < 0) {
+		put('-');
+		u = 0 - u;
+	}
+	char buf[24];
+	int n = 0;
+	do {
+		buf[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+	while (n > 0) put(buf[--n]);
+}
+
+// Write value rounded to decimals (0..9) decimal places without trailing zeros,
+// NaN and infinite values are written as null
+void as_buffer::putNumber(double value, int decimals){
+	static const double scale[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+	if (decimals < 0) decimals = 0;
+	if (decimals > 9) decimals = 9;
+	if (!isfinite(value) || fabs(value) * scale[decimals] >= 9e18) {
+		put("null");
+		return;
+	}
+
+	unsigned long long scaled = (unsigned long long)llround(fabs(value) * scale[decimals]);
+	unsigned long long unit = (unsigned long long)scale[decimals];
+	unsigned long long fraction = scaled % unit;
+	if (value < 0 && scaled != 0) put('-');
+	putInt((long long)(scaled / unit));
+	if (fraction != 0) {
+		// remove trailing zeros
+		while (fraction % 10 == 0) {
+			fraction /= 10;
+			decimals--;
+		}
+		put('.');
+		putDigits((unsigned)fraction, decimals);
+	}
 }
@@ -3,6 +3,28 @@
 #define LIBBUILD                    __DATE__ " " __TIME__
 
 #define MAX_RET_STRLEN              2048    // max string length returned by functions using strings
+#define RISESET_MEMO_SIZE           8       // number of day/location rise/set results kept per statement
+#define EPOCH_MEMO_SIZE             64      // number of instants with geocentric sun/moon positions kept per statement
+#define MAX_SERIES_STRLEN           4194304 // max string length returned by astro_series()
+#define SERIES_THREADS              8       // max number of threads used by one astro_series() call (incl. the caller)
+#define SERIES_CHUNK_SAMPLES        256     // number of samples per astro_series() chunk
+#define MAX_CALENDAR_DAYS           9000    // max number of days of astro_calendar() (all fit into MAX_SERIES_STRLEN)
+
+// Astronomy::setInput() calculation stages
+#define AS_CALC_SUN                 0x01    // sun position
+#define AS_CALC_MOON                0x02    // moon position (requires the sun position)
+#define AS_CALC_SUNRISE             0x04    // sun rise/set and twilights
+#define AS_CALC_MOONRISE            0x08    // moon rise/set
+#define AS_CALC_JSON                0x10    // JSON result string and the values only shown there:
+                                            // right ascensions, signs, distances from the observer
+#define AS_CALC_ALL                 0x1f
+
+#define AS_SUN_EVENTS               4       // sun rise/set, civil, nautical and astronomical twilight
+#define AS_SUN_ALTITUDES_MAX        16      // max number of altitudes of astro_sun_events()
+#define AS_PRECISE_ITERATIONS       8       // max iterations of one rise/set time (AS_PRECISION_PRECISE)
+#define AS_PRECISE_SECONDS          0.1     // step of the iteration (seconds) accepted as converged
+#define AS_PRECISE_MAX_SHIFT        1.0     // max distance (hours) of a refined time from its estimate
+#define AS_MOON_RETARDATION         0.842   // mean daily delay of the moon events (hours, AS_PRECISION_FAST)
 
 //#define DEBUG                       // debug output via syslog
 
@@ -34,13 +56,96 @@ DLLEXP bool astro_info_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
 DLLEXP void astro_info_deinit(UDF_INIT *initid);
 DLLEXP char* astro_info(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error);
 
+DLLEXP bool astro_stats_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_stats_deinit(UDF_INIT *initid);
+DLLEXP char* astro_stats(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error);
+DLLEXP bool astro_stats_reset_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_stats_reset_deinit(UDF_INIT *initid);
+DLLEXP longlong astro_stats_reset(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+DLLEXP bool astro_stats_enable_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_stats_enable_deinit(UDF_INIT *initid);
+DLLEXP longlong astro_stats_enable(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+
 DLLEXP bool astro_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
 DLLEXP void astro_deinit(UDF_INIT *initid);
 DLLEXP char* astro(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error);
+
+DLLEXP bool astro_series_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_series_deinit(UDF_INIT *initid);
+DLLEXP char* astro_series(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error);
+
+DLLEXP bool astro_calendar_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_calendar_deinit(UDF_INIT *initid);
+DLLEXP char* astro_calendar(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error);
+
+DLLEXP bool astro_sun_times_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_sun_times_deinit(UDF_INIT *initid);
+DLLEXP char* astro_sun_times(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error);
+
+DLLEXP bool astro_sun_events_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_sun_events_deinit(UDF_INIT *initid);
+DLLEXP char* astro_sun_events(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error);
+
+DLLEXP bool astro_packed_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_packed_deinit(UDF_INIT *initid);
+DLLEXP char* astro_packed(UDF_INIT *initid, UDF_ARGS *args, char* result, unsigned long* length, char *is_null, char *error);
+
+DLLEXP bool astro_unpack_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+DLLEXP void astro_unpack_deinit(UDF_INIT *initid);
+DLLEXP double astro_unpack(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+
+#define ASTRO_REAL_FUNCTION_DECL(name) \
+DLLEXP bool name##_init(UDF_INIT *initid, UDF_ARGS *args, char *message); \
+DLLEXP void name##_deinit(UDF_INIT *initid); \
+DLLEXP double name(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+
+#define ASTRO_INT_FUNCTION_DECL(name) \
+DLLEXP bool name##_init(UDF_INIT *initid, UDF_ARGS *args, char *message); \
+DLLEXP void name##_deinit(UDF_INIT *initid); \
+DLLEXP longlong name(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+
+ASTRO_REAL_FUNCTION_DECL(astro_sun_distance)
+ASTRO_REAL_FUNCTION_DECL(astro_sun_ecliptic)
+ASTRO_REAL_FUNCTION_DECL(astro_sun_declination)
+ASTRO_REAL_FUNCTION_DECL(astro_sun_azimuth)
+ASTRO_REAL_FUNCTION_DECL(astro_sun_altitude)
+ASTRO_REAL_FUNCTION_DECL(astro_sun_diameter)
+ASTRO_INT_FUNCTION_DECL(astro_sun_astronomical_dawn_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_sun_nautical_dawn_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_sun_civil_dawn_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_sun_rise_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_sun_transit_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_sun_set_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_sun_civil_dusk_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_sun_nautical_dusk_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_sun_astronomical_dusk_seconds)
+ASTRO_REAL_FUNCTION_DECL(astro_moon_distance)
+ASTRO_REAL_FUNCTION_DECL(astro_moon_declination)
+ASTRO_REAL_FUNCTION_DECL(astro_moon_azimuth)
+ASTRO_REAL_FUNCTION_DECL(astro_moon_altitude)
+ASTRO_REAL_FUNCTION_DECL(astro_moon_diameter)
+ASTRO_REAL_FUNCTION_DECL(astro_moon_phase_number)
+ASTRO_REAL_FUNCTION_DECL(astro_moon_age)
+ASTRO_INT_FUNCTION_DECL(astro_moon_phase)
+ASTRO_INT_FUNCTION_DECL(astro_moon_rise_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_moon_transit_seconds)
+ASTRO_INT_FUNCTION_DECL(astro_moon_set_seconds)
+
+#define ASTRO_AGGREGATE_FUNCTION_DECL(name) \
+DLLEXP bool name##_init(UDF_INIT *initid, UDF_ARGS *args, char *message); \
+DLLEXP void name##_deinit(UDF_INIT *initid); \
+DLLEXP void name##_clear(UDF_INIT *initid, char *is_null, char *error); \
+DLLEXP void name##_add(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error); \
+DLLEXP double name(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+
+ASTRO_AGGREGATE_FUNCTION_DECL(astro_daylight_hours_sum)
+ASTRO_AGGREGATE_FUNCTION_DECL(astro_moon_visible_hours_sum)
+ASTRO_AGGREGATE_FUNCTION_DECL(astro_twilight_minutes_avg)
 }
 
 
 #include <string>
+#include <vector>
 #include <math.h>
 
 
@@ -56,12 +161,142 @@ struct as_time {
 	uint8_t second;
 };
 
+// Language of names in results
+enum AS_LANG {
+	AS_LANG_EN,     // English
+	AS_LANG_DE,     // German
+	AS_LANG_ES,     // Spanish
+	AS_LANG_FR,     // French
+	AS_LANG_IT,     // Italian
+	AS_LANG_NL,     // Dutch
+	AS_LANG_COUNT
+};
+
+// Default language, set at compile time using LANG=-DLANG_xx
+#if defined LANG_DE
+#define AS_LANG_DEFAULT             AS_LANG_DE
+#elif defined LANG_ES
+#define AS_LANG_DEFAULT             AS_LANG_ES
+#elif defined LANG_FR
+#define AS_LANG_DEFAULT             AS_LANG_FR
+#elif defined LANG_IT
+#define AS_LANG_DEFAULT             AS_LANG_IT
+#elif defined LANG_NL
+#define AS_LANG_DEFAULT             AS_LANG_NL
+#else	// LANG_xx
+#define AS_LANG_DEFAULT             AS_LANG_EN
+#endif	// LANG_xx
+
+// Precision of rise/set times, selected per call (see Astronomy::CalcSunRise()).
+// Errors are the 99th percentile against the exact altitude crossings over a global
+// grid (make precision-check), costs relative to the standard tier (make bench).
+enum AS_PRECISION {
+	AS_PRECISION_FAST,          // one sun position per day, neighbouring days estimated:
+	                            // sun 3.5 min, moon 17 min, cost sun 0.6, moon 0.65
+	AS_PRECISION_STANDARD,      // positions of the day interpolated once (default):
+	                            // sun 22 s, moon 5 min
+	AS_PRECISION_PRECISE,       // standard times iterated on position and altitude:
+	                            // below 1 s, cost sun 4.3, moon 3.8
+	AS_PRECISION_COUNT
+};
+
+// Trigonometry of the engine, selected per call. AS_MATH_FAST uses the short
+// minimax polynomials of astro_math.h instead of libm: positions change by
+// less than 5e-8 rad (1e-6 rad for altitudes near the zenith/nadir) and
+// rise/set times by less than 0.01 s (make fastmath-check), setInput() costs
+// 0.85, MoonPosition() 0.8 of libm (make bench).
+enum AS_MATH {
+	AS_MATH_LIBM,               // libm (default)
+	AS_MATH_FAST,               // minimax polynomials
+	AS_MATH_COUNT
+};
+
+// Default trigonometry, set at compile time using MATH=-DASTRO_FAST_MATH
+#ifdef ASTRO_FAST_MATH
+#define AS_MATH_DEFAULT             AS_MATH_FAST
+#else	// ASTRO_FAST_MATH
+#define AS_MATH_DEFAULT             AS_MATH_LIBM
+#endif	// ASTRO_FAST_MATH
+
 struct as_date {
 	uint8_t  day;
 	uint8_t  month;
 	uint16_t year;
 };
 
+// JSON result fields (in output order)
+enum AS_FIELD {
+	AS_FIELD_TIME,
+	AS_FIELD_ZONE,
+	AS_FIELD_LATITUDE,
+	AS_FIELD_LONGITUDE,
+	AS_FIELD_DELTAT,
+	AS_FIELD_JULIANDATE,
+	AS_FIELD_GMST,
+	AS_FIELD_LMST,
+	AS_FIELD_SUN_DISTANCE_EARTH,
+	AS_FIELD_SUN_DISTANCE_OBSERVER,
+	AS_FIELD_SUN_ECLIPTIC,
+	AS_FIELD_SUN_DECLINATION,
+	AS_FIELD_SUN_AZIMUTH,
+	AS_FIELD_SUN_HEIGHT,
+	AS_FIELD_SUN_DIAMETER,
+	AS_FIELD_SUN_RISE_ASTRONOMICAL,
+	AS_FIELD_SUN_RISE_NAUTICAL,
+	AS_FIELD_SUN_RISE_CIVIL,
+	AS_FIELD_SUN_RISE_SUNRISE,
+	AS_FIELD_SUN_CULMINATION,
+	AS_FIELD_SUN_SET_SUNSET,
+	AS_FIELD_SUN_SET_CIVIL,
+	AS_FIELD_SUN_SET_NAUTICAL,
+	AS_FIELD_SUN_SET_ASTRONOMICAL,
+	AS_FIELD_SUN_ASCENSION,
+	AS_FIELD_SUN_ZODIAC,
+	AS_FIELD_MOON_DISTANCE_EARTH,
+	AS_FIELD_MOON_DISTANCE_OBSERVER,
+	AS_FIELD_MOON_ECLIPTIC_LATITUDE,
+	AS_FIELD_MOON_ECLIPTIC_LONGITUDE,
+	AS_FIELD_MOON_DECLINATION,
+	AS_FIELD_MOON_AZIMUTH,
+	AS_FIELD_MOON_HEIGHT,
+	AS_FIELD_MOON_DIAMETER,
+	AS_FIELD_MOON_RISE,
+	AS_FIELD_MOON_CULMINATION,
+	AS_FIELD_MOON_SET,
+	AS_FIELD_MOON_ASCENSION,
+	AS_FIELD_MOON_PHASE_NAME,
+	AS_FIELD_MOON_PHASE_VALUE,
+	AS_FIELD_MOON_PHASE_NUMBER,
+	AS_FIELD_MOON_AGE,
+	AS_FIELD_MOON_SIGN,
+	AS_FIELD_COUNT
+};
+
+// bitset of AS_FIELD
+typedef uint64_t as_fields;
+#define AS_FIELDS_ALL               ((((as_fields)1) << AS_FIELD_COUNT) - 1)
+#define AS_FIELDS_RANGE(first, last) ((((as_fields)1) << ((last) + 1)) - (((as_fields)1) << (first)))
+#define AS_FIELDS_SUN_TIMES         AS_FIELDS_RANGE(AS_FIELD_SUN_RISE_ASTRONOMICAL, AS_FIELD_SUN_SET_ASTRONOMICAL)
+#define AS_FIELDS_CALENDAR          ((((as_fields)1) << AS_FIELD_TIME) | AS_FIELDS_SUN_TIMES \
+                                     | AS_FIELDS_RANGE(AS_FIELD_MOON_RISE, AS_FIELD_MOON_SET) \
+                                     | AS_FIELDS_RANGE(AS_FIELD_MOON_PHASE_NAME, AS_FIELD_MOON_AGE))
+
+// Writes into a fixed size buffer without allocations, an overflow is flagged instead of written
+struct as_buffer {
+	char *pos;
+	char *end;
+	bool overflow;
+
+	as_buffer(char *buf, unsigned long size) : pos(buf), end(buf + size), overflow(false) {}
+	inline void put(char c) {if (pos < end) *pos++ = c; else overflow = true;}
+	inline void put(const char *str) {while (*str) put(*str++);}
+	void putDigits(unsigned value, int digits);
+	void putInt(long long value);
+	void putNumber(double value, int decimals);
+};
+
+struct as_cache_riseset;
+
 class Astronomy {
 #define NAN_DOUBLE NAN
 // std::numeric_limits<double>::quiet_NaN()
@@ -69,8 +304,8 @@ class Astronomy {
 // std::numeric_limits<int>::quiet_NaN()
 
 private:
-	const double DEG=(M_PI/180.0);
-	const double RAD=(180.0/M_PI);
+	static constexpr double DEG=(M_PI/180.0);
+	static constexpr double RAD=(180.0/M_PI);
 
 
 	struct coor{
@@ -107,17 +342,27 @@ private:
 		double astronomicalTwilightMorning;
 		double astronomicalTwilightEvening;
 	};
-	coor observerCart, sunCoor, moonCoor, sunCart, sunRise, moonCart, moonRise;
+	coor sunRise, moonRise;
+
+	// Values of the observer location independent of the time, calculated once by
+	// setLocation() instead of within every setInput()
+	struct observer{
+		double lon;             // geodetic longitude, radians
+		double lat;             // geodetic latitude, radians
+		double lonHours;        // longitude in hours (LMST - GMST)
+		double sinLat;
+		double cosLat;
+		bool geocentric;        // radius, geoLat and x/y/z are valid (see ObserverGeocentric())
+		double radius;          // geocentric distance, km
+		double geoLat;          // geocentric latitude, radians
+		double x, y, z;         // geocentric cartesian coordinates with regard to Greenwich
+	};
 
+	// time of day, formatted only when written
 	struct timespan{
-		uint32_t Hour;
-		uint32_t Minute;
-		uint32_t Second;
-		std::string HHMMSS;
-		double TotalHour;
-		double TotalMinute;
-		double TotalSecond;
+		int32_t Seconds;        // seconds of the day, TS_NONE if there is no such time
 	};
+	static constexpr int32_t TS_NONE=-1;
 
 	enum SIGN
 	{
@@ -135,145 +380,11 @@ private:
 		SIGN_PISCES			//!< Fische
 	};
 
-	std::string ZodiacSign[12] {
-#if defined LANG_DE
-		"Widder",
-		"Stier",
-		"Zwillinge",
-		"Krebs",
-		"Löwe",
-		"Jungfrau",
-		"Waage",
-		"Skorpion",
-		"Schütze",
-		"Steinbock",
-		"Wassermann",
-		"Fische"
-#elif defined LANG_ES
-		"Aries",
-		"Tauro",
-		"Géminis",
-		"Cáncer",
-		"Leo",
-		"Virgo",
-		"Libra",
-		"Escorpio",
-		"Sagitario",
-		"Capricornio",
-		"Acuario",
-		"Piscis"
-#elif defined LANG_FR
-		"Bélier",
-		"Taureau",
-		"Gémeaux",
-		"Cancer",
-		"Lion",
-		"Vierge",
-		"Balance",
-		"Scorpion",
-		"Sagittaire",
-		"Capricorne",
-		"Verseau",
-		"Poissons"
-#elif defined LANG_IT
-		"Ariete",
-		"Toro",
-		"Gemelli",
-		"Cancro",
-		"Leone",
-		"Vergine",
-		"Bilancia",
-		"Scorpione",
-		"Sagittario",
-		"Capricorno",
-		"Aquario",
-		"Pesci"
-#elif defined LANG_NL
-		"Ram",
-		"Stier",
-		"Tweelingen",
-		"Kreeft",
-		"Leeuw",
-		"Maagd",
-		"Weegschaal",
-		"Schorpioen",
-		"Boogschutter",
-		"Steenbok",
-		"Waterman",
-		"Vissen"
-#else	// LANG_xx
-		"Aries",
-		"Taurus",
-		"Gemini",
-		"Cancer",
-		"Leo",
-		"Virgo",
-		"Libra",
-		"Scorpio",
-		"Sagittarius",
-		"Capricorn",
-		"Aquarius",
-		"Pisces"
-#endif	// LANG_xx
-		};
-
-	std::string lunaphase[8] {
-#if defined LANG_DE
-		"Neumond",
-		"Zunehmende Sichel",
-		"Erstes Viertel",
-		"Zunehmender Mond",
-		"Vollmond",
-		"Abnehmender Mond",
-		"Letztes Viertel",
-		"Abnehmende Sichel"
-#elif defined LANG_ES
-		"Luna nueva",
-		"Luna creciente",
-		"Cuarto creciente",
-		"Luna gibosa creciente",
-		"Luna llena",
-		"Luna gibosa menguante",
-		"Cuarto menguante",
-		"Luna menguante"
-#elif defined LANG_FR
-		"Nouvelle lune",
-		"Premier croissant ou lune croissante",
-		"Premier quartier",
-		"Lune gibbeuse croissante",
-		"Pleine lune",
-		"Lune gibbeuse décroissante",
-		"Dernier quartier",
-		"Dernier croissant ou lune décroissante"
-#elif defined LANG_IT
-		"Luna nuova",
-		"Luna crescente crescente",
-		"Primo quarto",
-		"Luna crescente",
-		"Luna piena",
-		"Luna calante",
-		"Ultimo quarto",
-		"Luna crescente calante"
-#elif defined LANG_NL
-		"Nieuwe maan",
-		"Wassende",
-		"Eerste kwartier",
-		"Wassende maan",
-		"Volle maan",
-		"Krimpende of afnemende maan",
-		"Laatste kwartier",
-		"Krimpende"
-#else	// LANG_xx
-		"New Moon",
-		"Waxing crescent",
-		"First quarter",
-		"Waxing gibbous",
-		"Full Moon",
-		"Waning gibbous",
-		"Third quarter",
-		"Waning crescent"
-#endif	// LANG_xx
-		};
+	static const char *const ZodiacSign[AS_LANG_COUNT][12];
+	static const char *const lunaphase[AS_LANG_COUNT][8];
+	static const char *const LanguageCode[AS_LANG_COUNT];
+	static const char *const PrecisionName[AS_PRECISION_COUNT];
+	static const char *const MathName[AS_MATH_COUNT];
 
 
 	enum LUNARPHASE
@@ -291,6 +402,7 @@ private:
 	double m_Lat=0;
 	double m_Lon=0;
 	double m_Zone=0;
+	observer m_Observer;
 	double m_DeltaT=0;
 	double m_JD=0;
 	double m_SunLon=0;
@@ -310,13 +422,8 @@ private:
 	double m_MoonDiameter=0;
 	double m_MoonPhaseNumber=0;
 	double m_MoonAge=0;
-	double m_dv=0;
-	uint32_t m_hh=0;
-	uint32_t m_mm=0;
-	uint32_t m_ss=0;
-	std::string m_os;
-	std::string m_Date="";
-	std::string m_Time="";
+	as_date m_InDate={1, 1, 1970};
+	as_time m_InTime={0, 0, 0};
 	LUNARPHASE m_MoonPhase=LP_NEW_MOON;
 	SIGN m_MoonSign=SIGN_ARIES;
 	SIGN m_SunSign=SIGN_ARIES;
@@ -335,15 +442,76 @@ private:
 
 
 public:
+	// Rise/set results only depend on date, location and zone, not on the time of day.
+	// A memo can be attached to share them between calls (e.g. rows of one statement).
+	struct riseset_memo {
+		struct {
+			unsigned calc;      // AS_CALC_SUNRISE and/or AS_CALC_MOONRISE if valid
+			double JD0;
+			double lon;
+			double lat;
+			double zone;
+			coor sunRise;
+			coor moonRise;
+		} entry[RISESET_MEMO_SIZE];
+		unsigned next;
+		unsigned long hits;
+		unsigned long misses;
+	};
+
+	// Rise/set results of consecutive local days, calculated by CalcRiseSetDays() of the
+	// same location and zone. The sun positions at the day boundaries are shared by the
+	// neighbouring days instead of being calculated again for every day.
+	struct riseset_days {
+		double JD0;         // first local day
+		unsigned calc;      // AS_CALC_SUNRISE and/or AS_CALC_MOONRISE
+		std::vector<coor> sunRise;
+		std::vector<coor> moonRise;
+	};
 
-	Astronomy(as_geo, int8_t deltaT=65);
+	// Geocentric sun and moon positions only depend on the instant (TDT), not on the observer.
+	// A memo can be attached to share them between calls at the same instant (e.g. rows of one
+	// statement for many sites), the entry of an instant is selected by a hash of its TDT.
+	struct epoch_memo {
+		struct {
+			unsigned calc;      // AS_CALC_SUN and/or AS_CALC_MOON if valid
+			double TDT;
+			coor sun;
+			coor moon;
+		} entry[EPOCH_MEMO_SIZE];
+		unsigned long hits;
+		unsigned long misses;
+	};
+
+	Astronomy(as_geo geo={0.0, 0.0, 0}, int8_t deltaT=65);
 	~Astronomy();
-	void setInput(as_date, as_time);
-	std::string GetAll() {return m_os;}
+	void setLocation(as_geo geo);
+	static bool ParseFields(const char *str, unsigned long length, as_fields *fields);
+	static bool ParseField(const char *str, unsigned long length, AS_FIELD *field);
+	static unsigned FieldsCalc(as_fields fields);
+	static bool ParseLanguage(const char *str, unsigned long length, AS_LANG *lang);
+	static bool ParsePrecision(const char *str, unsigned long length, AS_PRECISION *precision);
+	static bool ParseMath(const char *str, unsigned long length, AS_MATH *math);
+	void setMemo(riseset_memo *memo) {m_Memo = memo;}
+	void setEpochMemo(epoch_memo *memo) {m_EpochMemo = memo;}
+	void setDays(const riseset_days *days) {m_Days = days;}
+	void CalcRiseSetDays(as_date first, unsigned count, unsigned calc, riseset_days *days);
+	void setFields(as_fields fields) {m_Fields = fields;}
+	void setLanguage(AS_LANG lang) {m_Lang = lang;}
+	void setGrid(bool grid) {m_Grid = grid;}
+	void setPrecision(AS_PRECISION precision) {m_Precision = precision;}
+	void setMath(AS_MATH math);
+	void setInput(as_date, as_time, unsigned calc=AS_CALC_ALL);
+	// Same with the stages fixed at compile time, unused stages are compiled out.
+	// CALC must contain the stages of the JSON fields if AS_CALC_JSON is set.
+	template<unsigned CALC> void setInput(as_date, as_time);
+	bool GetJSON(char *buf, unsigned long size, unsigned long *length);
+	bool GetPacked(char *buf, unsigned long size, unsigned long *length);
+	static bool Unpack(const char *buf, unsigned long length, AS_FIELD field, double *value);
+	void CalcSunEvents(as_date d, const double *altitudes, int count, double *morning, double *evening);
+	bool GetSunEventsJSON(as_date d, const double *altitudes, int count, char *buf, unsigned long size, unsigned long *length);
 	double GetLat() {return m_Lat;}
 	double GetLon() {return m_Lon;}
-	std::string GetDate() {return m_Date;}
-	std::string GetTime() {return m_Time;}
 	double GetJD() {return m_JD;}
 	double GetZone() {return m_Zone;}
 	double GetDeltaT() {return m_DeltaT;}
@@ -363,58 +531,114 @@ public:
 	double GetMoonAlt() {return m_MoonAlt;}
 	double GetMoonDiameter() {return m_MoonDiameter;}
 	double GetMoonPhaseNumber() {return m_MoonPhaseNumber;}
+	int GetMoonPhaseValue() {return (int)m_MoonPhase;}
 	double GetMoonAge() {return m_MoonAge;}
-	double GetSunAstronomicalTwilightMorning() { return m_SunAstronomicalTwilightMorning.TotalHour;}
-	double GetSunNauticalTwilightMorning() { return m_SunNauticalTwilightMorning.TotalHour;}
-	double GetSunCivilTwilightMorning() { return m_SunCivilTwilightMorning.TotalHour;}
-	double GetSunRise() { return m_SunRise.TotalHour;}
-	double GetSunTransit() { return m_SunTransit.TotalHour;}
-	double GetSunSet() { return m_SunSet.TotalHour;}
-	double GetSunCivilTwilightEvening() { return m_SunCivilTwilightEvening.TotalHour;}
-	double GetSunNauticalTwilightEvening() { return m_SunNauticalTwilightEvening.TotalHour;}
-	double GetSunAstronomicalTwilightEvening() { return m_SunAstronomicalTwilightEvening.TotalHour;}
-	double GetMoonRA() { return m_MoonRA.TotalHour;}
-	double GetMoonRise() { return m_MoonRise.TotalHour;}
-	double GetMoonTransit() { return m_MoonTransit.TotalHour;}
-	double GetMoonSet() { return m_MoonSet.TotalHour;}
-	std::string GetSunAstronomicalTwilightMorning_s() {return m_SunAstronomicalTwilightMorning.HHMMSS;}
-	std::string GetSunNauticalTwilightMorning_s() {return m_SunNauticalTwilightMorning.HHMMSS;}
-	std::string GetSunCivilTwilightMorning_s() {return m_SunCivilTwilightMorning.HHMMSS;}
-	std::string GetSunRise_s() {return m_SunRise.HHMMSS;}
-	std::string GetSunTransit_s() {return m_SunTransit.HHMMSS;}
-	std::string GetSunSet_s() {return m_SunSet.HHMMSS;}
-	std::string GetSunCivilTwilightEvening_s() {return m_SunCivilTwilightEvening.HHMMSS;}
-	std::string GetSunNauticalTwilightEvening_s() {return m_SunNauticalTwilightEvening.HHMMSS;}
-	std::string GetSunAstronomicalTwilightEvening_s() {return m_SunAstronomicalTwilightEvening.HHMMSS;}
-	std::string GetMoonRA_s() {return m_MoonRA.HHMMSS;}
-	std::string GetMoonRise_s() {return m_MoonRise.HHMMSS;}
-	std::string GetMoonTransit_s() {return m_MoonTransit.HHMMSS;}
-	std::string GetMoonSet_s() {return m_MoonSet.HHMMSS;}
-	std::string GetMoonPhase() {return lunaphase[(int)m_MoonPhase];}
-	std::string GetMoonSign() {return ZodiacSign[(int)m_MoonSign];}
-	std::string GetSunSign() {return ZodiacSign[(int)m_SunSign];}
+	double GetSunAstronomicalTwilightMorning() { return Hours(m_SunAstronomicalTwilightMorning);}
+	double GetSunNauticalTwilightMorning() { return Hours(m_SunNauticalTwilightMorning);}
+	double GetSunCivilTwilightMorning() { return Hours(m_SunCivilTwilightMorning);}
+	double GetSunRise() { return Hours(m_SunRise);}
+	double GetSunTransit() { return Hours(m_SunTransit);}
+	double GetSunSet() { return Hours(m_SunSet);}
+	double GetSunCivilTwilightEvening() { return Hours(m_SunCivilTwilightEvening);}
+	double GetSunNauticalTwilightEvening() { return Hours(m_SunNauticalTwilightEvening);}
+	double GetSunAstronomicalTwilightEvening() { return Hours(m_SunAstronomicalTwilightEvening);}
+	double GetMoonRA() { return Hours(m_MoonRA);}
+	double GetMoonRise() { return Hours(m_MoonRise);}
+	double GetMoonTransit() { return Hours(m_MoonTransit);}
+	double GetMoonSet() { return Hours(m_MoonSet);}
+	const char *GetMoonPhase() {return lunaphase[m_Lang][(int)m_MoonPhase];}
+	const char *GetMoonSign() {return ZodiacSign[m_Lang][(int)m_MoonSign];}
+	const char *GetSunSign() {return ZodiacSign[m_Lang][(int)m_SunSign];}
 
 private:
+	riseset_memo *m_Memo=NULL;
+	epoch_memo *m_EpochMemo=NULL;
+	const riseset_days *m_Days=NULL;
+	as_fields m_Fields=AS_FIELDS_ALL;
+	AS_LANG m_Lang=AS_LANG_DEFAULT;
+	bool m_Grid=false;              // sun rise/set from the rise/set grid if possible
+	AS_PRECISION m_Precision=AS_PRECISION_STANDARD;
+	AS_MATH m_Math=AS_MATH_DEFAULT;
+
+	// JSON result field description
+	enum FIELDTYPE {
+		FT_DATETIME,
+		FT_INT,
+		FT_DOUBLE,
+		FT_TIMESPAN,
+		FT_SUNSIGN,
+		FT_MOONSIGN,
+		FT_MOONPHASE_NAME,
+		FT_MOONPHASE_VALUE
+	};
+	enum PACKEDTYPE {                   // value in the astro_packed() result (see astro_packed.h)
+		PT_DATETIME,                    // year, month, day, hour, minute, second
+		PT_UINT8,                       // index
+		PT_INT32,                       // value * 10^decimals
+		PT_DOUBLE
+	};
+	struct fieldinfo {
+		const char *name[3];            // group(s) and key, unused trailing names are NULL
+		unsigned calc;                  // required setInput() calculation stages
+		FIELDTYPE type;
+		int decimals;                   // FT_DOUBLE
+		double Astronomy::*value;       // FT_INT, FT_DOUBLE
+		timespan Astronomy::*time;      // FT_TIMESPAN
+		PACKEDTYPE packed;
+		size_t offset;                  // offset in the astro_packed() result
+	};
+	static const fieldinfo m_FieldInfo[AS_FIELD_COUNT];
 
+	void WriteJSON(as_buffer &out);
+	static void WriteHHMMSS(as_buffer &out, const timespan &ts);
 
 protected:
+	// trigonometry as selected by setMath()
+	double Sin(double x);
+	double Cos(double x);
+	double Tan(double x);
+	double Atan2(double y, double x);
+	double Asin(double x);
+	double Acos(double x);
 	double CalcJD(int day, int month, int year); // Calculate Julian date: valid only from 1.3.1901 to 28.2.2100
 	double CalcGMST(double JD);
 	double GMST2LMST(double gmst, double lon);
+	double GMST2LMST(double gmst, const observer &obs) {return Mod(gmst + obs.lonHours, 24.0);}
 	double Refraction(double alt);
 	double GMST2UT(double JD, double gmst);
 	double InterpolateGMST(double gmst0, double gmst1, double gmst2, double timefactor);
 	coor EquPolar2Cart(double lon, double lat, double distance);
-	coor Observer2EquCart(double lon, double lat, double height, double gmst);
-	coor SunPosition(double TDT, double geolat = NAN_DOUBLE, double lmst = NAN_DOUBLE);
-	coor Equ2Altaz(coor co, double TDT, double geolat, double lmst);
+	observer Observer(double lon, double lat);
+	void ObserverGeocentric(observer *obs);
+	coor Observer2EquCart(const observer &obs, double gmst);
+	void SunOrbit(double TDT, double *lon, double *distance);
+	void MoonOrbit(coor sunCoor, double TDT, double *lon, double *lat, double *orbitLon, double *distance);
+	coor SunPosition(double TDT, const observer *obs = NULL, double lmst = NAN_DOUBLE);
+	coor Equ2Altaz(coor co, double TDT, const observer &obs, double lmst);
 	coor Ecl2Equ(coor co, double TDT);
-	coor MoonPosition(coor sunCoor, double TDT, coor observer=coor(), double lmst=NAN_DOUBLE);
-	coor GeoEqu2TopoEqu(coor co, coor observer, double lmst);
-	coor RiseSet(double jd0UT, coor coor1, coor coor2, double lon, double lat, double timeinterval, double naltitude = NAN_DOUBLE);
-	coor GMSTRiseSet(coor co, double lon, double lat, double hn = NAN_DOUBLE);
-	coor CalcSunRise(double JD, double deltaT, double lon, double lat, int zone, bool recursive);
-	coor CalcMoonRise(double JD, double deltaT, double lon, double lat, int zone, bool recursive);
+	coor MoonPosition(coor sunCoor, double TDT, const observer *obs = NULL, double lmst=NAN_DOUBLE);
+	coor MoonGeocentric(coor sunCoor, double TDT);
+	coor MoonTopocentric(coor moonCoor, double TDT, const observer &obs, double lmst);
+	coor EpochPosition(double TDT, const coor *sunCoor = NULL);
+	coor GeoEqu2TopoEqu(coor co, const observer &obs, double lmst);
+	coor RiseSet(double jd0UT, coor coor1, coor coor2, const observer &obs, double timeinterval, double naltitude = NAN_DOUBLE);
+	void RiseSetMulti(double jd0UT, const coor &coor1, const coor &coor2, const observer &obs, double timeinterval, const double *naltitudes, int count, coor *rise);
+	coor CalcSunRise(double JD, double deltaT, const observer &obs, int zone, bool recursive);
+	double RefineEvent(double jd0UT, double deltaT, const observer &obs, bool moon, int event, double naltitude, double t);
+	void RefineRiseSet(double jd0UT, double deltaT, const observer &obs, bool moon, double naltitude, coor *rise);
+	coor CalcMoonRise(double JD, double deltaT, const observer &obs, int zone, bool recursive);
+	int SunRiseOtherDay(const coor &rise, int zone);
+	void SunEventsUTC(double jd0UT, const coor &coor1, const coor &coor2, const observer &obs, coor *events);
+	coor SunRiseLocal(const coor *events, const coor &risetemp, int zone);
+	int MoonRiseOtherDay(const coor &rise, int zone);
+	coor MoonRiseLocal(coor rise, const coor &risetemp, int zone);
+	void CalcSunRiseUTC(double jd0UT, double deltaT, const observer &obs, double *events);
+	bool GridSunRise(double JD0, double lon, double lat, int zone, coor *rise);
+	coor SunRise(double JD0, const observer &obs);
+	static void ToCache(const coor &rise, as_cache_riseset *cached);
+	static void FromCache(const as_cache_riseset &cached, coor *rise);
+	void SharedRiseSet(double JD0, const observer &obs, unsigned calc, coor *sun, coor *moon);
+	void CalcRiseSet(double JD0, const observer &obs, unsigned calc);
 	SIGN Sign(double lon);
 	inline int Int(double x) {return (x < 0) ? (int)ceil(x) : (int)floor(x);}
 	inline double frac(double x) {return (x - floor(x));}
@@ -425,7 +649,8 @@ protected:
 	inline double round1000(double x) {return (roundl(1000.0 * x) / 1000.0);}
 	inline double round10000(double x) {return (roundl(10000.0 * x) / 10000.0);}
 	inline double round100000(double x) {return (roundl(100000.0 * x) / 100000.0);}
-	timespan TimeSpan(double tdiff);
+	static timespan TimeSpan(double tdiff);
+	static double Hours(const timespan &ts);
 
 
 };
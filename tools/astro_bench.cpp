@@ -0,0 +1,428 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Microbenchmarks of the Astronomy engine
+//
+//   astro_bench [NAME...]      run all (or the named) benchmarks
+//
+// Every benchmark runs over a fixed grid of dates, latitudes (including the
+// polar regions) and time zones. Each input is timed over BENCH_REPEAT calls;
+// the results are written as one JSON object per line:
+//
+//   {"bench":"setInput","inputs":1296,"ops":124416,"ns_per_op":1234.5,
+//    "p50":1200.1,"p90":1500.2,"p99":2100.3,"allocs_per_op":0.00,
+//    "ephemeris":false,"grid":false}
+//
+// ns_per_op is the mean, pXX the percentiles over the inputs and
+// allocs_per_op the heap allocations (operator new) per call. The batch
+// benchmarks calculate BENCH_BATCH epochs per call and report per epoch.
+// The UDF benchmarks (astroRow, astroRowEpoch, astroSiteRow, astroSunAltitudeRow)
+// call the row function of a statement prepared once by its xxx_init(), like the
+// server does; astroRowEpoch passes the date as INTEGER epoch instead of a string,
+// astroSiteRow uses one statement per input with a constant location.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <mysql.h>
+#include <new>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "lib_mysqludf_astro.h"
+#include "astro_ephem.h"
+#include "astro_grid.h"
+#include "astro_batch.h"
+
+#define BENCH_REPEAT        32      // calls per input and timing
+#define BENCH_ROUNDS        3       // timings per input, the fastest is used
+#define BENCH_BATCH         64      // epochs per call of the batch benchmarks
+
+// Heap allocations of the benchmarked code, counted by the replaced operator new
+static unsigned long s_Allocs = 0;
+
+void *operator new(size_t size)
+{
+	s_Allocs++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	s_Allocs++;
+	return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	free(p);
+}
+
+struct BenchInput {
+	as_date date;
+	as_time time;
+	as_geo geo;
+};
+
+// Access to the stages of the engine
+class BenchModel : public Astronomy {
+public:
+	BenchModel(as_geo geo, AS_PRECISION precision = AS_PRECISION_STANDARD, AS_MATH math = AS_MATH_DEFAULT) : Astronomy(geo) {
+		setPrecision(precision);
+		setMath(math);
+	}
+
+	double JD0(as_date d) {return CalcJD(d.day, d.month, d.year);}
+	double TDT(as_date d, as_time t) {
+		return JD0(d) + (t.hour - GetZone() + t.minute / 60.0 + t.second / 3600.0) / 24.0 + GetDeltaT() / 24.0 / 3600.0;
+	}
+	double Sun(double TDT) {
+		return SunPosition(TDT).ra;
+	}
+	double Moon(double TDT) {
+		return MoonPosition(SunPosition(TDT), TDT).ra;
+	}
+	double SunRise(double JD0) {
+		return CalcSunRise(JD0, GetDeltaT(), Observer(GetLon() * M_PI / 180.0, GetLat() * M_PI / 180.0), GetZone(), false).rise;
+	}
+	double MoonRise(double JD0) {
+		return CalcMoonRise(JD0, GetDeltaT(), Observer(GetLon() * M_PI / 180.0, GetLat() * M_PI / 180.0), GetZone(), false).rise;
+	}
+	double Span(double hours) {
+		return Hours(TimeSpan(hours));
+	}
+};
+
+static volatile double s_Sink;
+
+// Fixed input grid: dates over two centuries and all seasons, latitudes from
+// pole to pole, time zones around the world
+static std::vector<BenchInput> Inputs()
+{
+	static const as_date dates[] = {
+		{1, 1, 1901}, {21, 3, 1950}, {21, 6, 1999}, {29, 2, 2000},
+		{23, 9, 2023}, {21, 12, 2023}, {18, 1, 2023}, {31, 12, 2099},
+	};
+	static const as_time times[] = {{0, 0, 0}, {9, 30, 15}, {23, 59, 59}};
+	static const double lats[] = {-89.5, -70.5, -33.86, 0.0, 40.7, 53.18, 69.65, 78.2, 89.5};
+	static const double lons[] = {-179.5, -74.0, 4.85, 151.2};
+	static const int zones[] = {-11, -5, 0, 1, 5, 10};
+
+	std::vector<BenchInput> inputs;
+	for (auto &d : dates)
+		for (auto &t : times)
+			for (size_t i = 0; i < sizeof(lats) / sizeof(lats[0]); i++)
+				for (int z : zones)
+					inputs.push_back(BenchInput{d, t, as_geo{lons[i % 4], lats[i], z}});
+	return inputs;
+}
+
+// per: epochs calculated by one call of op
+static void Run(const char *name, const std::vector<BenchInput> &inputs, const std::function<double(const BenchInput &)> &op, int per = 1)
+{
+	std::vector<double> ns(inputs.size());
+	unsigned long allocs = 0;
+	double total = 0.0;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		double best = HUGE_VAL;
+		for (int r = 0; r < BENCH_ROUNDS; r++) {
+			unsigned long a = s_Allocs;
+			auto t0 = std::chrono::steady_clock::now();
+			for (int k = 0; k < BENCH_REPEAT; k++) s_Sink = op(inputs[i]);
+			auto t1 = std::chrono::steady_clock::now();
+			if (r == 0) allocs += s_Allocs - a;
+			best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_REPEAT / per);
+		}
+		ns[i] = best;
+		total += best;
+	}
+	std::sort(ns.begin(), ns.end());
+	auto pct = [&ns](double p) {return ns[(size_t)(p * (ns.size() - 1) + 0.5)];};
+	printf("{\"bench\":\"%s\",\"inputs\":%zu,\"ops\":%zu,\"ns_per_op\":%.1f,"
+	       "\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"allocs_per_op\":%.2f,"
+	       "\"ephemeris\":%s,\"grid\":%s}\n",
+	       name, inputs.size(), inputs.size() * BENCH_REPEAT * BENCH_ROUNDS * per, total / inputs.size(),
+	       pct(0.5), pct(0.9), pct(0.99), (double)allocs / (inputs.size() * BENCH_REPEAT * per),
+	       as_ephem_loaded() ? "true" : "false", as_grid_loaded() ? "true" : "false");
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<BenchInput> inputs = Inputs();
+	std::vector<double> tdt(inputs.size()), jd0(inputs.size());
+	std::vector<Astronomy> calculated;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		BenchModel model(inputs[i].geo);
+		tdt[i] = model.TDT(inputs[i].date, inputs[i].time);
+		jd0[i] = model.JD0(inputs[i].date);
+		calculated.push_back(Astronomy(inputs[i].geo));
+		calculated.back().setInput(inputs[i].date, inputs[i].time);
+	}
+	auto index = [&inputs](const BenchInput &in) {return &in - inputs.data();};
+
+	// batches of the epochs and sites following each input
+	size_t n = inputs.size();
+	std::vector<double> btdt(n + BENCH_BATCH), blat(n + BENCH_BATCH), blon(n + BENCH_BATCH);
+	for (size_t i = 0; i < n + BENCH_BATCH; i++) {
+		btdt[i] = tdt[i % n];
+		blat[i] = inputs[i % n].geo.latitude * M_PI / 180.0;
+		blon[i] = inputs[i % n].geo.longitude * M_PI / 180.0;
+	}
+	static double bd[9][BENCH_BATCH];
+	static float bf[9][BENCH_BATCH];
+	as_batch_coor coor = {bd[0], bd[1], bd[2], bd[3], bd[4], bd[5], bd[6], bd[7], bd[8]};
+	as_batch_coorf coorf = {bf[0], bf[1], bf[2], bf[3], bf[4], bf[5], bf[6], bf[7], bf[8]};
+
+	// UDF rows as the server passes them: non constant arguments, date not terminated
+	struct BenchRow {
+		char date[32];
+		long long epoch;
+		double lat, lon;
+		long long zone;
+	};
+	std::vector<BenchRow> rows(n);
+	for (size_t i = 0; i < n; i++) {
+		const BenchInput &in = inputs[i];
+		snprintf(rows[i].date, sizeof(rows[i].date), "%04d-%02d-%02d %02d:%02d:%02d",
+		         in.date.year, in.date.month, in.date.day, in.time.hour, in.time.minute, in.time.second);
+		struct tm tm = {};
+		tm.tm_year = in.date.year - 1900;
+		tm.tm_mon = in.date.month - 1;
+		tm.tm_mday = in.date.day;
+		tm.tm_hour = in.time.hour;
+		tm.tm_min = in.time.minute;
+		tm.tm_sec = in.time.second;
+		rows[i].epoch = (long long)timegm(&tm) - in.geo.timezone * 3600LL;
+		rows[i].lat = in.geo.latitude;
+		rows[i].lon = in.geo.longitude;
+		rows[i].zone = in.geo.timezone;
+	}
+	Item_result types[4] = {STRING_RESULT, REAL_RESULT, REAL_RESULT, INT_RESULT};
+	char *udfArgs[4] = {NULL, NULL, NULL, NULL};
+	unsigned long lengths[4] = {19, sizeof(double), sizeof(double), sizeof(long long)};
+	char maybeNull[4] = {0, 0, 0, 0};
+	UDF_ARGS args = {4, types, udfArgs, lengths, maybeNull, NULL, NULL, NULL};
+	Item_result epochTypes[4] = {INT_RESULT, REAL_RESULT, REAL_RESULT, INT_RESULT};
+	unsigned long epochLengths[4] = {sizeof(long long), sizeof(double), sizeof(double), sizeof(long long)};
+	UDF_ARGS epochArgs = {4, epochTypes, udfArgs, epochLengths, maybeNull, NULL, NULL, NULL};
+	UDF_INIT astroInit, epochInit, valueInit;
+	char message[MYSQL_ERRMSG_SIZE];
+	if (astro_init(&astroInit, &args, message) || astro_init(&epochInit, &epochArgs, message)
+	    || astro_sun_altitude_init(&valueInit, &args, message)) {
+		fprintf(stderr, "xxx_init(): %s\n", message);
+		return 1;
+	}
+	// statements of astroSiteRow: location constant within xxx_init(), date per row
+	std::vector<UDF_INIT> siteInit(n);
+	for (size_t i = 0; i < n; i++) {
+		udfArgs[0] = NULL;
+		udfArgs[1] = (char *)&rows[i].lat;
+		udfArgs[2] = (char *)&rows[i].lon;
+		udfArgs[3] = (char *)&rows[i].zone;
+		if (astro_init(&siteInit[i], &args, message)) {
+			fprintf(stderr, "astro_init(): %s\n", message);
+			return 1;
+		}
+	}
+	auto setRow = [&](const BenchInput &in) {
+		BenchRow &row = rows[index(in)];
+		udfArgs[0] = row.date;
+		udfArgs[1] = (char *)&row.lat;
+		udfArgs[2] = (char *)&row.lon;
+		udfArgs[3] = (char *)&row.zone;
+	};
+
+	struct {
+		const char *name;
+		std::function<double(const BenchInput &)> op;
+		int per;
+	} benches[] = {
+		{"setInput", [](const BenchInput &in) {
+			Astronomy astro(in.geo);
+			astro.setInput(in.date, in.time);
+			return astro.GetSunAlt();
+		}},
+		{"setInputSun", [](const BenchInput &in) {
+			Astronomy astro(in.geo);
+			astro.setInput<AS_CALC_SUN>(in.date, in.time);
+			return astro.GetSunAlt();
+		}},
+		{"setInputMoon", [](const BenchInput &in) {
+			Astronomy astro(in.geo);
+			astro.setInput<AS_CALC_MOON>(in.date, in.time);
+			return astro.GetMoonAlt();
+		}},
+		{"CalcSunRise", [&](const BenchInput &in) {
+			BenchModel model(in.geo);
+			return model.SunRise(jd0[index(in)]);
+		}},
+		{"CalcMoonRise", [&](const BenchInput &in) {
+			BenchModel model(in.geo);
+			return model.MoonRise(jd0[index(in)]);
+		}},
+		{"CalcSunRiseFast", [&](const BenchInput &in) {
+			BenchModel model(in.geo, AS_PRECISION_FAST);
+			return model.SunRise(jd0[index(in)]);
+		}},
+		{"CalcSunRisePrecise", [&](const BenchInput &in) {
+			BenchModel model(in.geo, AS_PRECISION_PRECISE);
+			return model.SunRise(jd0[index(in)]);
+		}},
+		{"CalcMoonRiseFast", [&](const BenchInput &in) {
+			BenchModel model(in.geo, AS_PRECISION_FAST);
+			return model.MoonRise(jd0[index(in)]);
+		}},
+		{"CalcMoonRisePrecise", [&](const BenchInput &in) {
+			BenchModel model(in.geo, AS_PRECISION_PRECISE);
+			return model.MoonRise(jd0[index(in)]);
+		}},
+		{"SunPosition", [&](const BenchInput &in) {
+			BenchModel model(in.geo);
+			return model.Sun(tdt[index(in)]);
+		}},
+		{"MoonPosition", [&](const BenchInput &in) {
+			BenchModel model(in.geo);
+			return model.Moon(tdt[index(in)]);
+		}},
+		{"setInputFastMath", [](const BenchInput &in) {
+			Astronomy astro(in.geo);
+			astro.setMath(AS_MATH_FAST);
+			astro.setInput(in.date, in.time);
+			return astro.GetSunAlt();
+		}},
+		{"CalcSunRiseFastMath", [&](const BenchInput &in) {
+			BenchModel model(in.geo, AS_PRECISION_STANDARD, AS_MATH_FAST);
+			return model.SunRise(jd0[index(in)]);
+		}},
+		{"CalcMoonRiseFastMath", [&](const BenchInput &in) {
+			BenchModel model(in.geo, AS_PRECISION_STANDARD, AS_MATH_FAST);
+			return model.MoonRise(jd0[index(in)]);
+		}},
+		{"SunPositionFastMath", [&](const BenchInput &in) {
+			BenchModel model(in.geo, AS_PRECISION_STANDARD, AS_MATH_FAST);
+			return model.Sun(tdt[index(in)]);
+		}},
+		{"MoonPositionFastMath", [&](const BenchInput &in) {
+			BenchModel model(in.geo, AS_PRECISION_STANDARD, AS_MATH_FAST);
+			return model.Moon(tdt[index(in)]);
+		}},
+		{"SunPositionBatch", [&](const BenchInput &in) {
+			size_t i = index(in);
+			as_sun_position_batch(BENCH_BATCH, &btdt[i], &blat[i], &blon[i], 65, &coor);
+			return coor.alt[0];
+		}, BENCH_BATCH},
+		{"SunPositionBatchF32", [&](const BenchInput &in) {
+			size_t i = index(in);
+			as_sun_position_batch_f32(BENCH_BATCH, &btdt[i], &blat[i], &blon[i], 65, &coorf);
+			return (double)coorf.alt[0];
+		}, BENCH_BATCH},
+		{"MoonPositionBatch", [&](const BenchInput &in) {
+			size_t i = index(in);
+			as_moon_position_batch(BENCH_BATCH, &btdt[i], &blat[i], &blon[i], 65, &coor);
+			return coor.alt[0];
+		}, BENCH_BATCH},
+		{"MoonPositionBatchF32", [&](const BenchInput &in) {
+			size_t i = index(in);
+			as_moon_position_batch_f32(BENCH_BATCH, &btdt[i], &blat[i], &blon[i], 65, &coorf);
+			return (double)coorf.alt[0];
+		}, BENCH_BATCH},
+		{"TimeSpan", [&](const BenchInput &in) {
+			BenchModel model(in.geo);
+			return model.Span(fmod(tdt[index(in)], 1.0) * 24.0);
+		}},
+		{"JSON", [&](const BenchInput &in) {
+			// values are calculated in advance, only GetJSON() is timed
+			static char buf[MAX_RET_STRLEN + 1];
+			unsigned long length;
+			calculated[index(in)].GetJSON(buf, sizeof(buf), &length);
+			return (double)length;
+		}},
+		{"astroRow", [&](const BenchInput &in) {
+			unsigned long length;
+			char isNull, error;
+			setRow(in);
+			astro(&astroInit, &args, NULL, &length, &isNull, &error);
+			return (double)length;
+		}},
+		{"astroRowEpoch", [&](const BenchInput &in) {
+			unsigned long length;
+			char isNull, error;
+			setRow(in);
+			udfArgs[0] = (char *)&rows[index(in)].epoch;
+			astro(&epochInit, &epochArgs, NULL, &length, &isNull, &error);
+			return (double)length;
+		}},
+		{"astroSiteRow", [&](const BenchInput &in) {
+			unsigned long length;
+			char isNull, error;
+			setRow(in);
+			astro(&siteInit[index(in)], &args, NULL, &length, &isNull, &error);
+			return (double)length;
+		}},
+		{"astroSunAltitudeRow", [&](const BenchInput &in) {
+			char isNull, error;
+			setRow(in);
+			return astro_sun_altitude(&valueInit, &args, &isNull, &error);
+		}},
+	};
+
+	for (auto &b : benches) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; i++) {
+			if (strcmp(argv[i], b.name) == 0) selected = true;
+		}
+		if (selected) Run(b.name, inputs, b.op, b.per ? b.per : 1);
+	}
+	astro_deinit(&astroInit);
+	astro_deinit(&epochInit);
+	for (auto &init : siteInit) astro_deinit(&init);
+	astro_sun_altitude_deinit(&valueInit);
+	return 0;
+}
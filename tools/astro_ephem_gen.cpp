@@ -0,0 +1,210 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Creates the Chebyshev ephemeris file from the analytic sun/moon models
+// (see src/astro_ephem.h), or verifies an existing file against them.
+//
+//   astro_ephem_gen FILE            create FILE
+//   astro_ephem_gen --verify FILE   check the interpolation error of FILE
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mysql.h>
+#include <string>
+#include <vector>
+#include "lib_mysqludf_astro.h"
+#include "astro_ephem.h"
+
+#define VERIFY_EPOCHS       1000000 // epochs checked by --verify
+#define VERIFY_BLOCK        10000   // epochs per block of --verify
+
+// segment length (days) and polynomial order of every body
+static const struct {
+	double days;
+	unsigned order;
+	unsigned values;
+} s_Layout[AS_EPHEM_BODIES] = {
+	{64.0, 13, AS_EPHEM_SUN_VALUES},    // AS_EPHEM_SUN
+	{ 8.0, 19, AS_EPHEM_MOON_VALUES},   // AS_EPHEM_MOON
+};
+
+// names, max interpolation error (rad, AU or relative distance) and longitudes of all values
+static const struct {
+	const char *name;
+	double tolerance;
+	bool angle;
+} s_Values[AS_EPHEM_BODIES][AS_EPHEM_MAX_VALUES] = {
+	{
+		{"Sun.Longitude",       1e-10,  true},
+		{"Sun.Distance",        1e-10,  false},
+		{"Sun.Ascension",       1e-10,  true},
+		{"Sun.Declination",     1e-10,  false},
+	},
+	{
+		{"Moon.Longitude",      1e-9,   true},
+		{"Moon.Latitude",       1e-9,   false},
+		{"Moon.OrbitLongitude", 1e-9,   true},
+		{"Moon.Distance",       1e-9,   false},
+		{"Moon.Ascension",      1e-9,   true},
+		{"Moon.Declination",    1e-9,   false},
+	},
+};
+
+class EphemerisModel : public Astronomy {
+public:
+	EphemerisModel() : Astronomy(as_geo{0.0, 0.0, 0}) {}
+
+	// analytic values of a body at TDT (the ephemeris must not be loaded)
+	void Values(AS_EPHEM_BODY body, double TDT, double *value) {
+		auto sun = SunPosition(TDT);
+		if (body == AS_EPHEM_SUN) {
+			SunOrbit(TDT, &value[AS_EPHEM_SUN_LON], &value[AS_EPHEM_SUN_DIST]);
+			value[AS_EPHEM_SUN_RA] = sun.ra;
+			value[AS_EPHEM_SUN_DEC] = sun.dec;
+		}
+		else {
+			MoonOrbit(sun, TDT, &value[AS_EPHEM_MOON_LON], &value[AS_EPHEM_MOON_LAT],
+			          &value[AS_EPHEM_MOON_ORBITLON], &value[AS_EPHEM_MOON_DIST]);
+			auto moon = MoonGeocentric(sun, TDT);
+			value[AS_EPHEM_MOON_RA] = moon.ra;
+			value[AS_EPHEM_MOON_DEC] = moon.dec;
+		}
+	}
+};
+
+static int Generate(const char *file)
+{
+	EphemerisModel model;
+	as_ephem_header hdr;
+	std::vector<double> coeff;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, AS_EPHEM_MAGIC, sizeof(hdr.magic));
+	hdr.version = AS_EPHEM_VERSION;
+	hdr.bodies = AS_EPHEM_BODIES;
+	hdr.start = AS_EPHEM_START;
+	hdr.end = AS_EPHEM_END;
+
+	for (int b = 0; b < AS_EPHEM_BODIES; b++) {
+		as_ephem_body &body = hdr.body[b];
+		body.days = s_Layout[b].days;
+		body.order = s_Layout[b].order;
+		body.values = s_Layout[b].values;
+		body.segments = (uint32_t)ceil((hdr.end - hdr.start) / body.days);
+		body.offset = coeff.size();
+
+		unsigned n = body.order + 1;
+		std::vector<double> values(n * body.values);
+		std::vector<double> c(n);
+		for (uint32_t segment = 0; segment < body.segments; segment++) {
+			double start = hdr.start + segment * body.days;
+			for (unsigned k = 0; k < n; k++) {
+				double *v = &values[k * body.values];
+				model.Values((AS_EPHEM_BODY)b, start + (as_ephem_node(k, body.order) + 1.0) * 0.5 * body.days, v);
+				for (unsigned i = 0; i < body.values && k > 0; i++) {
+					// keep longitudes continuous within the segment, the nodes are sorted by time
+					double prev = values[(k - 1) * body.values + i];
+					if (s_Values[b][i].angle) v[i] = prev + remainder(v[i] - prev, 2.0 * M_PI);
+				}
+			}
+			size_t pos = coeff.size();
+			coeff.resize(pos + n * body.values);
+			for (unsigned i = 0; i < body.values; i++) {
+				std::vector<double> series(n);
+				for (unsigned k = 0; k < n; k++) series[k] = values[k * body.values + i];
+				as_ephem_fit(series.data(), body.order, c.data());
+				for (unsigned k = 0; k < n; k++) coeff[pos + k * body.values + i] = c[k];
+			}
+		}
+	}
+
+	FILE *f = fopen(file, "wb");
+	if (f == NULL) {
+		perror(file);
+		return 1;
+	}
+	bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1
+	          && fwrite(coeff.data(), sizeof(double), coeff.size(), f) == coeff.size();
+	if (fclose(f) != 0 || !ok) {
+		perror(file);
+		return 1;
+	}
+	printf("%s: %zu coefficients, %zu bytes\n", file, coeff.size(), sizeof(hdr) + coeff.size() * sizeof(double));
+	return 0;
+}
+
+static int Verify(const char *file)
+{
+	EphemerisModel model;
+	double maxerr[AS_EPHEM_BODIES][AS_EPHEM_MAX_VALUES] = {{0}};
+	int rc = 0;
+
+	// 1 million pseudo random epochs over the complete range, in blocks: the analytic
+	// values are calculated without the ephemeris, the interpolated ones with it
+	uint64_t seed = 1;
+	std::vector<double> TDT(VERIFY_BLOCK), analytic(VERIFY_BLOCK * AS_EPHEM_BODIES * AS_EPHEM_MAX_VALUES);
+	for (int block = 0; block < VERIFY_EPOCHS / VERIFY_BLOCK; block++) {
+		as_ephem_close();
+		for (int n = 0; n < VERIFY_BLOCK; n++) {
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			TDT[n] = AS_EPHEM_START + (seed >> 11) * (1.0 / 9007199254740992.0) * (AS_EPHEM_END - AS_EPHEM_START);
+			for (int b = 0; b < AS_EPHEM_BODIES; b++) {
+				model.Values((AS_EPHEM_BODY)b, TDT[n], &analytic[(n * AS_EPHEM_BODIES + b) * AS_EPHEM_MAX_VALUES]);
+			}
+		}
+		if (!as_ephem_open(file)) {
+			fprintf(stderr, "%s: missing or invalid ephemeris file\n", file);
+			return 1;
+		}
+		for (int n = 0; n < VERIFY_BLOCK; n++) {
+			for (int b = 0; b < AS_EPHEM_BODIES; b++) {
+				const double *v = &analytic[(n * AS_EPHEM_BODIES + b) * AS_EPHEM_MAX_VALUES];
+				double e[AS_EPHEM_MAX_VALUES];
+				if (!as_ephem_eval((AS_EPHEM_BODY)b, TDT[n], e)) {
+					fprintf(stderr, "%s: no value at %.5f\n", s_Values[b][0].name, TDT[n]);
+					return 1;
+				}
+				for (unsigned i = 0; i < s_Layout[b].values; i++) {
+					double err = s_Values[b][i].angle ? fabs(remainder(e[i] - v[i], 2.0 * M_PI)) : fabs(e[i] - v[i]);
+					if (err > maxerr[b][i]) maxerr[b][i] = err;
+				}
+			}
+		}
+	}
+	for (int b = 0; b < AS_EPHEM_BODIES; b++) {
+		for (unsigned i = 0; i < s_Layout[b].values; i++) {
+			bool ok = maxerr[b][i] <= s_Values[b][i].tolerance;
+			printf("%-20s max error %.3g (limit %.3g) %s\n", s_Values[b][i].name, maxerr[b][i], s_Values[b][i].tolerance, ok ? "ok" : "FAILED");
+			if (!ok) rc = 1;
+		}
+	}
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	// never sample a previously loaded ephemeris
+	as_ephem_close();
+
+	if (argc == 2) return Generate(argv[1]);
+	if (argc == 3 && strcmp(argv[1], "--verify") == 0) return Verify(argv[2]);
+	fprintf(stderr, "usage: %s [--verify] FILE\n", argv[0]);
+	return 2;
+}
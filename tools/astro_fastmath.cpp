@@ -0,0 +1,282 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Checks the error bounds of the fast trigonometry (AS_MATH_FAST and the
+// float32 batch kernels) against libm.
+//
+//   astro_fastmath             run all checks
+//
+// Checks, one JSON line each with the maximum error and its limit:
+//
+//   {"check":"sin","type":"float","samples":268435456,"max":1.2e-07,"limit":3e-07,"result":"ok"}
+//
+// - float: every float argument of the fast functions within the checked
+//   range (|x| from 2^-12 to 4 pi for sin/cos, to 1 for asin/acos and the
+//   atan2 ratio), errors in radians (sin/cos: absolute)
+// - double: FASTMATH_SAMPLES arguments spread evenly over the range, the
+//   double functions cannot be checked exhaustively
+// - engine: positions (radians) and rise/set times (seconds) of
+//   AS_MATH_FAST against AS_MATH_LIBM over a global grid of sites and days;
+//   altitudes near the zenith/nadir are ill-conditioned (asin amplifies the
+//   input error by 1/cos(alt)), so horizontal coordinates have a wider limit
+//   than equatorial ones. Times are reported as p99 (grazing events near
+//   polar day/night are ill-conditioned and differ more)
+// - batch: as_*_position_batch_f32() against the double kernels, angles in
+//   radians, azimuth scaled by cos(altitude), distances relative. The same
+//   epoch must give the same bits at every position of a batch.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mysql.h>
+#include <vector>
+#include <algorithm>
+#include "lib_mysqludf_astro.h"
+#include "astro_math.h"
+#include "astro_batch.h"
+
+#define FASTMATH_SAMPLES    (1 << 22)   // arguments per double function
+#define FASTMATH_FLOAT_MIN  0x1p-12f    // smallest checked float argument
+#define FASTMATH_BATCH      4096        // epochs of the batch check
+
+static int s_rc = 0;
+
+static void Report(const char *check, const char *type, size_t samples, double max, double limit)
+{
+	bool ok = max <= limit;
+	printf("{\"check\":\"%s\",\"type\":\"%s\",\"samples\":%zu,\"max\":%.3g,\"limit\":%.3g,\"result\":\"%s\"}\n",
+	       check, type, samples, max, limit, ok ? "ok" : "FAILED");
+	fflush(stdout);
+	if (!ok) s_rc = 1;
+}
+
+// Calls f for every float from lo up to hi (both positive) and its negative
+template<typename F> static size_t EveryFloat(float lo, float hi, bool negative, F f)
+{
+	uint32_t a, b;
+	memcpy(&a, &lo, sizeof(a));
+	memcpy(&b, &hi, sizeof(b));
+	size_t n = 0;
+	for (uint32_t u = a; u <= b; u++) {
+		float x;
+		memcpy(&x, &u, sizeof(x));
+		f(x);
+		n++;
+		if (negative) {
+			f(-x);
+			n++;
+		}
+	}
+	return n;
+}
+
+static void CheckFloat()
+{
+	double es = 0.0, ec = 0.0;
+	size_t n = EveryFloat(FASTMATH_FLOAT_MIN, (float)(4.0 * M_PI), true, [&](float x) {
+		float s, c;
+		as_fast_sincos(x, &s, &c);
+		es = std::max(es, fabs(s - sin((double)x)));
+		ec = std::max(ec, fabs(c - cos((double)x)));
+	});
+	Report("sin", "float", n, es, 3e-7);
+	Report("cos", "float", n, ec, 3e-7);
+
+	// atan2 of every ratio below and above 1, in all quadrants
+	double ea = 0.0;
+	n = EveryFloat(FASTMATH_FLOAT_MIN, 1.0f, false, [&](float t) {
+		for (int q = 0; q < 4; q++) {
+			float y = (q & 1) ? -t : t, x = (q & 2) ? -1.0f : 1.0f;
+			ea = std::max(ea, fabs(as_fast_atan2(y, x) - atan2((double)y, (double)x)));
+			ea = std::max(ea, fabs(as_fast_atan2(x, y) - atan2((double)x, (double)y)));
+		}
+	});
+	Report("atan2", "float", n * 8, ea, 5e-7);
+
+	double eas = 0.0, eac = 0.0;
+	n = EveryFloat(FASTMATH_FLOAT_MIN, 1.0f, true, [&](float x) {
+		eas = std::max(eas, fabs(as_fast_asin(x) - asin((double)x)));
+		eac = std::max(eac, fabs(as_fast_acos(x) - acos((double)x)));
+	});
+	Report("asin", "float", n, eas, 5e-7);
+	Report("acos", "float", n, eac, 5e-7);
+}
+
+static void CheckDouble()
+{
+	double es = 0.0, ec = 0.0, ea = 0.0, eas = 0.0, eac = 0.0;
+	for (int i = 0; i <= FASTMATH_SAMPLES; i++) {
+		double u = (double)i / FASTMATH_SAMPLES;
+		// sin/cos: angles of a few turns and the large arguments of the mean orbit elements
+		double x = (i & 1) ? (2.0 * u - 1.0) * 4.0 * M_PI : (2.0 * u - 1.0) * 1e4;
+		double s, c;
+		as_fast_sincos(x, &s, &c);
+		es = std::max(es, fabs(s - sin(x)));
+		ec = std::max(ec, fabs(c - cos(x)));
+
+		double a = (2.0 * u - 1.0) * M_PI;
+		double r = pow(10.0, 8.0 * u - 4.0);
+		ea = std::max(ea, fabs(as_fast_atan2(r * sin(a), r * cos(a)) - atan2(r * sin(a), r * cos(a))));
+
+		double v = 2.0 * u - 1.0;
+		eas = std::max(eas, fabs(as_fast_asin(v) - asin(v)));
+		eac = std::max(eac, fabs(as_fast_acos(v) - acos(v)));
+	}
+	Report("sin", "double", FASTMATH_SAMPLES + 1, es, 2e-9);
+	Report("cos", "double", FASTMATH_SAMPLES + 1, ec, 2e-9);
+	Report("atan2", "double", FASTMATH_SAMPLES + 1, ea, 5e-9);
+	Report("asin", "double", FASTMATH_SAMPLES + 1, eas, 4e-9);
+	Report("acos", "double", FASTMATH_SAMPLES + 1, eac, 4e-9);
+}
+
+class FastMathModel : public Astronomy {
+public:
+	FastMathModel(double lat, double lon, int zone) : Astronomy(as_geo{lon, lat, zone}) {}
+
+	double JD(as_date d) {return CalcJD(d.day, d.month, d.year);}
+
+	// sun and moon ra, dec, alt and azimuth times cos(alt) at jd (UT)
+	void Positions(double jd, AS_MATH math, double *v) {
+		setMath(math);
+		double la = GetLat() * M_PI / 180.0, lo = GetLon() * M_PI / 180.0;
+		double TDT = jd + GetDeltaT() / 24.0 / 3600.0;
+		double gmst = CalcGMST(jd);
+		double lmst = GMST2LMST(gmst, lo) * 15.0 * M_PI / 180.0;
+		auto observer = Observer(lo, la);
+		ObserverGeocentric(&observer);
+		auto sun = SunPosition(TDT, &observer, lmst);
+		auto moon = MoonPosition(sun, TDT, &observer, lmst);
+		double w[8] = {sun.ra, sun.dec, sun.alt, sun.az * cos(sun.alt), moon.ra, moon.dec, moon.alt, moon.az * cos(moon.alt)};
+		memcpy(v, w, sizeof(w));
+	}
+
+	// rise, transit and set of the sun and the moon (hours local time)
+	void Events(double JD0, AS_MATH math, double *ev) {
+		setMath(math);
+		auto observer = Observer(GetLon() * M_PI / 180.0, GetLat() * M_PI / 180.0);
+		auto sun = CalcSunRise(JD0, GetDeltaT(), observer, (int)GetZone(), false);
+		auto moon = CalcMoonRise(JD0, GetDeltaT(), observer, (int)GetZone(), false);
+		double v[9] = {sun.rise, sun.transit, sun.set, sun.cicilTwilightMorning, sun.cicilTwilightEvening,
+		               sun.astronomicalTwilightMorning, moon.rise, moon.transit, moon.set};
+		memcpy(ev, v, sizeof(v));
+	}
+};
+
+static void CheckEngine()
+{
+	double eequ = 0.0, ehor = 0.0;
+	size_t npos = 0;
+	std::vector<double> dt;
+	for (double lat = -84.0; lat <= 84.0; lat += 6.0) {
+		for (double lon = -180.0; lon < 180.0; lon += 30.0) {
+			int zone = (int)floor(lon / 15.0 + 0.5);
+			FastMathModel model(lat, lon, zone);
+			for (int d = 0; d < 24; d++) {
+				double JD0 = model.JD(as_date{1, 1, 2000}) + d * 613.0 - 36525.0;
+				for (int h = 0; h < 24; h += 3) {
+					double a[8], b[8];
+					model.Positions(JD0 + h / 24.0, AS_MATH_LIBM, a);
+					model.Positions(JD0 + h / 24.0, AS_MATH_FAST, b);
+					for (int k = 0; k < 8; k++) {
+						double e = fabs(remainder(a[k] - b[k], 2.0 * M_PI));
+						if (k & 2) ehor = std::max(ehor, e);
+						else eequ = std::max(eequ, e);
+					}
+					npos += 4;
+				}
+				double a[9], b[9];
+				model.Events(JD0, AS_MATH_LIBM, a);
+				model.Events(JD0, AS_MATH_FAST, b);
+				for (int k = 0; k < 9; k++) {
+					if (!isnan(a[k]) && !isnan(b[k])) dt.push_back(fabs(remainder(a[k] - b[k], 24.0)) * 3600.0);
+				}
+			}
+		}
+	}
+	Report("equatorial", "engine", npos, eequ, 5e-8);
+	Report("horizontal", "engine", npos, ehor, 1e-6);
+	std::sort(dt.begin(), dt.end());
+	Report("riseset_p99", "engine", dt.size(), dt[(size_t)(0.99 * (dt.size() - 1))], 0.5);
+}
+
+static void CheckBatch()
+{
+	size_t n = FASTMATH_BATCH;
+	std::vector<double> tdt(n + 1), lat(n + 1), lon(n + 1);
+	srand(1);
+	for (size_t i = 0; i <= n; i++) {
+		tdt[i] = 2415020.5 + 73000.0 * rand() / RAND_MAX;
+		lat[i] = (178.0 * rand() / RAND_MAX - 89.0) * M_PI / 180.0;
+		lon[i] = (360.0 * rand() / RAND_MAX - 180.0) * M_PI / 180.0;
+	}
+	std::vector<double> d[9];
+	std::vector<float> f[9], g[9];
+	for (int k = 0; k < 9; k++) {
+		d[k].resize(n);
+		f[k].resize(n);
+		g[k].resize(n);
+	}
+	as_batch_coor cd = {d[0].data(), d[1].data(), d[2].data(), d[3].data(), d[4].data(), d[5].data(), d[6].data(), d[7].data(), d[8].data()};
+	as_batch_coorf cf = {f[0].data(), f[1].data(), f[2].data(), f[3].data(), f[4].data(), f[5].data(), f[6].data(), f[7].data(), f[8].data()};
+	as_batch_coorf cg = {g[0].data(), g[1].data(), g[2].data(), g[3].data(), g[4].data(), g[5].data(), g[6].data(), g[7].data(), g[8].data()};
+
+	for (int moon = 0; moon < 2; moon++) {
+		const char *type = moon ? "batch_moon" : "batch_sun";
+		if (moon) {
+			as_moon_position_batch(n, tdt.data(), lat.data(), lon.data(), 65, &cd);
+			as_moon_position_batch_f32(n, tdt.data(), lat.data(), lon.data(), 65, &cf);
+			// shifted by one epoch: other lanes and loop remainders
+			as_moon_position_batch_f32(n - 1, tdt.data() + 1, lat.data() + 1, lon.data() + 1, 65, &cg);
+		}
+		else {
+			as_sun_position_batch(n, tdt.data(), lat.data(), lon.data(), 65, &cd);
+			as_sun_position_batch_f32(n, tdt.data(), lat.data(), lon.data(), 65, &cf);
+			as_sun_position_batch_f32(n - 1, tdt.data() + 1, lat.data() + 1, lon.data() + 1, 65, &cg);
+		}
+		double eang = 0.0, ealt = 0.0, eaz = 0.0, edist = 0.0, eref = 0.0, ephase = 0.0;
+		size_t differ = 0;
+		for (size_t i = 0; i < n; i++) {
+			for (int k = 0; k < 4; k++) eang = std::max(eang, fabs(remainder(d[k][i] - f[k][i], 2.0 * M_PI)));
+			edist = std::max(edist, fabs(d[4][i] - f[4][i]) / d[4][i]);
+			eaz = std::max(eaz, fabs(remainder(d[5][i] - f[5][i], 2.0 * M_PI)) * cos(d[6][i]));
+			ealt = std::max(ealt, fabs(d[6][i] - f[6][i]));
+			eref = std::max(eref, fabs(d[7][i] - f[7][i]));
+			if (moon) ephase = std::max(ephase, fabs(d[8][i] - f[8][i]));
+			for (int k = 0; k < 9 && i > 0; k++) {
+				if (memcmp(&f[k][i], &g[k][i - 1], sizeof(float)) != 0) differ++;
+			}
+		}
+		Report("ecliptic_equatorial", type, n, eang, 5e-6);
+		Report("altitude", type, n, ealt, 1e-5);
+		Report("azimuth", type, n, eaz, 1e-5);
+		Report("distance", type, n, edist, 1e-6);
+		Report("refraction", type, n, eref, 1e-5);
+		if (moon) Report("phase", type, n, ephase, 5e-6);
+		Report("position_dependent_bits", type, n, (double)differ, 0);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	CheckDouble();
+	CheckEngine();
+	CheckBatch();
+	CheckFloat();
+	return s_rc;
+}
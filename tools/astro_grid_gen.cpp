@@ -0,0 +1,252 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Creates the sun rise/set grid file (see src/astro_grid.h) for a range of
+// days and a lat/lon grid, or verifies an existing file against the exact
+// calculation.
+//
+//   astro_grid_gen FILE START END LAT0 LAT1 LON0 LON1 STEP
+//                                   create FILE for the UTC days START to END
+//                                   (YYYY-MM-DD, including END), latitudes LAT0
+//                                   to LAT1 and longitudes LON0 to LON1 every
+//                                   STEP degrees
+//   astro_grid_gen --verify FILE    check the interpolation error of FILE
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mysql.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include "lib_mysqludf_astro.h"
+#include "astro_grid.h"
+
+#define GRID_THREADS        8       // threads used for the calculation
+#define GRID_TOLERANCE      30.0    // max interpolation error (seconds) accepted by --verify
+#define GRID_SAMPLES        200000  // random samples checked by --verify
+
+class GridModel : public Astronomy {
+public:
+	GridModel() : Astronomy(as_geo{0.0, 0.0, 0}) {}
+
+	double JD(as_date d) {return CalcJD(d.day, d.month, d.year);}
+	double DeltaT() {return GetDeltaT();}
+
+	// exact events of the UTC day jd0UT at lat/lon (degrees)
+	void Events(double jd0UT, double lat, double lon, double *events) {
+		CalcSunRiseUTC(jd0UT, GetDeltaT(), Observer(lon * M_PI / 180.0, lat * M_PI / 180.0), events);
+	}
+
+	// local rise/set times, exact and from the grid (false if the grid can not answer)
+	bool Compare(double JD0, double lat, double lon, int zone, double *exact, double *grid) {
+		double la = lat * M_PI / 180.0, lo = lon * M_PI / 180.0;
+		auto rise = CalcSunRise(JD0, GetDeltaT(), Observer(lo, la), zone, false);
+		auto interpolated = rise;
+		if (!GridSunRise(JD0, lo, la, zone, &interpolated)) return false;
+		Times(rise, exact);
+		Times(interpolated, grid);
+		return true;
+	}
+
+private:
+	template<typename T> void Times(const T &rise, double *t) {
+		t[AS_GRID_RISE] = rise.rise;
+		t[AS_GRID_TRANSIT] = rise.transit;
+		t[AS_GRID_SET] = rise.set;
+		t[AS_GRID_CIVIL_MORNING] = rise.cicilTwilightMorning;
+		t[AS_GRID_CIVIL_EVENING] = rise.cicilTwilightEvening;
+		t[AS_GRID_NAUTICAL_MORNING] = rise.nauticalTwilightMorning;
+		t[AS_GRID_NAUTICAL_EVENING] = rise.nauticalTwilightEvening;
+		t[AS_GRID_ASTRONOMICAL_MORNING] = rise.astronomicalTwilightMorning;
+		t[AS_GRID_ASTRONOMICAL_EVENING] = rise.astronomicalTwilightEvening;
+	}
+};
+
+static const char *const s_EventName[AS_GRID_EVENTS] = {
+	"Rise", "Transit", "Set",
+	"Civil morning", "Civil evening",
+	"Nautical morning", "Nautical evening",
+	"Astronomical morning", "Astronomical evening",
+};
+
+static bool ParseDate(const char *str, as_date *d)
+{
+	int year, month, day;
+	if (sscanf(str, "%d-%d-%d", &year, &month, &day) != 3) return false;
+	d->year = year;
+	d->month = month;
+	d->day = day;
+	return true;
+}
+
+// Calculate the days first, first + threads, ... of the grid
+static void CalcDays(const as_grid_header *hdr, uint16_t *values, uint32_t first, uint32_t threads)
+{
+	GridModel model;
+	double events[AS_GRID_EVENTS];
+	size_t day_size = (size_t)hdr->lats * hdr->lons * AS_GRID_EVENTS;
+	for (uint32_t d = first; d < hdr->days; d += threads) {
+		uint16_t *v = values + d * day_size;
+		for (uint32_t i = 0; i < hdr->lats; i++) {
+			for (uint32_t j = 0; j < hdr->lons; j++) {
+				model.Events(hdr->day0 + d, hdr->lat0 + i * hdr->dlat, hdr->lon0 + j * hdr->dlon, events);
+				for (int e = 0; e < AS_GRID_EVENTS; e++) *v++ = as_grid_encode(events[e]);
+			}
+		}
+	}
+}
+
+static int Generate(char *argv[])
+{
+	const char *file = argv[0];
+	GridModel model;
+	as_date start, end;
+	double lat0 = atof(argv[3]), lat1 = atof(argv[4]);
+	double lon0 = atof(argv[5]), lon1 = atof(argv[6]);
+	double step = atof(argv[7]);
+
+	if (!ParseDate(argv[1], &start) || !ParseDate(argv[2], &end)) {
+		fprintf(stderr, "invalid date, expected YYYY-MM-DD\n");
+		return 2;
+	}
+	if (!(step > 0.0 && lat0 >= -90.0 && lat1 <= 90.0 && lat1 > lat0 && lon0 >= -180.0 && lon1 <= 180.0 && lon1 > lon0)) {
+		fprintf(stderr, "invalid grid\n");
+		return 2;
+	}
+
+	as_grid_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, AS_GRID_MAGIC, sizeof(AS_GRID_MAGIC));
+	hdr.version = AS_GRID_VERSION;
+	hdr.events = AS_GRID_EVENTS;
+	hdr.deltaT = model.DeltaT();
+	hdr.day0 = model.JD(start);
+	double days = model.JD(end) - hdr.day0 + 1;
+	if (days < 1) {
+		fprintf(stderr, "END is before START\n");
+		return 2;
+	}
+	hdr.days = (uint32_t)days;
+	hdr.lats = (uint32_t)floor((lat1 - lat0) / step + 1e-9) + 1;
+	hdr.lons = (uint32_t)floor((lon1 - lon0) / step + 1e-9) + 1;
+	hdr.lat0 = lat0;
+	hdr.dlat = step;
+	hdr.lon0 = lon0;
+	hdr.dlon = step;
+
+	size_t count = (size_t)hdr.days * hdr.lats * hdr.lons * AS_GRID_EVENTS;
+	std::vector<uint16_t> values(count);
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < GRID_THREADS; t++) {
+		threads.push_back(std::thread(CalcDays, &hdr, values.data(), t, (uint32_t)GRID_THREADS));
+	}
+	for (auto &t : threads) t.join();
+
+	FILE *f = fopen(file, "wb");
+	if (f == NULL) {
+		perror(file);
+		return 1;
+	}
+	bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1
+	          && fwrite(values.data(), sizeof(uint16_t), count, f) == count;
+	if (fclose(f) != 0 || !ok) {
+		perror(file);
+		return 1;
+	}
+	printf("%s: %u days, %u x %u grid points, %zu bytes\n", file, hdr.days, hdr.lats, hdr.lons, sizeof(hdr) + count * sizeof(uint16_t));
+	return 0;
+}
+
+static int Verify(const char *file)
+{
+	GridModel model;
+	double maxerr[AS_GRID_EVENTS] = {0};
+	double maxlocal = 0.0;
+	long interpolated = 0;
+	long mismatches = 0;
+	int rc = 0;
+
+	if (!as_grid_open(file)) {
+		fprintf(stderr, "%s: missing or invalid grid file\n", file);
+		return 1;
+	}
+	const as_grid_header &hdr = *as_grid_info();
+
+	// pseudo random days and sites within the grid
+	uint64_t seed = 1;
+	auto random = [&seed]() {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (seed >> 11) * (1.0 / 9007199254740992.0);
+	};
+	for (int n = 0; n < GRID_SAMPLES; n++) {
+		double jd0UT = hdr.day0 + floor(random() * hdr.days);
+		double lat = hdr.lat0 + random() * (hdr.lats - 1) * hdr.dlat;
+		double lon = hdr.lon0 + random() * (hdr.lons - 1) * hdr.dlon;
+		double exact[AS_GRID_EVENTS], grid[AS_GRID_EVENTS];
+		if (!as_grid_sunrise(jd0UT, lat, lon, model.DeltaT(), grid)) continue;
+		interpolated++;
+		model.Events(jd0UT, lat, lon, exact);
+		for (int e = 0; e < AS_GRID_EVENTS; e++) {
+			if (isnan(grid[e]) || isnan(exact[e])) {
+				if (isnan(grid[e]) != isnan(exact[e])) mismatches++;
+				continue;
+			}
+			double err = fabs(grid[e] - exact[e]) * 3600.0;
+			if (err > maxerr[e]) maxerr[e] = err;
+		}
+
+		// local times as returned by astro_sun_times(), for a random zone
+		int zone = (int)floor(random() * 27.0) - 12;
+		if (model.Compare(jd0UT, lat, lon, zone, exact, grid)) {
+			for (int e = 0; e < AS_GRID_EVENTS; e++) {
+				if (isnan(grid[e]) || isnan(exact[e])) {
+					if (isnan(grid[e]) != isnan(exact[e])) mismatches++;
+					continue;
+				}
+				double err = fabs(remainder(grid[e] - exact[e], 24.0)) * 3600.0;
+				if (err > maxlocal) maxlocal = err;
+			}
+		}
+	}
+	for (int e = 0; e < AS_GRID_EVENTS; e++) {
+		bool ok = maxerr[e] <= GRID_TOLERANCE;
+		printf("%-22s max error %6.1f s (limit %.0f s) %s\n", s_EventName[e], maxerr[e], GRID_TOLERANCE, ok ? "ok" : "FAILED");
+		if (!ok) rc = 1;
+	}
+	bool ok = maxlocal <= GRID_TOLERANCE;
+	printf("%-22s max error %6.1f s (limit %.0f s) %s\n", "Local times", maxlocal, GRID_TOLERANCE, ok ? "ok" : "FAILED");
+	if (!ok) rc = 1;
+	printf("%-22s %ld %s\n", "Missing/extra events", mismatches, mismatches == 0 ? "ok" : "FAILED");
+	if (mismatches != 0) rc = 1;
+	printf("%ld of %d samples interpolated, the others use the exact calculation\n", interpolated, GRID_SAMPLES);
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	// never verify against a previously loaded grid
+	as_grid_close();
+
+	if (argc == 9) return Generate(argv + 1);
+	if (argc == 3 && strcmp(argv[1], "--verify") == 0) return Verify(argv[2]);
+	fprintf(stderr, "usage: %s FILE START END LAT0 LAT1 LON0 LON1 STEP\n"
+	                "       %s --verify FILE\n", argv[0], argv[0]);
+	return 2;
+}
@@ -0,0 +1,203 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Checks the rise/set error of every precision tier (AS_PRECISION) over a
+// global grid of sites and days.
+//
+//   astro_precision            check all tiers
+//
+// The reference times are the altitude crossings of the sun/moon positions
+// found by scanning the local day and two days around it in PRECISION_STEP
+// minutes and bisecting every crossing to 0.01 seconds. Steps that start and
+// end near the altitude are scanned in PRECISION_FINE minutes, so that short
+// dips below it (grazing events near polar day/night) are not missed. The error of a tier
+// is the distance to the nearest reference crossing of the same event: all
+// tiers choose the day of an event the same way (see SunRiseLocal() and
+// MoonRiseLocal()), only the time is checked. How much the estimated
+// neighbouring day of AS_PRECISION_FAST adds is shown by the difference to
+// the standard tier. One line per tier:
+//
+//   {"precision":"standard","events":76944,"p50":0.2,"p99":160.5,"max":1773.5,
+//    "standard_p99":0.0,"missing":579,"limit":300,"limit_max":1800,"result":"ok"}
+//
+// p50/p99/max are seconds, missing counts events found by only one side
+// (polar day/night and grazing crossings). The check fails if the p99 or the
+// max. error is above the limits of the tier.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mysql.h>
+#include <vector>
+#include <algorithm>
+#include "lib_mysqludf_astro.h"
+
+#define PRECISION_STEP      15.0    // scan step of the reference (minutes)
+#define PRECISION_FINE      1.0     // scan step near the altitude (minutes)
+#define PRECISION_RATE      16.0    // max. change of the altitude (degrees per hour)
+#define PRECISION_DAYS      24      // days per site, spread over 2000..2040
+
+static const char *const s_Name[AS_PRECISION_COUNT] = {"fast", "standard", "precise"};
+
+// p99 and max. error limits (seconds) of AS_PRECISION_FAST, _STANDARD, _PRECISE
+static const double s_Limit[AS_PRECISION_COUNT] = {600.0, 300.0, 1.0};
+static const double s_LimitMax[AS_PRECISION_COUNT] = {3600.0, 1800.0, 600.0};
+
+// Events checked per sample (sun rise/set and twilights, moon rise/transit/set)
+enum EVENT {
+	EV_SUNRISE, EV_SUNTRANSIT, EV_SUNSET,
+	EV_CIVIL_MORNING, EV_CIVIL_EVENING,
+	EV_NAUTICAL_MORNING, EV_NAUTICAL_EVENING,
+	EV_ASTRONOMICAL_MORNING, EV_ASTRONOMICAL_EVENING,
+	EV_MOONRISE, EV_MOONTRANSIT, EV_MOONSET,
+	EV_COUNT
+};
+
+class PrecisionModel : public Astronomy {
+public:
+	PrecisionModel(double lat, double lon, int zone) : Astronomy(as_geo{lon, lat, zone}) {}
+
+	double JD(as_date d) {return CalcJD(d.day, d.month, d.year);}
+
+	// times (hours local time) of the tier
+	void Events(double JD0, AS_PRECISION precision, double *ev) {
+		auto observer = Observer(GetLon() * M_PI / 180.0, GetLat() * M_PI / 180.0);
+		setPrecision(precision);
+		auto sun = CalcSunRise(JD0, GetDeltaT(), observer, (int)GetZone(), false);
+		auto moon = CalcMoonRise(JD0, GetDeltaT(), observer, (int)GetZone(), false);
+		double v[EV_COUNT] = {
+			sun.rise, sun.transit, sun.set,
+			sun.cicilTwilightMorning, sun.cicilTwilightEvening,
+			sun.nauticalTwilightMorning, sun.nauticalTwilightEvening,
+			sun.astronomicalTwilightMorning, sun.astronomicalTwilightEvening,
+			moon.rise, moon.transit, moon.set,
+		};
+		memcpy(ev, v, sizeof(v));
+	}
+
+	// altitude above the rise/set altitude (event -1/+1) or hour angle (event 0)
+	// of the body at jd (UT), radians
+	double Height(double jd, bool moon, int event, double naltitude) {
+		double la = GetLat() * M_PI / 180.0, lo = GetLon() * M_PI / 180.0;
+		double TDT = jd + GetDeltaT() / 24.0 / 3600.0;
+		auto co = SunPosition(TDT);
+		if (moon) co = MoonPosition(co, TDT);
+		double hourAngle = remainder(GMST2LMST(CalcGMST(jd), lo) * 15.0 * M_PI / 180.0 - co.ra, 2.0 * M_PI);
+		if (event == 0) return hourAngle;
+		double h = naltitude;
+		if (isnan(h)) h = -(0.5 * co.diameter - co.parallax + 34.0 / 60 * M_PI / 180.0);
+		return asin(sin(la) * sin(co.dec) + cos(la) * cos(co.dec) * cos(hourAngle)) - h;
+	}
+
+	// reference crossings (hours UT from jd0UT) within t0..t1, scanned in step hours
+	void Crossings(double jd0UT, double t0, double t1, bool moon, int event, double naltitude, std::vector<double> *out,
+	               double step = PRECISION_STEP / 60.0) {
+		double a = t0, fa = Height(jd0UT + a / 24.0, moon, event, naltitude);
+		for (int i = 1; a < t1; i++) {
+			double b = t0 + i * step;
+			double fb = Height(jd0UT + b / 24.0, moon, event, naltitude);
+			// rise and transit: upwards (transit: without the jump at +-180 degrees), set: downwards
+			bool crossing = event > 0 ? (fa > 0 && fb <= 0) : (fa < 0 && fb >= 0);
+			if (event == 0 && fb - fa > M_PI) crossing = false;
+			if (crossing) {
+				double lo = a, hi = b, flo = fa;
+				while ((hi - lo) * 3600.0 > 0.01) {
+					double mid = 0.5 * (lo + hi);
+					double fm = Height(jd0UT + mid / 24.0, moon, event, naltitude);
+					if ((fm < 0) == (flo < 0)) {lo = mid; flo = fm;}
+					else hi = mid;
+				}
+				double t = 0.5 * (lo + hi);
+				// rise only east (hour angle < 0), set only west of the meridian
+				if (event == 0 || (Height(jd0UT + t / 24.0, moon, 0, naltitude) < 0) == (event < 0)) out->push_back(t);
+			}
+			else if (event != 0 && step > PRECISION_FINE / 60.0 && (fa < 0) == (fb < 0)
+			         && fabs(fa) + fabs(fb) < PRECISION_RATE * M_PI / 180.0 * step) {
+				// near enough to the altitude to pass it twice within the step
+				Crossings(jd0UT, a, b, moon, event, naltitude, out, PRECISION_FINE / 60.0);
+			}
+			a = b;
+			fa = fb;
+		}
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	struct {
+		bool moon;
+		int event;
+		double altitude;    // degrees, NAN: rise/set
+	} spec[EV_COUNT] = {
+		{false, -1, NAN}, {false, 0, NAN}, {false, 1, NAN},
+		{false, -1, -6.0}, {false, 1, -6.0},
+		{false, -1, -12.0}, {false, 1, -12.0},
+		{false, -1, -18.0}, {false, 1, -18.0},
+		{true, -1, NAN}, {true, 0, NAN}, {true, 1, NAN},
+	};
+	std::vector<double> err[AS_PRECISION_COUNT];
+	std::vector<double> diff[AS_PRECISION_COUNT];
+	long missing[AS_PRECISION_COUNT] = {0};
+	int rc = 0;
+
+	for (double lat = -66.0; lat <= 66.0; lat += 6.0) {
+		for (double lon = -180.0; lon < 180.0; lon += 30.0) {
+			int zone = (int)floor(lon / 15.0 + 0.5);
+			PrecisionModel model(lat, lon, zone);
+			for (int d = 0; d < PRECISION_DAYS; d++) {
+				double JD0 = model.JD(as_date{1, 1, 2000}) + d * 613.0;
+				double local[AS_PRECISION_COUNT][EV_COUNT];
+				for (int p = 0; p < AS_PRECISION_COUNT; p++) model.Events(JD0, (AS_PRECISION)p, local[p]);
+
+				for (int e = 0; e < EV_COUNT; e++) {
+					std::vector<double> ref;
+					double altitude = spec[e].altitude * M_PI / 180.0;
+					model.Crossings(JD0, -zone - 48.0, -zone + 72.0, spec[e].moon, spec[e].event, altitude, &ref);
+					for (int p = 0; p < AS_PRECISION_COUNT; p++) {
+						double v = local[p][e];
+						double standard = local[AS_PRECISION_STANDARD][e];
+						if (!isnan(v) && !isnan(standard)) diff[p].push_back(fabs(remainder(v - standard, 24.0)) * 3600.0);
+						if (isnan(v) || ref.empty()) {
+							if (isnan(v) != ref.empty()) missing[p]++;
+							continue;
+						}
+						double best = HUGE_VAL;
+						for (double r : ref) best = std::min(best, fabs(remainder(v - (r + zone), 24.0)) * 3600.0);
+						err[p].push_back(best);
+					}
+				}
+			}
+		}
+	}
+
+	for (int p = 0; p < AS_PRECISION_COUNT; p++) {
+		auto pct = [](std::vector<double> &v, double q) {
+			std::sort(v.begin(), v.end());
+			return v.empty() ? 0.0 : v[(size_t)(q * (v.size() - 1) + 0.5)];
+		};
+		double p99 = pct(err[p], 0.99), max = pct(err[p], 1.0);
+		bool ok = p99 <= s_Limit[p] && max <= s_LimitMax[p];
+		printf("{\"precision\":\"%s\",\"events\":%zu,\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f,"
+		       "\"standard_p99\":%.1f,\"missing\":%ld,\"limit\":%.0f,\"limit_max\":%.0f,\"result\":\"%s\"}\n",
+		       s_Name[p], err[p].size(), pct(err[p], 0.5), p99, max,
+		       pct(diff[p], 0.99), missing[p], s_Limit[p], s_LimitMax[p], ok ? "ok" : "FAILED");
+		if (!ok) rc = 1;
+	}
+	return rc;
+}
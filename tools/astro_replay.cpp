@@ -0,0 +1,363 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Replays astro() calls without a MySQL server
+//
+//   astro_replay [OPTIONS] CSV GOLDEN           compare the results with GOLDEN
+//   astro_replay [OPTIONS] --record CSV GOLDEN  write the results to GOLDEN
+//   astro_replay --generate ROWS CSV            write ROWS pseudo random calls
+//
+// Options:
+//   --fields FIELDS        constant fields argument of astro()
+//   --language LANG        constant language argument of astro()
+//   --precision P          constant precision argument of astro()
+//   --math M               constant math argument of astro()
+//   --real                 pass latitude/longitude as REAL_RESULT (default DECIMAL_RESULT)
+//   --tolerance X          max. difference of numbers (default 0)
+//   --time-tolerance S     max. difference of hh:mm:ss times in seconds (default 0)
+//   --min-rate R           fail below R rows per second
+//
+// Every CSV line holds the arguments date,latitude,longitude,timezone of one
+// row. Empty values and NULL are passed as NULL. The functions are called
+// like the server does: astro_init() with the non constant arguments set to
+// NULL, astro() for every row with strings that are not NUL terminated, and
+// astro_deinit() at the end.
+//
+// GOLDEN has one line per row: the JSON result, NULL or ERROR. The keys of
+// every JSON result are also compared on their own, byte by byte and in
+// order (tools/replay.golden holds the results of the std::string based JSON
+// of the original implementation). A summary is written as JSON line, the
+// exit code is 1 on mismatches of results or keys or a too low rate.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+#include <mysql.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "lib_mysqludf_astro.h"
+
+#define REPLAY_ARGS         8
+#define REPLAY_MAX_LINE     1024    // max. length of a CSV or GOLDEN line
+#define REPLAY_REPORT       10      // mismatches reported in detail
+
+struct ReplayOptions {
+	const char *fields = NULL;
+	const char *language = NULL;
+	const char *precision = NULL;
+	const char *math = NULL;
+	double tolerance = 0.0;
+	double timeTolerance = 0.0;
+	double minRate = 0.0;
+	bool real = false;
+};
+
+// Arguments of one row as the server passes them
+struct ReplayRow {
+	Item_result type[REPLAY_ARGS];
+	char *args[REPLAY_ARGS];
+	unsigned long lengths[REPLAY_ARGS];
+	char maybeNull[REPLAY_ARGS];
+	char date[REPLAY_MAX_LINE];
+	char lat[REPLAY_MAX_LINE], lon[REPLAY_MAX_LINE];
+	double latReal, lonReal;
+	long long zone;
+};
+
+// Split a CSV line into the row arguments, false if the line is invalid
+static bool ParseRow(char *line, ReplayRow *row)
+{
+	char *value[4];
+	int n = 0;
+	line[strcspn(line, "\r\n")] = '\0';
+	for (char *p = line; n < 4; n++) {
+		value[n] = p;
+		p = strchr(p, ',');
+		if (p == NULL) {
+			n++;
+			break;
+		}
+		*p++ = '\0';
+	}
+	if (n != 4) return false;
+
+	for (int i = 0; i < 4; i++) {
+		bool null = *value[i] == '\0' || strcmp(value[i], "NULL") == 0;
+		size_t length = strlen(value[i]);
+		row->args[i] = NULL;
+		row->lengths[i] = 0;
+		if (null) continue;
+		switch (i) {
+		case 0:
+			// not terminated, like the server buffers
+			memcpy(row->date, value[i], length);
+			row->date[length] = 'X';
+			row->args[i] = row->date;
+			row->lengths[i] = length;
+			break;
+		case 1:
+		case 2: {
+			char *buf = (i == 1) ? row->lat : row->lon;
+			double *real = (i == 1) ? &row->latReal : &row->lonReal;
+			if (row->type[i] == REAL_RESULT) {
+				*real = atof(value[i]);
+				row->args[i] = (char *)real;
+				row->lengths[i] = sizeof(double);
+			}
+			else {
+				memcpy(buf, value[i], length);
+				buf[length] = '\0';
+				row->args[i] = buf;
+				row->lengths[i] = length;
+			}
+			break;
+		}
+		case 3:
+			row->zone = atoll(value[i]);
+			row->args[i] = (char *)&row->zone;
+			row->lengths[i] = sizeof(long long);
+			break;
+		}
+	}
+	return true;
+}
+
+// Starts with a hh:mm:ss time
+static bool IsTime(const char *s)
+{
+	return strlen(s) >= 8 && isdigit(s[0]) && isdigit(s[1]) && s[2] == ':' && isdigit(s[3]) && isdigit(s[4])
+	       && s[5] == ':' && isdigit(s[6]) && isdigit(s[7]);
+}
+
+// Compare two results, numbers and times within the tolerances
+static bool Equal(const char *a, const char *b, const ReplayOptions &opt)
+{
+	bool quoted = false;
+	while (*a && *b) {
+		if (quoted && IsTime(a) && IsTime(b)) {
+			int ta = atoi(a) * 3600 + atoi(a + 3) * 60 + atoi(a + 6);
+			int tb = atoi(b) * 3600 + atoi(b + 3) * 60 + atoi(b + 6);
+			int d = abs(ta - tb);
+			if (d > 43200) d = 86400 - d;   // around midnight
+			if (d > opt.timeTolerance) return false;
+			a += 8;
+			b += 8;
+			continue;
+		}
+		if (!quoted && (isdigit(*a) || *a == '-') && (isdigit(*b) || *b == '-')) {
+			char *ea, *eb;
+			double va = strtod(a, &ea), vb = strtod(b, &eb);
+			if (ea != a && eb != b) {
+				if (!(fabs(va - vb) <= opt.tolerance)) return false;
+				a = ea;
+				b = eb;
+				continue;
+			}
+		}
+		if (*a != *b) return false;
+		if (*a == '"') quoted = !quoted;
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+// Keys and nesting of a JSON result without the values, e.g. {"Zone":,"Sun":{"Ecliptic":}}
+static std::string Keys(const char *json)
+{
+	std::string keys;
+	for (const char *p = json; *p; p++) {
+		if (*p == '"') {
+			const char *start = p++;
+			while (*p && *p != '"') {
+				if (*p == '\\' && p[1]) p++;
+				p++;
+			}
+			if (!*p) break;
+			const char *q = p + 1;
+			while (isspace(*q)) q++;
+			if (*q == ':') keys.append(start, q + 1 - start);
+		}
+		else if (*p == '{' || *p == '}' || *p == ',') keys += *p;
+	}
+	return keys;
+}
+
+static int Generate(long rows, const char *file)
+{
+	FILE *f = fopen(file, "w");
+	if (f == NULL) {
+		perror(file);
+		return 1;
+	}
+	uint64_t seed = 1;
+	auto random = [&seed]() {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (seed >> 11) * (1.0 / 9007199254740992.0);
+	};
+	for (long n = 0; n < rows; n++) {
+		int year = 1902 + (int)(random() * 197);
+		int month = 1 + (int)(random() * 12);
+		int day = 1 + (int)(random() * 28);
+		int hour = (int)(random() * 24), minute = (int)(random() * 60), second = (int)(random() * 60);
+		double lat = random() * 180.0 - 90.0;
+		double lon = random() * 360.0 - 180.0;
+		int zone = (int)floor(random() * 27.0) - 12;
+		if (random() < 0.001) {
+			// some NULL arguments
+			fprintf(f, "NULL,%.6f,,%d\n", lat, zone);
+		}
+		else {
+			fprintf(f, "%04d-%02d-%02d %02d:%02d:%02d,%.6f,%.6f,%d\n", year, month, day, hour, minute, second, lat, lon, zone);
+		}
+	}
+	if (fclose(f) != 0) {
+		perror(file);
+		return 1;
+	}
+	return 0;
+}
+
+static int Replay(const ReplayOptions &opt, bool record, const char *csvFile, const char *goldenFile)
+{
+	FILE *csv = fopen(csvFile, "r");
+	if (csv == NULL) {
+		perror(csvFile);
+		return 1;
+	}
+	FILE *golden = fopen(goldenFile, record ? "w" : "r");
+	if (golden == NULL) {
+		perror(goldenFile);
+		fclose(csv);
+		return 1;
+	}
+
+	// astro_init() with the constant arguments only
+	ReplayRow row;
+	memset(&row, 0, sizeof(row));
+	row.type[0] = STRING_RESULT;
+	row.type[1] = row.type[2] = opt.real ? REAL_RESULT : DECIMAL_RESULT;
+	row.type[3] = INT_RESULT;
+	row.type[4] = row.type[5] = row.type[6] = row.type[7] = STRING_RESULT;
+	unsigned count = opt.math != NULL ? 8 : (opt.precision != NULL ? 7 : (opt.language != NULL ? 6 : (opt.fields != NULL ? 5 : 4)));
+	row.args[4] = (char *)(opt.fields != NULL ? opt.fields : "");
+	row.lengths[4] = strlen(row.args[4]);
+	row.args[5] = (char *)(opt.language != NULL ? opt.language : "");
+	row.lengths[5] = strlen(row.args[5]);
+	row.args[6] = (char *)(opt.precision != NULL ? opt.precision : "");
+	row.lengths[6] = strlen(row.args[6]);
+	row.args[7] = (char *)opt.math;
+	row.lengths[7] = opt.math != NULL ? strlen(opt.math) : 0;
+	for (unsigned i = 0; i < count; i++) row.maybeNull[i] = 1;
+	UDF_ARGS args = {count, row.type, row.args, row.lengths, row.maybeNull, NULL, NULL, NULL};
+	UDF_INIT initid;
+	memset(&initid, 0, sizeof(initid));
+	char message[MYSQL_ERRMSG_SIZE];
+	if (astro_init(&initid, &args, message)) {
+		fprintf(stderr, "astro_init(): %s\n", message);
+		fclose(csv);
+		fclose(golden);
+		return 1;
+	}
+
+	char line[REPLAY_MAX_LINE], expected[MAX_RET_STRLEN + 16];
+	char *result = (char *)malloc(initid.max_length + 1);
+	long rows = 0, mismatches = 0, keyMismatches = 0;
+	double seconds = 0.0;
+	int rc = 0;
+	while (fgets(line, sizeof(line), csv) != NULL) {
+		if (!ParseRow(line, &row)) {
+			fprintf(stderr, "%s:%ld: invalid line\n", csvFile, rows + 1);
+			rc = 1;
+			break;
+		}
+		unsigned long length = 0;
+		char is_null = 0, error = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		char *res = astro(&initid, &args, result, &length, &is_null, &error);
+		auto t1 = std::chrono::steady_clock::now();
+		seconds += std::chrono::duration<double>(t1 - t0).count();
+		rows++;
+
+		std::string out = error ? "ERROR" : (is_null || res == NULL) ? "NULL" : std::string(res, length);
+		if (record) {
+			fprintf(golden, "%s\n", out.c_str());
+			continue;
+		}
+		if (fgets(expected, sizeof(expected), golden) == NULL) {
+			fprintf(stderr, "%s: missing result of row %ld\n", goldenFile, rows);
+			rc = 1;
+			break;
+		}
+		expected[strcspn(expected, "\r\n")] = '\0';
+		if (expected[0] == '{' && Keys(out.c_str()) != Keys(expected)) {
+			if (keyMismatches < REPLAY_REPORT) {
+				fprintf(stderr, "row %ld keys:\n  expected %s\n  got      %s\n", rows, Keys(expected).c_str(), Keys(out.c_str()).c_str());
+			}
+			keyMismatches++;
+		}
+		if (!Equal(out.c_str(), expected, opt)) {
+			if (mismatches < REPLAY_REPORT) {
+				fprintf(stderr, "row %ld:\n  expected %s\n  got      %s\n", rows, expected, out.c_str());
+			}
+			mismatches++;
+		}
+	}
+	astro_deinit(&initid);
+	free(result);
+	fclose(csv);
+	if (fclose(golden) != 0) {
+		perror(goldenFile);
+		rc = 1;
+	}
+
+	double rate = seconds > 0.0 ? rows / seconds : 0.0;
+	bool slow = opt.minRate > 0.0 && rate < opt.minRate;
+	printf("{\"rows\":%ld,\"mismatches\":%ld,\"key_mismatches\":%ld,\"rows_per_sec\":%.0f,\"min_rate\":%.0f,\"result\":\"%s\"}\n",
+	       rows, mismatches, keyMismatches, rate, opt.minRate,
+	       rc != 0 || mismatches != 0 || keyMismatches != 0 ? "mismatch" : slow ? "slow" : "ok");
+	if (mismatches != 0 || keyMismatches != 0 || slow) rc = 1;
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	ReplayOptions opt;
+	bool record = false;
+	int i = 1;
+	if (argc == 4 && strcmp(argv[1], "--generate") == 0) return Generate(atol(argv[2]), argv[3]);
+	for (; i + 1 < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+		if (strcmp(argv[i], "--record") == 0) record = true;
+		else if (strcmp(argv[i], "--fields") == 0) opt.fields = argv[++i];
+		else if (strcmp(argv[i], "--language") == 0) opt.language = argv[++i];
+		else if (strcmp(argv[i], "--precision") == 0) opt.precision = argv[++i];
+		else if (strcmp(argv[i], "--math") == 0) opt.math = argv[++i];
+		else if (strcmp(argv[i], "--tolerance") == 0) opt.tolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--time-tolerance") == 0) opt.timeTolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--min-rate") == 0) opt.minRate = atof(argv[++i]);
+		else if (strcmp(argv[i], "--real") == 0) opt.real = true;
+		else break;
+	}
+	if (i + 2 == argc) return Replay(opt, record, argv[i], argv[i + 1]);
+	fprintf(stderr, "usage: %s [OPTIONS] [--record] CSV GOLDEN\n"
+	                "       %s --generate ROWS CSV\n", argv[0], argv[0]);
+	return 2;
+}
@@ -0,0 +1,57 @@
+/*
+    lib_mysqludf_astro - a library with astro functions
+    Copyright (C) 2023  Norbert Richter <nr@prsolution.eu>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Stand-in for the loadable function declarations of mysql.h, used to build
+// the tools (astro_replay) without a MySQL installation. The layout follows
+// mysql/udf_registration_types.h of MySQL 8.
+
+#ifndef ASTRO_UDF_MYSQL_H
+#define ASTRO_UDF_MYSQL_H
+
+#define MYSQL_ERRMSG_SIZE           512     // size of the message buffer of xxx_init()
+
+enum Item_result {
+	INVALID_RESULT = -1,
+	STRING_RESULT = 0,
+	REAL_RESULT,
+	INT_RESULT,
+	ROW_RESULT,
+	DECIMAL_RESULT
+};
+
+typedef struct UDF_ARGS {
+	unsigned int arg_count;             // number of arguments
+	enum Item_result *arg_type;         // type of each argument
+	char **args;                        // argument values, NULL for non constant arguments in xxx_init()
+	unsigned long *lengths;             // length of string arguments
+	char *maybe_null;                   // argument may be NULL
+	char **attributes;                  // argument names
+	unsigned long *attribute_lengths;   // length of the argument names
+	void *extension;
+} UDF_ARGS;
+
+typedef struct UDF_INIT {
+	bool maybe_null;                    // function may return NULL
+	unsigned int decimals;              // decimals of a REAL result
+	unsigned long max_length;           // max. result length
+	char *ptr;                          // function data
+	bool const_item;                    // function returns the same value for every row
+	void *extension;
+} UDF_INIT;
+
+#endif  // ASTRO_UDF_MYSQL_H